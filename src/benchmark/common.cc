@@ -2,31 +2,123 @@
 // Please see the AUTHORS file for details.  Use of this source code is governed
 // by a BSD license that can be found in the LICENSE file.
 
+#define __STDC_FORMAT_MACROS 1  // we want PRIu64 and friends
+
 #include "benchmark/common.h"
 
 #include <gflags/gflags.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <new>
+#include <string>
+#include <vector>
 
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/time.h"
 #include "util/threadlocals.h"
+#include "util/topology.h"
 
 DEFINE_bool(set_rt_priority, true,
             "try to set the program to RT priority (needs root)");
+DEFINE_bool(perf_counters, false,
+            "count hardware and software events of the worker threads "
+            "during the measured phase (perf_event_open)");
+DEFINE_uint64(c_ns, 0,
+              "calibrate the workload between two operations to take the "
+              "given number of ns instead of using c as is");
+DEFINE_string(c_buffer, "0",
+              "stream through a private buffer of the given size per thread, "
+              "e.g., 32k or 8m, as workload instead of computing pi; c is "
+              "then the number of cache lines per operation");
+DEFINE_bool(spin_barrier, false,
+            "start the measured phase with a spinning barrier among the "
+            "worker threads, which wake up with less skew than from the "
+            "pthread barrier");
+DEFINE_string(pin, "none",
+              "pin worker threads to cpus: none, compact, scatter, physical, "
+              "smt, or an explicit cpu list, e.g., 0,2,4-7");
 
 namespace scal {
 
 Benchmark::Benchmark(uint64_t num_threads,
                      uint64_t thread_prealloc_size,
-                     uint64_t histogram_size,
+                     uint64_t num_histograms,
                      void *data) {
   num_threads_ = num_threads;
+  active_threads_ = num_threads;
   data_ = data;
   thread_prealloc_size_ = thread_prealloc_size;
-  if (pthread_barrier_init(&start_barrier_, NULL, num_threads_)) {
-    fprintf(stderr, "%s: error: Unable to init start barrier.\n", __func__);
+  num_histograms_ = num_histograms;
+  // Histograms are indexed by thread id, which starts at 1 for worker threads.
+  histograms_ = static_cast<Histogram**>(calloc(
+      num_threads_ + 1, sizeof(*histograms_)));
+  if (!histograms_) {
+    perror("calloc");
+    abort();
+  }
+  perf_counters_ = static_cast<PerfCounters**>(calloc(
+      num_threads_ + 1, sizeof(*perf_counters_)));
+  if (!perf_counters_) {
+    perror("calloc");
+    abort();
+  }
+  workloads_ = static_cast<Workload**>(calloc(
+      num_threads_ + 1, sizeof(*workloads_)));
+  if (!workloads_) {
+    perror("calloc");
+    abort();
+  }
+  workload_buffer_size_ = 0;
+  if (FLAGS_c_buffer != "0") {
+    workload_buffer_size_ = scal::kPageSize * scal::human_size_to_pages(
+        FLAGS_c_buffer.c_str(), FLAGS_c_buffer.size());
+  }
+  workload_units_ = 0;
+  operation_counters_ = static_cast<uint64_t*>(scal::calloc_aligned(
+      (num_threads_ + 1) * kCounterStride, sizeof(uint64_t),
+      scal::kCachePrefetch));
+  alloc_stats_ = static_cast<AllocStats*>(scal::calloc_aligned(
+      num_threads_ + 1, sizeof(AllocStats), scal::kCachePrefetch));
+  prefault_times_ = static_cast<uint64_t*>(scal::calloc_aligned(
+      (num_threads_ + 1) * kCounterStride, sizeof(uint64_t),
+      scal::kCachePrefetch));
+  thread_starts_ = static_cast<uint64_t*>(scal::calloc_aligned(
+      (num_threads_ + 1) * kCounterStride, sizeof(uint64_t),
+      scal::kCachePrefetch));
+  thread_ends_ = static_cast<uint64_t*>(scal::calloc_aligned(
+      (num_threads_ + 1) * kCounterStride, sizeof(uint64_t),
+      scal::kCachePrefetch));
+  ticks_per_usec_ = 0;
+  start_barrier_ = NULL;
+  started_threads_ = 0;
+  window_opened_ = false;
+  window_closed_ = false;
+  window_valid_ = false;
+  window_start_ = 0;
+  window_end_ = 0;
+  window_start_operations_ = 0;
+  window_end_operations_ = 0;
+  stop_ = false;
+  finished_threads_ = 0;
+  duration_ = 0;
+  sample_interval_ = 0;
+  samples_ = NULL;
+  num_samples_ = 0;
+  max_samples_ = 0;
+  print_samples_ = true;
+  placement_ = NULL;
+  thread_cpus_ = NULL;
+  setup_placement();
+  started_ = false;
+  shutdown_ = false;
+  elevated_ = false;
+  if (pthread_barrier_init(&barrier_, NULL, num_threads_ + 1)) {
+    fprintf(stderr, "%s: error: Unable to init barrier.\n", __func__);
     abort();
   }
   threads_ = static_cast<pthread_t*>(malloc(num_threads_ * sizeof(pthread_t)));
@@ -36,7 +128,7 @@ Benchmark::Benchmark(uint64_t num_threads,
   }
 }
 
-void Benchmark::run(void) {
+void Benchmark::start_threads(void) {
   int s;
   pthread_attr_t attr;
   pthread_attr_t *pattr;
@@ -48,7 +140,16 @@ void Benchmark::run(void) {
     pattr = NULL;
   }
 
-  global_start_time_ = 0;
+  // The monitor is elevated before any worker exists, as RT workers would
+  // otherwise starve it on machines without spare cores.
+  if ((duration_ > 0 || sample_interval_ > 0) && pattr != NULL) {
+    pthread_getschedparam(pthread_self(), &main_policy_, &main_param_);
+    struct sched_param monitor_param;
+    monitor_param.sched_priority = kMonitorPriority;
+    pthread_setschedparam(pthread_self(), SCHED_RR, &monitor_param);
+    elevated_ = true;
+  }
+
   for (uint64_t i = 0; i < num_threads_; i++) {
     s = pthread_create(&threads_[i],
                        pattr,
@@ -58,10 +159,160 @@ void Benchmark::run(void) {
       handle_pthread_error(s, "pthread_create");
     }
   }
+  // Calibrated while the workers set up their thread-local state.
+  ticks_per_usec_ = hwtime_per_usec();
+  // Wait for the workers to set up their thread-local state.
+  wait_barrier();
+  started_ = true;
+  if (FLAGS_perf_counters) {
+    uint64_t total;
+    if (!perf_counter(PerfCounters::kTaskClock, &total)) {
+      fprintf(stderr, "warning: perf events are not available\n");
+    } else if (!perf_counter(PerfCounters::kCycles, &total)) {
+      fprintf(stderr, "warning: hardware perf events are not available, "
+                      "counting software events only\n");
+    }
+  }
+}
+
+void Benchmark::run(void) {
+  if (!started_) {
+    start_threads();
+  }
+  // The workers are waiting for the trial to start, so their state can
+  // safely be reset.
+  global_start_time_ = 0;
+  global_end_time_ = 0;
+  stop_ = false;
+  finished_threads_ = 0;
+  started_threads_ = 0;
+  window_opened_ = false;
+  window_closed_ = false;
+  window_valid_ = false;
+  num_samples_ = 0;
+  if (FLAGS_spin_barrier) {
+    // The number of active threads may have changed.
+    delete start_barrier_;
+    start_barrier_ = new SpinningBarrier(active_threads_);
+  }
+  for (uint64_t i = 1; i <= num_threads_; i++) {
+    operation_counters_[i * kCounterStride] = 0;
+    thread_starts_[i * kCounterStride] = 0;
+    thread_ends_[i * kCounterStride] = 0;
+    memset(&alloc_stats_[i], 0, sizeof(AllocStats));
+    if (histograms_[i] != NULL) {
+      for (uint64_t j = 0; j < num_histograms_; j++) {
+        histograms_[i][j].reset();
+      }
+    }
+  }
+  // Setup phase.
+  wait_barrier();
+  // Measured phase.
+  wait_barrier();
+  if (duration_ > 0 || sample_interval_ > 0) {
+    monitor();
+  }
+  wait_barrier();
+}
+
+void Benchmark::shutdown(void) {
+  if (!started_) {
+    return;
+  }
+  shutdown_ = true;
+  wait_barrier();
   for (uint64_t i = 0; i < num_threads_; i++) {
     pthread_join(threads_[i], NULL);
   }
-  global_end_time_ = get_utime();
+  if (elevated_) {
+    pthread_setschedparam(pthread_self(), main_policy_, &main_param_);
+    elevated_ = false;
+  }
+  delete start_barrier_;
+  start_barrier_ = NULL;
+  started_ = false;
+}
+
+void Benchmark::wait_barrier(void) {
+  int rc = pthread_barrier_wait(&barrier_);
+  if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) {
+    fprintf(stderr, "%s: pthread_barrier_wait failed.\n", __func__);
+    abort();
+  }
+}
+
+// The main thread acts as monitor while the workers are running: It stops
+// timed runs and samples the per-thread operation counters.
+void Benchmark::monitor(void) {
+  while (global_start_time_ == 0) {
+    if (finished_threads_ == active_threads_) {
+      return;
+    }
+    usleep(100);
+  }
+  const uint64_t start = global_start_time_;
+  const uint64_t deadline = (duration_ > 0)
+      ? start + duration_ * 1000 : UINT64_MAX;
+  const uint64_t interval = sample_interval_ * 1000;
+  if (interval > 0) {
+    free(samples_);
+    max_samples_ = ((duration_ > 0)
+        ? (duration_ / sample_interval_) : 1024) + 1;
+    samples_ = static_cast<ThroughputSample*>(calloc(
+        max_samples_, sizeof(*samples_)));
+  }
+  uint64_t next_sample = (interval > 0) ? start + interval : UINT64_MAX;
+  uint64_t last_operations = 0;
+  uint64_t now;
+  while (finished_threads_ < active_threads_) {
+    now = get_utime();
+    if (now >= deadline) {
+      stop_ = true;
+      break;
+    }
+    if (now >= next_sample) {
+      take_sample(now, &last_operations);
+      next_sample += interval;
+      continue;
+    }
+    uint64_t wakeup = (next_sample < deadline) ? next_sample : deadline;
+    uint64_t sleep = wakeup - now;
+    usleep((sleep < kMonitorMaxSleep) ? sleep : kMonitorMaxSleep);
+  }
+}
+
+uint64_t Benchmark::sum_operations(void) {
+  uint64_t sum = 0;
+  for (uint64_t i = 1; i <= active_threads_; i++) {
+    sum += operation_counters_[i * kCounterStride];
+  }
+  return sum;
+}
+
+void Benchmark::take_sample(uint64_t now, uint64_t *last_operations) {
+  uint64_t sum = sum_operations();
+  ThroughputSample sample;
+  sample.time = now - global_start_time_;
+  sample.operations = sum - *last_operations;
+  *last_operations = sum;
+  if (num_samples_ == max_samples_) {
+    max_samples_ *= 2;
+    samples_ = static_cast<ThroughputSample*>(realloc(
+        samples_, max_samples_ * sizeof(*samples_)));
+  }
+  uint64_t previous = (num_samples_ > 0)
+      ? samples_[num_samples_ - 1].time : 0;
+  samples_[num_samples_++] = sample;
+  if (!print_samples_) {
+    return;
+  }
+  // Throughput in operations per ms, as in the summary.
+  printf("sample %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+         sample.time / 1000,
+         sample.operations,
+         (sample.operations * 1000) / (sample.time - previous));
+  fflush(stdout);
 }
 
 void Benchmark::setup_pthread_attr(pthread_attr_t *attr) {
@@ -75,7 +326,7 @@ void Benchmark::setup_pthread_attr(pthread_attr_t *attr) {
   if (s != 0) {
     handle_pthread_error(s, "pthread_attr_setschedpolicy");
   }
-  param.sched_priority = 40;
+  param.sched_priority = kWorkerPriority;
   s = pthread_attr_setschedparam(attr, &param);
   if (s != 0) {
     handle_pthread_error(s, "pthread_attr_setschedparam");
@@ -112,49 +363,236 @@ bool Benchmark::can_modify_sched() {
   return true;
 }
 
-void Benchmark::set_core_affinity() {
-  uint64_t thread_id = scal::ThreadContext::get().thread_id();
-  uint64_t cores = (uint64_t)scal::number_of_cores();
-  if (num_threads_ > cores) {
+// Maps worker thread i to the (i-1)-th cpu of the placement. The main thread
+// is left unpinned.
+void Benchmark::setup_placement(void) {
+  if (FLAGS_pin == "none") {
     return;
   }
-  uint64_t id;
-  if (cores == num_threads_) {
-    id = thread_id - 1;
-  } else {
-    double mult = (static_cast<double>(cores)) / num_threads_;
-    id = (uint64_t)(thread_id * mult) - (uint64_t)mult;
+  CpuTopology topology;
+  std::vector<int> cpus;
+  if (!topology.placement(FLAGS_pin, &cpus)) {
+    fprintf(stderr, "%s: error: invalid placement '%s'.\n",
+            __func__, FLAGS_pin.c_str());
+    abort();
+  }
+  if (num_threads_ > cpus.size()) {
+    fprintf(stderr, "warning: %" PRIu64 " threads on %zu cpus of placement "
+                    "'%s', cpus are shared\n",
+            num_threads_, cpus.size(), FLAGS_pin.c_str());
   }
+  thread_cpus_ = static_cast<int*>(calloc(
+      num_threads_ + 1, sizeof(*thread_cpus_)));
+  if (!thread_cpus_) {
+    perror("calloc");
+    abort();
+  }
+  thread_cpus_[0] = -1;
+  for (uint64_t i = 1; i <= num_threads_; i++) {
+    thread_cpus_[i] = cpus[(i - 1) % cpus.size()];
+  }
+  placement_ = FLAGS_pin.c_str();
+}
+
+void Benchmark::set_core_affinity(void) {
+  int cpu = thread_cpus_[scal::ThreadContext::get().thread_id()];
   cpu_set_t cpuset;
   CPU_ZERO(&cpuset);
-  CPU_SET((uint64_t)id, &cpuset);
+  CPU_SET(cpu, &cpuset);
   if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
     fprintf(stderr, "warning: could not set thread cpu affinity\n");
   }
 }
 
+void Benchmark::set_active_threads(uint64_t num_threads) {
+  if (num_threads == 0 || num_threads > num_threads_) {
+    fprintf(stderr, "%s: error: %" PRIu64 " active threads out of %" PRIu64
+                    "\n", __func__, num_threads, num_threads_);
+    abort();
+  }
+  active_threads_ = num_threads;
+}
+
+void Benchmark::set_workload(uint64_t units) {
+  workload_units_ = units;
+  if (FLAGS_c_ns > 0) {
+    Workload probe(workload_buffer_size_);
+    workload_units_ = probe.calibrate(FLAGS_c_ns);
+  }
+}
+
+uint64_t Benchmark::prefault_time(void) {
+  uint64_t max = 0;
+  for (uint64_t i = 1; i <= num_threads_; i++) {
+    if (prefault_times_[i * kCounterStride] > max) {
+      max = prefault_times_[i * kCounterStride];
+    }
+  }
+  return max;
+}
+
+void Benchmark::merge_histograms(uint64_t type, Histogram *result) {
+  if (type >= num_histograms_) {
+    return;
+  }
+  for (uint64_t i = 1; i <= active_threads_; i++) {
+    if (histograms_[i] != NULL) {
+      result->merge(histograms_[i][type]);
+    }
+  }
+}
+
+bool Benchmark::perf_counter(PerfCounters::Event event, uint64_t *total) {
+  *total = 0;
+  for (uint64_t i = 1; i <= active_threads_; i++) {
+    if (perf_counters_[i] == NULL || !perf_counters_[i]->available(event)) {
+      return false;
+    }
+    *total += perf_counters_[i]->value(event);
+  }
+  return true;
+}
+
 void Benchmark::startup_thread() {
-  scal::tlalloc_init(thread_prealloc_size_, true /* touch pages */);
-  //set_core_affinity();
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  // Pin before touching the thread-local memory, so that it is allocated
+  // close to the cpu the thread runs on.
+  if (thread_cpus_ != NULL) {
+    set_core_affinity();
+  }
+  scal::tlalloc_init(thread_prealloc_size_, true /* touch pages */);
   if (thread_id == 0) {
     fprintf(stderr, "%s: error: thread_id should be main thread. "
                     "Did you forged to init the main thread?\n", __func__);
     abort();
   }
-  int rc = pthread_barrier_wait(&start_barrier_);
-  if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) {
-    fprintf(stderr, "%s: pthread_barrier_wait failed.\n", __func__);
-    abort();
+  prefault_times_[thread_id * kCounterStride] = scal::tlalloc_prefault_time();
+  if (num_histograms_ > 0) {
+    // Allocated by the worker itself to keep the histograms in its local
+    // memory.
+    Histogram *histograms = static_cast<Histogram*>(scal::malloc_aligned(
+        num_histograms_ * sizeof(Histogram), scal::kPageSize));
+    for (uint64_t i = 0; i < num_histograms_; i++) {
+      new(&histograms[i]) Histogram();
+    }
+    histograms_[thread_id] = histograms;
   }
-  if (global_start_time_ == 0) {
-    __sync_bool_compare_and_swap(&global_start_time_, 0, get_utime());
+  // Allocated and faulted in by the worker, as its buffer should be local
+  // memory as well.
+  Workload *workload = new Workload(workload_buffer_size_);
+  workloads_[thread_id] = workload;
+  PerfCounters *perf_counters = NULL;
+  if (FLAGS_perf_counters) {
+    perf_counters = static_cast<PerfCounters*>(scal::malloc_aligned(
+        sizeof(PerfCounters), scal::kCachePrefetch));
+    new(perf_counters) PerfCounters();
+    perf_counters->open();
+    perf_counters_[thread_id] = perf_counters;
   }
-  bench_func();
+  wait_barrier();
+  while (true) {
+    wait_barrier();
+    if (shutdown_) {
+      break;
+    }
+    // Inactive threads sit out the trial in the barriers.
+    const bool active = thread_id <= active_threads_;
+    const AllocStats allocated = scal::alloc_stats();
+    if (active) {
+      setup_func();
+    }
+    wait_barrier();
+    if (active) {
+      if (start_barrier_ != NULL) {
+        start_barrier_->wait();
+      }
+      if (global_start_time_ == 0) {
+        __sync_bool_compare_and_swap(&global_start_time_, 0, get_utime());
+      }
+      thread_starts_[thread_id * kCounterStride] = get_hwtime();
+      if (__sync_add_and_fetch(&started_threads_, 1) == active_threads_) {
+        window_start_operations_ = sum_operations();
+        window_start_ = get_hwtime();
+        __sync_synchronize();
+        window_opened_ = true;
+      }
+      if (perf_counters != NULL) {
+        perf_counters->start();
+      }
+      bench_func();
+      if (perf_counters != NULL) {
+        perf_counters->stop();
+      }
+      uint64_t end = get_hwtime();
+      thread_ends_[thread_id * kCounterStride] = end;
+      AllocStats now = scal::alloc_stats();
+      now.subtract(allocated);
+      alloc_stats_[thread_id] = now;
+      // A window that is still being opened counts as empty.
+      if (__sync_bool_compare_and_swap(&window_closed_, false, true)) {
+        window_end_operations_ = sum_operations();
+        window_end_ = end;
+        window_valid_ = window_opened_;
+      }
+      // The last thread to finish stops the clock.
+      if (__sync_add_and_fetch(&finished_threads_, 1) == active_threads_) {
+        global_end_time_ = get_utime();
+      }
+    }
+    wait_barrier();
+    // Objects of the last trial are dead, the next one starts over on the
+    // same memory.
+    scal::tlalloc_reset();
+  }
+  if (perf_counters != NULL) {
+    perf_counters->close();
+  }
+  workloads_[thread_id] = NULL;
+  delete workload;
+}
+
+double Benchmark::ramp_up(void) {
+  uint64_t first = UINT64_MAX;
+  uint64_t last = 0;
+  for (uint64_t i = 1; i <= active_threads_; i++) {
+    uint64_t start = thread_starts_[i * kCounterStride];
+    first = (start < first) ? start : first;
+    last = (start > last) ? start : last;
+  }
+  return (last - first) / ticks_per_usec_;
+}
+
+double Benchmark::tail(void) {
+  uint64_t first = UINT64_MAX;
+  uint64_t last = 0;
+  for (uint64_t i = 1; i <= active_threads_; i++) {
+    uint64_t end = thread_ends_[i * kCounterStride];
+    first = (end < first) ? end : first;
+    last = (end > last) ? end : last;
+  }
+  return (last - first) / ticks_per_usec_;
+}
+
+double Benchmark::steady_time(void) {
+  if (!window_valid_ || window_end_ <= window_start_) {
+    return 0;
+  }
+  return (window_end_ - window_start_) / ticks_per_usec_;
 }
 
 uint64_t Benchmark::thread_id(void) {
   return scal::ThreadContext::get().thread_id();
 }
 
+Workload* Benchmark::workload(void) {
+  return workloads_[thread_id()];
+}
+
+Histogram* Benchmark::histogram(uint64_t type) {
+  if (type >= num_histograms_) {
+    return NULL;
+  }
+  return &histograms_[thread_id()][type];
+}
+
 }  // namespace scal
@@ -11,28 +11,193 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "util/barrier.h"
+#include "util/histogram.h"
+#include "util/malloc.h"
+#include "util/perf_counters.h"
+#include "util/workloads.h"
+
 namespace scal {
 
+struct ThroughputSample {
+  uint64_t time;        // us since the start of the benchmark
+  uint64_t operations;  // operations completed since the previous sample
+};
+
 class Benchmark {
  public:
   Benchmark(uint64_t num_threads,
             uint64_t thread_prealloc_size,
-            uint64_t histogram_size,
+            uint64_t num_histograms,
             void *data);
+
+  // Runs one trial. The worker threads are created by the first trial and
+  // wait for the next one in between, so that their thread-local memory is
+  // only set up once.
   void run(void);
 
+  // Terminates the worker threads.
+  void shutdown(void);
+
+  // Runs the next trials on the first |num_threads| worker threads only,
+  // while the others wait for the trial to end. Allows sweeping over thread
+  // counts with one set of worker threads. Defaults to all threads.
+  void set_active_threads(uint64_t num_threads);
+
+  inline uint64_t active_threads(void) {
+    return active_threads_;
+  }
+
+  // Sets the data (structure) the next trial operates on.
+  inline void set_data(void *data) {
+    data_ = data;
+  }
+
   inline uint64_t execution_time(void) {
     return global_end_time_ - global_start_time_;
   }
 
+  // Hwtime stamps of when thread |thread_id| started and finished its part
+  // of the last trial.
+  inline uint64_t thread_start(uint64_t thread_id) {
+    return thread_starts_[thread_id * kCounterStride];
+  }
+
+  inline uint64_t thread_end(uint64_t thread_id) {
+    return thread_ends_[thread_id * kCounterStride];
+  }
+
+  // Time (us) thread |thread_id| spent on its part of the last trial.
+  inline double thread_time(uint64_t thread_id) {
+    return (thread_ends_[thread_id * kCounterStride] -
+            thread_starts_[thread_id * kCounterStride]) / ticks_per_usec_;
+  }
+
+  // Time (us) from the first to the last thread starting the last trial.
+  double ramp_up(void);
+
+  // Time (us) from the first to the last thread finishing the last trial.
+  double tail(void);
+
+  // Time (us) of the last trial during which all threads were running, i.e.,
+  // from the last thread starting to the first thread finishing. 0 if a
+  // thread finished before the last one started.
+  double steady_time(void);
+
+  // Operations completed during steady_time().
+  inline uint64_t steady_operations(void) {
+    return (steady_time() > 0) ? window_end_operations_ -
+                                 window_start_operations_ : 0;
+  }
+
+  // Runs the benchmark for |duration| ms instead of until all worker threads
+  // return. Worker threads are expected to poll stopped().
+  inline void set_duration(uint64_t duration) {
+    duration_ = duration;
+  }
+
+  // Samples the operation counters every |interval| ms during the run and
+  // prints each sample.
+  inline void set_sample_interval(uint64_t interval) {
+    sample_interval_ = interval;
+  }
+
+  // Whether samples are printed as they are taken (default) or only kept.
+  inline void set_print_samples(bool print_samples) {
+    print_samples_ = print_samples;
+  }
+
+  inline uint64_t num_samples(void) {
+    return num_samples_;
+  }
+
+  inline const ThroughputSample& sample(uint64_t i) {
+    return samples_[i];
+  }
+
+  // Number of operations completed by thread |thread_id|.
+  inline uint64_t operations(uint64_t thread_id) {
+    return operation_counters_[thread_id * kCounterStride];
+  }
+
+  // Sets the units of work the worker threads perform between two operations
+  // (see Workload). If --c_ns is given, the units are instead calibrated to
+  // take that long.
+  void set_workload(uint64_t units);
+
+  inline uint64_t workload_units(void) {
+    return workload_units_;
+  }
+
+  // Allocations of thread |thread_id| during the last trial, including
+  // setup_func().
+  inline const AllocStats& alloc_stats(uint64_t thread_id) {
+    return alloc_stats_[thread_id];
+  }
+
+  // Time (us) until the slowest worker thread had faulted in its
+  // thread-local memory. The workers do so concurrently.
+  uint64_t prefault_time(void);
+
+  // Merges histogram |type| of all worker threads into |result|.
+  void merge_histograms(uint64_t type, Histogram *result);
+
+  // Histogram |type| of worker thread |thread_id|, or NULL if the benchmark
+  // does not keep it.
+  inline const Histogram* thread_histogram(uint64_t thread_id,
+                                           uint64_t type) {
+    if (type >= num_histograms_ || histograms_[thread_id] == NULL) {
+      return NULL;
+    }
+    return &histograms_[thread_id][type];
+  }
+
+  // Sums |event| over all worker threads for the last trial. Returns false
+  // if performance counters are disabled or |event| is not available.
+  bool perf_counter(PerfCounters::Event event, uint64_t *total);
+
+  // Pinning policy given by --pin, or NULL if threads are not pinned.
+  inline const char* placement(void) {
+    return placement_;
+  }
+
+  // Cpu thread |thread_id| is pinned to, or -1 if it is not pinned.
+  inline int cpu(uint64_t thread_id) {
+    return (thread_cpus_ != NULL) ? thread_cpus_[thread_id] : -1;
+  }
+
  protected:
   virtual ~Benchmark() {}
 
   void *data_;
 
   virtual void bench_func(void) = 0;
+
+  // Called by every worker thread before the measured phase of each trial,
+  // e.g., to prefill the data structure.
+  virtual void setup_func(void) {}
   uint64_t thread_id(void);
 
+  // Returns the calling thread's histogram |type|, or NULL if the benchmark
+  // does not keep any histograms. Worker threads should look up their
+  // histograms once and not per operation.
+  Histogram* histogram(uint64_t type);
+
+  // Returns the calling thread's workload. Worker threads should look it up
+  // once and not per operation.
+  Workload* workload(void);
+
+  // Returns the calling thread's operation counter. Worker threads increment
+  // it for each completed operation.
+  inline volatile uint64_t* operation_counter(void) {
+    return &operation_counters_[thread_id() * kCounterStride];
+  }
+
+  // Set once a timed run is over.
+  inline bool stopped(void) {
+    return stop_;
+  }
+
   inline uint64_t num_threads() {
     return num_threads_;
   }
@@ -47,15 +212,70 @@ class Benchmark {
     return NULL;
   }
 
-  pthread_barrier_t start_barrier_;
+  // Each counter sits on its own prefetch-sized line.
+  static const uint64_t kCounterStride = 16;
+  // Upper bound on how long the monitor sleeps between checks (us).
+  static const uint64_t kMonitorMaxSleep = 100000;
+  // RT priorities; the monitor has to be able to preempt the workers.
+  static const int kWorkerPriority = 40;
+  static const int kMonitorPriority = kWorkerPriority + 1;
+
+  // Shared by the workers and the main thread to start and end trials.
+  pthread_barrier_t barrier_;
+  // Aligns the start of the active workers after barrier_ (--spin_barrier).
+  SpinningBarrier *start_barrier_;
   pthread_t *threads_;
+  bool started_;
+  volatile bool shutdown_;
+  bool elevated_;
+  int main_policy_;
+  struct sched_param main_param_;
   uint64_t num_threads_;
+  uint64_t active_threads_;
   uint64_t global_start_time_;
   uint64_t global_end_time_;
   uint64_t thread_prealloc_size_;
+  uint64_t num_histograms_;
+  Histogram **histograms_;
+  PerfCounters **perf_counters_;
+  Workload **workloads_;
+  uint64_t workload_buffer_size_;
+  uint64_t workload_units_;
+  volatile uint64_t *operation_counters_;
+  AllocStats *alloc_stats_;
+  uint64_t *prefault_times_;
+  uint64_t *thread_starts_;
+  uint64_t *thread_ends_;
+  double ticks_per_usec_;
+  // The steady-state window, opened by the last thread to start and closed
+  // by the first one to finish.
+  uint64_t started_threads_;
+  volatile bool window_opened_;
+  bool window_closed_;
+  bool window_valid_;
+  uint64_t window_start_;
+  uint64_t window_end_;
+  uint64_t window_start_operations_;
+  uint64_t window_end_operations_;
+  volatile bool stop_;
+  uint64_t finished_threads_;
+  uint64_t duration_;
+  uint64_t sample_interval_;
+  ThroughputSample *samples_;
+  uint64_t num_samples_;
+  uint64_t max_samples_;
+  bool print_samples_;
+  const char *placement_;
+  int *thread_cpus_;
 
   void startup_thread(void);
-  void set_core_affinity();
+  void start_threads(void);
+  void wait_barrier(void);
+  void monitor(void);
+  void take_sample(uint64_t now, uint64_t *last_operations);
+  uint64_t sum_operations(void);
+  void setup_placement(void);
+  void set_core_affinity(void);
   void setup_pthread_attr(pthread_attr_t *attr);
   bool can_modify_sched();
 
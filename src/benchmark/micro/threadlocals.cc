@@ -0,0 +1,186 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Micro-benchmark for the thread-local context lookup: Reports the hwtime
+// ticks per call of a lookup through pthread_getspecific, as
+// ThreadContext::get did it before caching the context in a __thread
+// variable, of ThreadContext::get itself, and of the single-threaded hot
+// paths that depend on it: the pseudo-random generators and their bounded
+// ranges, the id balancer of distributed queues, and operations of the
+// Michael-Scott queue, the k-Stack (including the emptiness check of an
+// empty one), and the TS stack, queue, and deque.
+
+#define __STDC_FORMAT_MACROS 1  // we want PRIu64 and friends
+
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "datastructures/balancer_id.h"
+#include "datastructures/kstack.h"
+#include "datastructures/ms_queue.h"
+#include "datastructures/ts_deque.h"
+#include "datastructures/ts_deque_buffer.h"
+#include "datastructures/ts_queue.h"
+#include "datastructures/ts_queue_buffer.h"
+#include "datastructures/ts_stack.h"
+#include "datastructures/ts_stack_buffer.h"
+#include "datastructures/ts_timestamp.h"
+#include "util/malloc.h"
+#include "util/random.h"
+#include "util/threadlocals.h"
+#include "util/time.h"
+
+DECLARE_bool(disable_tl_allocator);
+
+DEFINE_uint64(operations, 10000000, "number of calls per measurement");
+DEFINE_uint64(k, 80, "range of the bounded pseudo-random numbers");
+
+namespace {
+
+pthread_key_t key;
+
+// Lookups are kept out of line so that the compiler cannot hoist them out
+// of the measurement loops.
+__attribute__((noinline)) uint64_t getspecific_thread_id(void) {
+  return static_cast<scal::ThreadContext*>(
+      pthread_getspecific(key))->thread_id();
+}
+
+__attribute__((noinline)) uint64_t context_thread_id(void) {
+  return scal::ThreadContext::get().thread_id();
+}
+
+template<typename F>
+void measure(const char *name, F f) {
+  uint64_t sum = 0;
+  uint64_t start = get_hwtime();
+  for (uint64_t i = 0; i < FLAGS_operations; i++) {
+    sum += f();
+  }
+  uint64_t end = get_hwtime();
+  printf("%-24s %8.2f ticks/call  (checksum %" PRIu64 ")\n", name,
+         static_cast<double>(end - start) / FLAGS_operations, sum);
+}
+
+uint64_t rand_range_k(void) {
+  return scal::rand_range(0, FLAGS_k);
+}
+
+uint64_t pseudorand_k(void) {
+  return pseudorand() % FLAGS_k;
+}
+
+BalancerId *balancer;
+
+uint64_t balancer_id_k(void) {
+  return balancer->get(FLAGS_k, NULL, true);
+}
+
+MSQueue<uint64_t> *queue;
+
+uint64_t queue_roundtrip(void) {
+  uint64_t item;
+  queue->enqueue(1);
+  queue->dequeue(&item);
+  return item;
+}
+
+KStack<uint64_t> *kstack;
+KStack<uint64_t> *empty_kstack;
+
+uint64_t kstack_roundtrip(void) {
+  uint64_t item;
+  kstack->push(1);
+  kstack->pop(&item);
+  return item;
+}
+
+uint64_t kstack_pop_empty(void) {
+  uint64_t item;
+  return empty_kstack->pop(&item);
+}
+
+TSStack<uint64_t, TSStackBuffer<uint64_t, HardwareTimestamp>,
+        HardwareTimestamp> *ts_stack;
+
+uint64_t ts_stack_roundtrip(void) {
+  uint64_t item;
+  ts_stack->push(1);
+  ts_stack->pop(&item);
+  return item;
+}
+
+TSQueue<uint64_t, TSQueueBuffer<uint64_t, HardwareTimestamp>,
+        HardwareTimestamp> *ts_queue;
+
+uint64_t ts_queue_roundtrip(void) {
+  uint64_t item;
+  ts_queue->enqueue(1);
+  ts_queue->dequeue(&item);
+  return item;
+}
+
+TSDeque<uint64_t, TSDequeBuffer<uint64_t, HardwareTimestamp>,
+        HardwareTimestamp> *ts_deque;
+
+uint64_t ts_deque_roundtrip(void) {
+  uint64_t item;
+  ts_deque->put(1);
+  ts_deque->get(&item);
+  return item;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  scal::ThreadContext::prepare(1);
+  scal::ThreadContext::assign_context();
+  scal::tlalloc_init(1024, true);
+  pthread_key_create(&key, NULL);
+  pthread_setspecific(key, &scal::ThreadContext::get());
+  // The thread-local buffer wraps around during the measurements, so the
+  // data structures and the per-thread state they create on their first
+  // operation are taken from malloc.
+  FLAGS_disable_tl_allocator = true;
+  balancer = new BalancerId();
+  queue = new MSQueue<uint64_t>();
+  kstack = new KStack<uint64_t>(FLAGS_k);
+  empty_kstack = new KStack<uint64_t>(FLAGS_k);
+  ts_stack = new TSStack<uint64_t, TSStackBuffer<uint64_t, HardwareTimestamp>,
+                         HardwareTimestamp>(1, 0);
+  ts_queue = new TSQueue<uint64_t, TSQueueBuffer<uint64_t, HardwareTimestamp>,
+                         HardwareTimestamp>(1, 0);
+  ts_deque = new TSDeque<uint64_t, TSDequeBuffer<uint64_t, HardwareTimestamp>,
+                         HardwareTimestamp>(1, 0);
+  queue_roundtrip();
+  kstack_roundtrip();
+  kstack_pop_empty();
+  ts_stack_roundtrip();
+  ts_queue_roundtrip();
+  ts_deque_roundtrip();
+  FLAGS_disable_tl_allocator = false;
+
+  measure("pthread_getspecific", getspecific_thread_id);
+  measure("ThreadContext::get", context_thread_id);
+  measure("pseudorand", pseudorand);
+  measure("pseudorand() % k", pseudorand_k);
+  scal::set_rand_generator(scal::kRandMinStd);
+  measure("rand (minstd)", scal::rand);
+  measure("rand_range (minstd)", rand_range_k);
+  scal::set_rand_generator(scal::kRandXoshiro);
+  measure("rand (xoshiro)", scal::rand);
+  measure("rand_range (xoshiro)", rand_range_k);
+  measure("BalancerId::get", balancer_id_k);
+  measure("ms enqueue+dequeue", queue_roundtrip);
+  measure("kstack push+pop", kstack_roundtrip);
+  measure("kstack pop (empty)", kstack_pop_empty);
+  measure("ts-stack push+pop", ts_stack_roundtrip);
+  measure("ts-queue enqueue+dequeue", ts_queue_roundtrip);
+  measure("ts-deque put+get", ts_deque_roundtrip);
+  return 0;
+}
@@ -0,0 +1,496 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Mixed workload: Every thread performs both put and get operations in a
+// configurable ratio, as opposed to the dedicated producers and consumers of
+// the producer/consumer benchmark.
+
+#define __STDC_FORMAT_MACROS 1  // we want PRIu64 and friends
+
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark/common.h"
+#include "benchmark/result.h"
+#include "benchmark/std_glue/std_pipe_api.h"
+#include "datastructures/pool.h"
+#include "util/malloc.h"
+#include "util/numa.h"
+#include "util/platform.h"
+#include "util/random.h"
+#include "util/statistics.h"
+#include "util/threadlocals.h"
+#include "util/time.h"
+#include "util/workloads.h"
+
+DEFINE_string(prealloc_size, "1g", "tread local space that is initialized");
+DEFINE_uint64(threads, 2, "number of threads");
+DEFINE_uint64(operations, 1000, "number of operations per thread");
+DEFINE_uint64(duration, 0, "run for the given number of ms instead of a "
+                           "fixed number of operations (0: disabled)");
+DEFINE_uint64(sample_interval, 0, "print the throughput every given number "
+                                  "of ms (0: disabled)");
+DEFINE_uint64(put_ratio, 50, "percentage of put operations");
+DEFINE_uint64(prefill, 0, "number of items put into the data structure "
+                          "before the measurement starts");
+DEFINE_uint64(c, 5000, "computational workload (units of work, see c_ns and "
+                         "c_buffer)");
+DEFINE_bool(print_summary, true, "print execution summary");
+DEFINE_bool(latency, false, "record per-operation latency histograms (in "
+                            "cycles) and print their percentiles");
+DEFINE_uint64(trials, 1, "number of measured trials, each on a fresh data "
+                         "structure");
+DEFINE_uint64(warmup, 0, "number of unmeasured trials before the measured "
+                         "ones");
+DEFINE_bool(fairness, false, "report the distribution of operations, "
+                             "retries, completion times, and p99 latencies "
+                             "over the threads");
+DEFINE_string(format, "text", "result format: text (summary line), json (one "
+                              "object per line), or csv");
+
+DECLARE_uint64(c_ns);
+DECLARE_string(c_buffer);
+DECLARE_string(numa_arenas);
+DECLARE_string(huge_pages);
+
+using scal::Benchmark;
+using scal::Histogram;
+using scal::PerfCounters;
+using scal::Result;
+using scal::Statistics;
+
+namespace {
+
+enum LatencyType {
+  kPutLatency = 0,
+  kGetLatency = 1,
+  kNumLatencyTypes
+};
+
+const char *kLatencyTypeNames[] = { "put", "get" };
+
+// Per-thread counters of all threads, each on its own prefetch line.
+const uint64_t kEmptyGetsStride = 16;
+
+// Returns the data structure of binaries named mixed-<data structure>, or
+// an empty name otherwise.
+const char* ds_name(const char *argv0) {
+  const char *name = strrchr(argv0, '/');
+  name = (name != NULL) ? name + 1 : argv0;
+  if (strncmp(name, "mixed-", 6) == 0) {
+    return name + 6;
+  }
+  return "";
+}
+
+}  // namespace
+
+class MixedBench : public Benchmark {
+ public:
+  MixedBench(uint64_t num_threads,
+             uint64_t thread_prealloc_size,
+             uint64_t num_histograms,
+             void *data)
+                 : Benchmark(num_threads,
+                             thread_prealloc_size,
+                             num_histograms,
+                             data) {
+    empty_gets_ = static_cast<uint64_t*>(scal::calloc_aligned(
+        (num_threads + 1) * kEmptyGetsStride, sizeof(uint64_t),
+        scal::kCachePrefetch));
+    puts_ = static_cast<uint64_t*>(scal::calloc_aligned(
+        (num_threads + 1) * kEmptyGetsStride, sizeof(uint64_t),
+        scal::kCachePrefetch));
+  }
+
+  inline uint64_t empty_gets(uint64_t thread_id) {
+    return empty_gets_[thread_id * kEmptyGetsStride];
+  }
+
+  inline uint64_t puts(uint64_t thread_id) {
+    return puts_[thread_id * kEmptyGetsStride];
+  }
+
+ protected:
+  void setup_func(void);
+  void bench_func(void);
+
+ private:
+  uint64_t *empty_gets_;
+  uint64_t *puts_;
+};
+
+uint64_t g_num_threads;
+
+int main(int argc, const char **argv) {
+  std::string usage("Mixed put/get micro benchmark.");
+  google::SetUsageMessage(usage);
+  google::ParseCommandLineFlags(&argc, const_cast<char***>(&argv), true);
+
+  uint64_t tlsize = scal::human_size_to_pages(FLAGS_prealloc_size.c_str(),
+                                              FLAGS_prealloc_size.size());
+
+  g_num_threads = FLAGS_threads;
+  scal::tlalloc_init(tlsize, true /* touch pages */);
+  scal::ThreadContext::prepare(g_num_threads + 1);
+  scal::ThreadContext::assign_context();
+
+  if (FLAGS_threads == 0 || FLAGS_put_ratio > 100) {
+    fprintf(stderr, "%s: error: need at least one thread and a put ratio "
+                    "of at most 100\n", __func__);
+    abort();
+  }
+  // Binaries named mixed-<data structure> default to that structure.
+  std::vector<std::string> structures;
+  if (!ds_parse_list(FLAGS_ds.empty() ? ds_name(argv[0]) : FLAGS_ds,
+                     &structures)) {
+    if (structures.back().empty()) {
+      fprintf(stderr, "%s: error: no data structure selected, use --ds with "
+                      "one of: %s\n", __func__, ds_names().c_str());
+    } else {
+      fprintf(stderr, "%s: error: unknown data structure %s, use --ds with "
+                      "one of: %s\n",
+              __func__, structures.back().c_str(), ds_names().c_str());
+    }
+    abort();
+  }
+  if (FLAGS_trials == 0) {
+    fprintf(stderr, "%s: error: at least one trial is needed\n", __func__);
+    abort();
+  }
+  Result::Format format;
+  if (!Result::parse_format(FLAGS_format, &format)) {
+    fprintf(stderr, "%s: error: unknown result format %s\n",
+            __func__, FLAGS_format.c_str());
+    abort();
+  }
+
+  MixedBench *benchmark = new MixedBench(
+      g_num_threads,
+      tlsize,
+      FLAGS_latency ? kNumLatencyTypes : 0,
+      NULL);
+  benchmark->set_duration(FLAGS_duration);
+  benchmark->set_sample_interval(FLAGS_sample_interval);
+  benchmark->set_workload(FLAGS_c);
+  benchmark->set_print_samples(format == Result::kText);
+
+  // All structures run on the same worker threads and thread-local memory.
+  std::vector<Statistics> throughputs(structures.size());
+  bool first_run = true;
+  for (uint64_t d = 0; d < structures.size(); d++) {
+    ds_select(structures[d]);
+    const char *ds = structures[d].c_str();
+    for (uint64_t trial = 0; trial < FLAGS_warmup + FLAGS_trials; trial++) {
+      if (!first_run) {
+        scal::tlalloc_reset();
+      }
+      first_run = false;
+      const scal::AllocStats before = scal::alloc_stats();
+      benchmark->set_data(ds_new());
+      scal::AllocStats created = scal::alloc_stats();
+      created.subtract(before);
+      benchmark->run();
+      if (trial < FLAGS_warmup || !FLAGS_print_summary) {
+        continue;
+      }
+
+      uint64_t exec_time = benchmark->execution_time();
+      uint64_t operations = 0;
+      uint64_t empty_gets = 0;
+      uint64_t puts = 0;
+      for (uint64_t i = 1; i <= g_num_threads; i++) {
+        operations += benchmark->operations(i);
+        empty_gets += benchmark->empty_gets(i);
+        puts += benchmark->puts(i);
+      }
+      // Elements the data structure held at least: the prefill at the start,
+      // and what is left at the end.
+      const uint64_t gets = operations - puts - empty_gets;
+      const uint64_t peak_elements =
+          std::max(FLAGS_prefill, FLAGS_prefill + puts - gets);
+      // Memory of the data structure, allocated by its creation and by the
+      // workers. Memory that is reclaimed and reused is only counted once,
+      // so it is compared to the most elements the data structure held.
+      scal::AllocStats allocated = created;
+      for (uint64_t i = 1; i <= g_num_threads; i++) {
+        allocated.add(benchmark->alloc_stats(i));
+      }
+      const uint64_t mem_requested = allocated.requested;
+      const uint64_t mem_consumed = allocated.consumed;
+      const uint64_t mem_init = created.consumed;
+      if (allocated.wrap_arounds > 0) {
+        fprintf(stderr, "warning: thread-local memory wrapped around %" PRIu64
+                " times, the trial may have overwritten live objects; "
+                "increase --prealloc_size\n", allocated.wrap_arounds);
+      }
+      double bytes_per_element = (peak_elements == 0) ? 0 :
+          static_cast<double>(mem_consumed) / peak_elements;
+      // Time the main thread and the workers took to fault in their
+      // thread-local memory.
+      const uint64_t prefault_time =
+          scal::tlalloc_prefault_time() + benchmark->prefault_time();
+      const uint64_t huge_page_bytes = scal::huge_page_bytes();
+      double trial_throughput =
+          operations / (static_cast<double>(exec_time) / 1000);
+      throughputs[d].add(trial_throughput);
+      // Throughput while all threads were running, without the ramp-up and
+      // the tail.
+      double steady_time = benchmark->steady_time();
+      double steady_throughput = (steady_time == 0) ? 0 :
+          benchmark->steady_operations() / (steady_time / 1000);
+
+      Result result;
+      result.add("record", "trial");
+      result.add("benchmark", "mixed");
+      result.add("ds", ds);
+      result.add("trial", trial - FLAGS_warmup);
+      result.add_column("threads", FLAGS_threads);
+      result.add_column("put_ratio", FLAGS_put_ratio);
+      result.add_column("prefill", FLAGS_prefill);
+      result.add_column("exec_time", exec_time);
+      result.add_column("ops", operations / FLAGS_threads);
+      result.add_column("workload", benchmark->workload_units());
+      if (FLAGS_c_ns > 0) {
+        result.add("workload_ns", FLAGS_c_ns);
+      }
+      if (FLAGS_c_buffer != "0") {
+        result.add("workload_buffer", FLAGS_c_buffer.c_str());
+      }
+      result.add_column("throughput", static_cast<uint64_t>(trial_throughput));
+      result.add("operations", operations);
+      result.add("steady_time", steady_time);
+      result.add("steady_throughput", steady_throughput);
+      result.add("ramp_up", benchmark->ramp_up());
+      result.add("tail", benchmark->tail());
+      result.add("empty_gets", empty_gets);
+      result.add("mem_requested", mem_requested);
+      result.add("mem_consumed", mem_consumed);
+      result.add("mem_init", mem_init);
+      result.add("peak_elements", peak_elements);
+      result.add("bytes_per_element", bytes_per_element);
+      result.add("alloc_bumped", allocated.bumped);
+      result.add("alloc_wrap_arounds", allocated.wrap_arounds);
+      result.add("alloc_fallbacks", allocated.fallbacks);
+      result.add("alloc_alignment_waste", allocated.alignment_waste);
+      result.add("alloc_local_frees", allocated.local_frees);
+      result.add("alloc_remote_frees", allocated.remote_frees);
+      result.add("peak_rss", scal::peak_rss());
+      result.add("prefault_time", prefault_time);
+      result.add("huge_pages", FLAGS_huge_pages.c_str());
+      result.add("huge_page_bytes", huge_page_bytes);
+      result.add("numa_nodes", scal::numa_num_nodes());
+      result.add("numa_arenas", FLAGS_numa_arenas.c_str());
+      result.add("numa_shared", FLAGS_numa_shared.c_str());
+      Histogram latencies[kNumLatencyTypes];
+      for (uint64_t i = 0; FLAGS_latency && (i < kNumLatencyTypes); i++) {
+        benchmark->merge_histograms(i, &latencies[i]);
+        result.add_percentiles(kLatencyTypeNames[i], latencies[i]);
+      }
+      std::string events;
+      for (uint64_t i = 0; i < PerfCounters::kNumEvents; i++) {
+        PerfCounters::Event event = static_cast<PerfCounters::Event>(i);
+        uint64_t total;
+        if (operations == 0 || !benchmark->perf_counter(event, &total)) {
+          continue;
+        }
+        double per_operation = static_cast<double>(total) / operations;
+        char name[64];
+        snprintf(name, sizeof(name), "%s_per_op", PerfCounters::name(event));
+        result.add(name, per_operation);
+        snprintf(name, sizeof(name), " %s=%.3f",
+                 PerfCounters::name(event), per_operation);
+        events += name;
+      }
+      if (benchmark->placement() != NULL) {
+        result.add("placement", benchmark->placement());
+      }
+      // Per-thread distributions. Retries are gets that found the data
+      // structure empty.
+      Statistics thread_operations;
+      Statistics thread_times;
+      Statistics retries;
+      uint64_t worst_p99[kNumLatencyTypes] = { 0 };
+      uint64_t worst_thread[kNumLatencyTypes] = { 0 };
+      for (uint64_t i = 1; FLAGS_fairness && (i <= g_num_threads); i++) {
+        thread_operations.add(benchmark->operations(i));
+        thread_times.add(benchmark->thread_time(i));
+        retries.add(benchmark->empty_gets(i));
+        for (uint64_t j = 0; FLAGS_latency && (j < kNumLatencyTypes); j++) {
+          const Histogram *histogram = benchmark->thread_histogram(i, j);
+          if (histogram == NULL || histogram->count() == 0) {
+            continue;
+          }
+          if (histogram->percentile(99) >= worst_p99[j]) {
+            worst_p99[j] = histogram->percentile(99);
+            worst_thread[j] = i;
+          }
+        }
+      }
+      // Without --duration every thread completes the same number of
+      // operations, so only their completion times can differ.
+      const bool timed = FLAGS_duration > 0;
+      if (FLAGS_fairness && timed) {
+        result.add_fairness("thread_ops", thread_operations);
+      }
+      if (FLAGS_fairness) {
+        result.add_fairness("thread_time", thread_times);
+        result.add_fairness("thread_retries", retries);
+      }
+      for (uint64_t i = 0; FLAGS_fairness && FLAGS_latency &&
+                           (i < kNumLatencyTypes); i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s_worst_p99", kLatencyTypeNames[i]);
+        result.add(name, worst_p99[i]);
+        snprintf(name, sizeof(name), "%s_worst_thread", kLatencyTypeNames[i]);
+        result.add(name, worst_thread[i]);
+      }
+      ds_get_stats(&result);
+      result.print(stdout, format, trial == FLAGS_warmup);
+
+      if (format == Result::kText) {
+        for (uint64_t i = 0; FLAGS_latency && (i < kNumLatencyTypes); i++) {
+          printf("%s latency (cycles): n=%" PRIu64 " p50=%" PRIu64
+                 " p90=%" PRIu64 " p99=%" PRIu64 " p99.9=%" PRIu64
+                 " max=%" PRIu64 "\n",
+                 kLatencyTypeNames[i],
+                 latencies[i].count(),
+                 latencies[i].percentile(50),
+                 latencies[i].percentile(90),
+                 latencies[i].percentile(99),
+                 latencies[i].percentile(99.9),
+                 latencies[i].max());
+        }
+        if (!events.empty()) {
+          printf("events per operation:%s\n", events.c_str());
+        }
+        printf("steady state: time=%.0fus throughput=%.0f ramp_up=%.1fus "
+               "tail=%.1fus\n", steady_time, steady_throughput,
+               benchmark->ramp_up(), benchmark->tail());
+        printf("memory (bytes): requested=%" PRIu64 " consumed=%" PRIu64
+               " init=%" PRIu64 " peak_elements=%" PRIu64 " per_element=%.1f"
+               " peak_rss=%" PRIu64 " prefault_time=%" PRIu64 "us"
+               " huge_pages=%" PRIu64 "\n",
+               mem_requested, mem_consumed, mem_init, peak_elements,
+               bytes_per_element,
+               scal::peak_rss(), prefault_time, huge_page_bytes);
+        printf("allocator: bumped=%" PRIu64 " wrap_arounds=%" PRIu64
+               " fallbacks=%" PRIu64 " alignment_waste=%" PRIu64
+               " local_frees=%" PRIu64 " remote_frees=%" PRIu64 "\n",
+               allocated.bumped, allocated.wrap_arounds, allocated.fallbacks,
+               allocated.alignment_waste, allocated.local_frees,
+               allocated.remote_frees);
+        if (FLAGS_fairness && timed) {
+          Result::print_fairness(stdout, "ops", thread_operations);
+        }
+        if (FLAGS_fairness) {
+          Result::print_fairness(stdout, "time (us)", thread_times);
+          Result::print_fairness(stdout, "retries", retries);
+        }
+        for (uint64_t i = 0; FLAGS_fairness && FLAGS_latency &&
+                             (i < kNumLatencyTypes); i++) {
+          printf("%s latency p99 (cycles) per thread: worst=%" PRIu64
+                 " thread=%" PRIu64 "\n",
+                 kLatencyTypeNames[i], worst_p99[i], worst_thread[i]);
+        }
+      }
+    }
+  }
+  benchmark->shutdown();
+
+  for (uint64_t d = 0;
+       FLAGS_print_summary && (FLAGS_trials > 1) && (d < structures.size());
+       d++) {
+    if (format == Result::kText) {
+      // Labels only name the structure if there are several.
+      std::string label = (structures.size() > 1) ? structures[d] + " " : "";
+      Result::print_statistics(
+          stdout, (label + "throughput (operations/ms)").c_str(),
+          throughputs[d]);
+    } else if (format == Result::kJson) {
+      Result aggregate;
+      aggregate.add("record", "aggregate");
+      aggregate.add("benchmark", "mixed");
+      aggregate.add("ds", structures[d].c_str());
+      aggregate.add("trials", FLAGS_trials);
+      aggregate.add_statistics("throughput", throughputs[d]);
+      aggregate.print(stdout, format, false);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// Every thread puts its share of the prefill items, so that data structures
+// with thread-local parts start out balanced.
+void MixedBench::setup_func(void) {
+  Pool<uint64_t> *ds = static_cast<Pool<uint64_t>*>(data_);
+  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  uint64_t items = FLAGS_prefill / FLAGS_threads;
+  if (thread_id <= FLAGS_prefill % FLAGS_threads) {
+    items++;
+  }
+  empty_gets_[thread_id * kEmptyGetsStride] = 0;
+  for (uint64_t i = 1; i <= items; i++) {
+    // Items are never 0, and do not collide with the ones of bench_func.
+    if (!ds->put((thread_id << 48) | (1ul << 47) | i)) {
+      fprintf(stderr, "%s: error: put operation failed.\n", __func__);
+      abort();
+    }
+  }
+}
+
+void MixedBench::bench_func(void) {
+  Pool<uint64_t> *ds = static_cast<Pool<uint64_t>*>(data_);
+  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  Histogram *put_latencies = histogram(kPutLatency);
+  Histogram *get_latencies = histogram(kGetLatency);
+  volatile uint64_t *counter = operation_counter();
+  scal::Workload *workload = this->workload();
+  const uint64_t units = workload_units();
+  uint64_t empty_gets = 0;
+  uint64_t puts = 0;
+  const bool timed = FLAGS_duration > 0;
+  uint64_t item;
+  uint64_t start = 0;
+  bool ok;
+  for (uint64_t i = 1; timed ? !stopped() : (i <= FLAGS_operations); i++) {
+    if (scal::rand_range(0, 100) < FLAGS_put_ratio) {
+      if (put_latencies != NULL) {
+        start = get_hwtime();
+      }
+      if (!ds->put((thread_id << 48) | i)) {
+        fprintf(stderr, "%s: error: put operation failed.\n", __func__);
+        abort();
+      }
+      if (put_latencies != NULL) {
+        put_latencies->add(get_hwtime() - start);
+      }
+      puts++;
+    } else {
+      if (get_latencies != NULL) {
+        start = get_hwtime();
+      }
+      ok = ds->get(&item);
+      if (get_latencies != NULL && ok) {
+        get_latencies->add(get_hwtime() - start);
+      }
+      if (!ok) {
+        empty_gets++;
+      }
+    }
+    // Empty gets are operations as well, they are reported separately.
+    (*counter)++;
+    workload->run(units);
+  }
+  empty_gets_[thread_id * kEmptyGetsStride] = empty_gets;
+  puts_[thread_id * kEmptyGetsStride] = puts;
+}
@@ -12,12 +12,23 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "benchmark/common.h"
+#include "benchmark/result.h"
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/pool.h"
+#include "util/arrivals.h"
+#include "util/backoff.h"
 #include "util/malloc.h"
+#include "util/numa.h"
+#include "util/object_pool.h"
 #include "util/operation_logger.h"
+#include "util/platform.h"
 #include "util/random.h"
+#include "util/statistics.h"
 #include "util/threadlocals.h"
 #include "util/time.h"
 #include "util/workloads.h"
@@ -26,32 +37,170 @@ DEFINE_string(prealloc_size, "1g", "tread local space that is initialized");
 DEFINE_uint64(producers, 1, "number of producers");
 DEFINE_uint64(consumers, 1, "number of consumers");
 DEFINE_uint64(operations, 1000, "number of operations per producer");
-DEFINE_uint64(c, 5000, "computational workload");
+DEFINE_uint64(duration, 0, "run for the given number of ms instead of a "
+                           "fixed number of operations (0: disabled)");
+DEFINE_uint64(sample_interval, 0, "print the throughput every given number "
+                                  "of ms (0: disabled)");
+DEFINE_uint64(c, 5000, "computational workload (units of work, see c_ns and "
+                         "c_buffer)");
 DEFINE_bool(print_summary, true, "print execution summary");
 DEFINE_bool(log_operations, false, "log invocation/response/linearization "
                                    "of all operations");
+DEFINE_bool(latency, false, "record per-operation latency histograms (in "
+                            "cycles) and print their percentiles");
+DEFINE_uint64(trials, 1, "number of measured trials, each on a fresh data "
+                         "structure");
+DEFINE_uint64(warmup, 0, "number of unmeasured trials before the measured "
+                         "ones");
+DEFINE_uint64(rate, 0, "open loop: offered load in puts per ms over all "
+                       "producers (0: closed loop)");
+DEFINE_string(arrivals, "poisson", "open-loop arrival process: poisson or "
+                                   "onoff (bursty)");
+DEFINE_uint64(on_period, 1000, "onoff arrivals: length of a burst in us");
+DEFINE_uint64(off_period, 1000, "onoff arrivals: pause between bursts in us");
+DEFINE_string(backoff, "none", "back-off of consumers after a get found the "
+                              "data structure empty: none, pause, exp, "
+                              "yield, or futex");
+DEFINE_uint64(backoff_pauses, 64, "pause and exp back-off: (initial) number "
+                                  "of pause instructions");
+DEFINE_uint64(backoff_max_pauses, 16384, "exp back-off: maximum number of "
+                                         "pause instructions");
+DEFINE_bool(fairness, false, "report the distribution of operations, "
+                             "retries, completion times, and p99 latencies "
+                             "over the threads of each role");
+DEFINE_string(format, "text", "result format: text (summary line), json (one "
+                              "object per line), or csv");
+
+DECLARE_uint64(c_ns);
+DECLARE_string(c_buffer);
+DECLARE_string(numa_arenas);
+DECLARE_string(huge_pages);
 
 using scal::Benchmark;
+using scal::Histogram;
+using scal::PerfCounters;
+using scal::Result;
+using scal::Statistics;
+
+namespace {
+
+// Latency histograms kept per thread. Sojourn times, from the arrival of an
+// item at the producer to its dequeue, are only kept in open-loop runs.
+enum LatencyType {
+  kPutLatency = 0,
+  kGetLatency = 1,
+  kSojournLatency = 2,
+  kNumLatencyTypes
+};
+
+const char *kLatencyTypeNames[] = { "put", "get", "sojourn" };
+
+// Empty get counters of all threads, each on its own prefetch line.
+const uint64_t kEmptyGetsStride = 16;
+// Producers count the elements in the data structure every that many puts.
+const uint64_t kElementsSampleInterval = 1024;
+
+// Producers and consumers are compared among themselves for --fairness.
+enum Role {
+  kProducer = 0,
+  kConsumer = 1,
+  kNumRoles
+};
+
+const char *kRoleNames[] = { "producer", "consumer" };
+
+// Percentiles of the latency histograms that are aggregated over trials.
+const double kTrialPercentiles[] = { 50, 99 };
+const uint64_t kNumTrialPercentiles = 2;
+
+// Per data structure statistics over its trials.
+struct TrialStatistics {
+  Statistics throughput;
+  Statistics latency[kNumLatencyTypes][kNumTrialPercentiles];
+};
+
+// Returns the data structure of binaries named prodcon-<data structure>, or
+// an empty name otherwise.
+const char* ds_name(const char *argv0) {
+  const char *name = strrchr(argv0, '/');
+  name = (name != NULL) ? name + 1 : argv0;
+  if (strncmp(name, "prodcon-", 8) == 0) {
+    return name + 8;
+  }
+  return "";
+}
+
+inline bool open_loop(void) {
+  return FLAGS_rate > 0;
+}
+
+// Whether histograms of |type| are reported.
+bool recorded(uint64_t type) {
+  return (type == kSojournLatency) ? open_loop() : FLAGS_latency;
+}
+
+}  // namespace
 
 class ProdConBench : public Benchmark {
  public:
   ProdConBench(uint64_t num_threads,
                uint64_t thread_prealloc_size,
-               uint64_t histogram_size,
+               uint64_t num_histograms,
                void *data)
                    : Benchmark(num_threads,
                                thread_prealloc_size,
-                               histogram_size,
-                               data) {}
+                               num_histograms,
+                               data) {
+    empty_gets_ = static_cast<uint64_t*>(scal::calloc_aligned(
+        (num_threads + 1) * kEmptyGetsStride, sizeof(uint64_t),
+        scal::kCachePrefetch));
+    empty_time_ = static_cast<uint64_t*>(scal::calloc_aligned(
+        (num_threads + 1) * kEmptyGetsStride, sizeof(uint64_t),
+        scal::kCachePrefetch));
+    peak_elements_ = static_cast<uint64_t*>(scal::calloc_aligned(
+        (num_threads + 1) * kEmptyGetsStride, sizeof(uint64_t),
+        scal::kCachePrefetch));
+  }
+
+  // Number of gets of consumer |thread_id| that found the data structure
+  // empty.
+  inline uint64_t empty_gets(uint64_t thread_id) {
+    return empty_gets_[thread_id * kEmptyGetsStride];
+  }
+
+  // Hwtime ticks consumer |thread_id| spent from a get finding the data
+  // structure empty to the next successful one, including back-off.
+  inline uint64_t empty_time(uint64_t thread_id) {
+    return empty_time_[thread_id * kEmptyGetsStride];
+  }
+
+  // Most elements producer |thread_id| has counted in the data structure.
+  inline uint64_t peak_elements(uint64_t thread_id) {
+    return peak_elements_[thread_id * kEmptyGetsStride];
+  }
+
  protected:
   void bench_func(void);
 
  private:
   void producer(void);
   void consumer(void);
+  uint64_t elements(void);
+
+  uint64_t *empty_gets_;
+  uint64_t *empty_time_;
+  uint64_t *peak_elements_;
 };
 
 uint64_t g_num_threads;
+// Mean gap between two arrivals at a producer, in hwtime ticks.
+double g_arrival_gap;
+// Burst and pause lengths of onoff arrivals, in hwtime ticks.
+uint64_t g_on_period;
+uint64_t g_off_period;
+scal::Backoff::Policy g_backoff;
+// Consumers parked by the futex back-off, woken up by producers.
+scal::ParkingLot g_parking_lot;
 
 int main(int argc, const char **argv) {
   std::string usage("Producer/consumer micro benchmark.");
@@ -69,70 +218,520 @@ int main(int argc, const char **argv) {
   scal::ThreadContext::prepare(g_num_threads + 1);
   scal::ThreadContext::assign_context();
 
+  if (FLAGS_log_operations && FLAGS_duration > 0) {
+    fprintf(stderr, "%s: error: cannot log operations of timed runs\n",
+            __func__);
+    abort();
+  }
+  // Binaries named prodcon-<data structure> default to that structure.
+  std::vector<std::string> structures;
+  if (!ds_parse_list(FLAGS_ds.empty() ? ds_name(argv[0]) : FLAGS_ds,
+                     &structures)) {
+    if (structures.back().empty()) {
+      fprintf(stderr, "%s: error: no data structure selected, use --ds with "
+                      "one of: %s\n", __func__, ds_names().c_str());
+    } else {
+      fprintf(stderr, "%s: error: unknown data structure %s, use --ds with "
+                      "one of: %s\n",
+              __func__, structures.back().c_str(), ds_names().c_str());
+    }
+    abort();
+  }
+  if (FLAGS_log_operations &&
+      (FLAGS_trials + FLAGS_warmup) * structures.size() > 1) {
+    fprintf(stderr, "%s: error: cannot log operations of multiple trials\n",
+            __func__);
+    abort();
+  }
+  if (FLAGS_trials == 0) {
+    fprintf(stderr, "%s: error: at least one trial is needed\n", __func__);
+    abort();
+  }
+  // Items of open-loop runs are arrival times, which are not unique.
+  if (FLAGS_log_operations && open_loop()) {
+    fprintf(stderr, "%s: error: cannot log operations of open-loop runs\n",
+            __func__);
+    abort();
+  }
+  if (!scal::Backoff::parse_policy(FLAGS_backoff, &g_backoff)) {
+    fprintf(stderr, "%s: error: unknown back-off %s\n",
+            __func__, FLAGS_backoff.c_str());
+    abort();
+  }
+  // The futex back-off retries gets on its own.
+  if (FLAGS_log_operations && g_backoff == scal::Backoff::kPark) {
+    fprintf(stderr, "%s: error: cannot log operations with futex back-off\n",
+            __func__);
+    abort();
+  }
+  double ticks_per_usec = hwtime_per_usec();
+  if (open_loop()) {
+    if (FLAGS_arrivals != "poisson" && FLAGS_arrivals != "onoff") {
+      fprintf(stderr, "%s: error: unknown arrival process %s\n",
+              __func__, FLAGS_arrivals.c_str());
+      abort();
+    }
+    if (FLAGS_arrivals == "onoff" &&
+        (FLAGS_on_period == 0 || FLAGS_off_period == 0)) {
+      fprintf(stderr, "%s: error: onoff arrivals need non-zero on and off "
+                      "periods\n", __func__);
+      abort();
+    }
+    g_arrival_gap = ticks_per_usec * 1000 * FLAGS_producers / FLAGS_rate;
+    if (FLAGS_arrivals == "onoff") {
+      g_on_period = ticks_per_usec * FLAGS_on_period;
+      g_off_period = ticks_per_usec * FLAGS_off_period;
+    }
+  }
   if (FLAGS_log_operations) {
     scal::StdOperationLogger::prepare(g_num_threads + 1,
                                       FLAGS_operations +100000);
   }
 
-  void *ds = ds_new();
+  Result::Format format;
+  if (!Result::parse_format(FLAGS_format, &format)) {
+    fprintf(stderr, "%s: error: unknown result format %s\n",
+            __func__, FLAGS_format.c_str());
+    abort();
+  }
 
   ProdConBench *benchmark = new ProdConBench(
       g_num_threads,
       tlsize,
-      FLAGS_operations * (g_num_threads + 1),
-      ds);
-  benchmark->run();
+      (FLAGS_latency || open_loop()) ? kNumLatencyTypes : 0,
+      NULL);
+  benchmark->set_duration(FLAGS_duration);
+  benchmark->set_sample_interval(FLAGS_sample_interval);
+  benchmark->set_workload(FLAGS_c);
+  // Samples are part of the structured output.
+  benchmark->set_print_samples(format == Result::kText);
 
-  if (FLAGS_log_operations) {
-    scal::StdOperationLogger::print_summary();
-  }
-
-  if (FLAGS_print_summary) {
-    uint64_t exec_time = benchmark->execution_time();
-    char buffer[1024] = {0};
-    uint32_t n = snprintf(buffer, sizeof(buffer), "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "",
-        FLAGS_producers + FLAGS_consumers,
-        FLAGS_producers,
-        FLAGS_consumers,
-        exec_time,
-        FLAGS_operations,
-        FLAGS_c,
-        (uint64_t)((FLAGS_operations * FLAGS_producers * 2) / (static_cast<double>(exec_time) / 1000)));
-    if (n != strlen(buffer)) {
-      fprintf(stderr, "%s: error: failed to create summary string\n", __func__);
-      abort();
+  // All structures run on the same worker threads and thread-local memory.
+  std::vector<TrialStatistics> statistics(structures.size());
+  bool first_run = true;
+  for (uint64_t d = 0; d < structures.size(); d++) {
+    ds_select(structures[d]);
+    const char *ds = structures[d].c_str();
+    Statistics &throughput = statistics[d].throughput;
+    Statistics (&latency)[kNumLatencyTypes][kNumTrialPercentiles] =
+        statistics[d].latency;
+    for (uint64_t trial = 0; trial < FLAGS_warmup + FLAGS_trials; trial++) {
+      if (!first_run) {
+        // The data structure of the last trial is dead, the next one reuses
+        // its memory.
+        scal::tlalloc_reset();
+      }
+      first_run = false;
+      const scal::AllocStats before = scal::alloc_stats();
+      benchmark->set_data(ds_new());
+      scal::AllocStats created = scal::alloc_stats();
+      created.subtract(before);
+      benchmark->run();
+      if (trial < FLAGS_warmup) {
+        continue;
+      }
+
+      if (FLAGS_log_operations) {
+        scal::StdOperationLogger::print_summary();
+      }
+
+      uint64_t exec_time = benchmark->execution_time();
+      // Producers count puts, consumers count successful gets.
+      uint64_t puts = 0;
+      uint64_t peak_elements = 0;
+      uint64_t total_operations = 0;
+      uint64_t empty_gets = 0;
+      uint64_t empty_time = 0;
+      for (uint64_t i = 1; i <= g_num_threads; i++) {
+        if (i <= FLAGS_producers) {
+          puts += benchmark->operations(i);
+          peak_elements = std::max(peak_elements,
+                                   benchmark->peak_elements(i));
+        }
+        total_operations += benchmark->operations(i);
+        empty_gets += benchmark->empty_gets(i);
+        empty_time += benchmark->empty_time(i);
+      }
+      // Memory of the data structure, allocated by its creation and by the
+      // workers. Memory that is reclaimed and reused is only counted once,
+      // so it is compared to the most elements the data structure held.
+      scal::AllocStats allocated = created;
+      for (uint64_t i = 1; i <= g_num_threads; i++) {
+        allocated.add(benchmark->alloc_stats(i));
+      }
+      const uint64_t mem_requested = allocated.requested;
+      const uint64_t mem_consumed = allocated.consumed;
+      const uint64_t mem_init = created.consumed;
+      if (allocated.wrap_arounds > 0) {
+        fprintf(stderr, "warning: thread-local memory wrapped around %" PRIu64
+                " times, the trial may have overwritten live objects; "
+                "increase --prealloc_size\n", allocated.wrap_arounds);
+      }
+      double bytes_per_element = (peak_elements == 0) ? 0 :
+          static_cast<double>(mem_consumed) / peak_elements;
+      // Time the main thread and the workers took to fault in their
+      // thread-local memory.
+      const uint64_t prefault_time =
+          scal::tlalloc_prefault_time() + benchmark->prefault_time();
+      const uint64_t huge_page_bytes = scal::huge_page_bytes();
+      // Retired memory the data structure could not reuse yet.
+      const uint64_t unreclaimed_peak = scal::Unreclaimed::peak();
+      // Share of the consumers' time spent on an empty data structure.
+      double empty_share = (exec_time == 0) ? 0 :
+          100.0 * empty_time / (ticks_per_usec * exec_time * FLAGS_consumers);
+      double trial_throughput =
+          total_operations / (static_cast<double>(exec_time) / 1000);
+      throughput.add(trial_throughput);
+      // Throughput while all threads were running, without the ramp-up and
+      // the tail.
+      double steady_time = benchmark->steady_time();
+      double steady_throughput = (steady_time == 0) ? 0 :
+          benchmark->steady_operations() / (steady_time / 1000);
+
+      Histogram latencies[kNumLatencyTypes];
+      for (uint64_t i = 0; i < kNumLatencyTypes; i++) {
+        if (!recorded(i)) {
+          continue;
+        }
+        benchmark->merge_histograms(i, &latencies[i]);
+        for (uint64_t j = 0; j < kNumTrialPercentiles; j++) {
+          latency[i][j].add(latencies[i].percentile(kTrialPercentiles[j]));
+        }
+      }
+
+      if (!FLAGS_print_summary) {
+        continue;
+      }
+
+      // The columns make up the traditional summary line.
+      Result result;
+      result.add("record", "trial");
+      result.add("benchmark", "prodcon");
+      result.add("ds", ds);
+      result.add("trial", trial - FLAGS_warmup);
+      result.add_column("threads", FLAGS_producers + FLAGS_consumers);
+      result.add_column("producers", FLAGS_producers);
+      result.add_column("consumers", FLAGS_consumers);
+      result.add_column("exec_time", exec_time);
+      result.add_column("ops", puts / FLAGS_producers);
+      result.add_column("workload", benchmark->workload_units());
+      if (FLAGS_c_ns > 0) {
+        result.add("workload_ns", FLAGS_c_ns);
+      }
+      if (FLAGS_c_buffer != "0") {
+        result.add("workload_buffer", FLAGS_c_buffer.c_str());
+      }
+      result.add_column("throughput", static_cast<uint64_t>(trial_throughput));
+      result.add("operations", total_operations);
+      result.add("steady_time", steady_time);
+      result.add("steady_throughput", steady_throughput);
+      result.add("ramp_up", benchmark->ramp_up());
+      result.add("tail", benchmark->tail());
+      result.add("mem_requested", mem_requested);
+      result.add("mem_consumed", mem_consumed);
+      result.add("mem_init", mem_init);
+      result.add("peak_elements", peak_elements);
+      result.add("bytes_per_element", bytes_per_element);
+      result.add("alloc_bumped", allocated.bumped);
+      result.add("alloc_wrap_arounds", allocated.wrap_arounds);
+      result.add("alloc_fallbacks", allocated.fallbacks);
+      result.add("alloc_alignment_waste", allocated.alignment_waste);
+      result.add("alloc_local_frees", allocated.local_frees);
+      result.add("alloc_remote_frees", allocated.remote_frees);
+      result.add("peak_rss", scal::peak_rss());
+      result.add("prefault_time", prefault_time);
+      result.add("reclaim", ds_reclaim().c_str());
+      result.add("unreclaimed_peak", unreclaimed_peak);
+      result.add("huge_pages", FLAGS_huge_pages.c_str());
+      result.add("huge_page_bytes", huge_page_bytes);
+      result.add("numa_nodes", scal::numa_num_nodes());
+      result.add("numa_arenas", FLAGS_numa_arenas.c_str());
+      result.add("numa_shared", FLAGS_numa_shared.c_str());
+      result.add("empty_gets", empty_gets);
+      result.add("empty_time_pct", empty_share);
+      result.add("backoff", FLAGS_backoff.c_str());
+      if (open_loop()) {
+        result.add("rate", FLAGS_rate);
+        result.add("arrivals", FLAGS_arrivals.c_str());
+      }
+      for (uint64_t i = 0; i < kNumLatencyTypes; i++) {
+        if (recorded(i)) {
+          result.add_percentiles(kLatencyTypeNames[i], latencies[i]);
+        }
+      }
+      // Events per completed operation.
+      std::string events;
+      for (uint64_t i = 0; i < PerfCounters::kNumEvents; i++) {
+        PerfCounters::Event event = static_cast<PerfCounters::Event>(i);
+        uint64_t total;
+        if (total_operations == 0 || !benchmark->perf_counter(event, &total)) {
+          continue;
+        }
+        double per_operation = static_cast<double>(total) / total_operations;
+        char name[64];
+        snprintf(name, sizeof(name), "%s_per_op", PerfCounters::name(event));
+        result.add(name, per_operation);
+        snprintf(name, sizeof(name), " %s=%.3f",
+                 PerfCounters::name(event), per_operation);
+        events += name;
+      }
+      if (benchmark->placement() != NULL) {
+        std::string cpus;
+        char cpu[32];
+        for (uint64_t i = 1; i <= g_num_threads; i++) {
+          snprintf(cpu, sizeof(cpu), (i == 1) ? "%" PRIu64 ":%d"
+                                              : " %" PRIu64 ":%d",
+                   i, benchmark->cpu(i));
+          cpus += cpu;
+        }
+        result.add("placement", benchmark->placement());
+        result.add("cpus", cpus.c_str());
+      }
+      // Per-thread distributions. Retries are gets that found the data
+      // structure empty, producers never retry.
+      Statistics role_operations[kNumRoles];
+      Statistics role_times[kNumRoles];
+      Statistics retries;
+      uint64_t worst_p99[kNumLatencyTypes] = { 0 };
+      uint64_t worst_thread[kNumLatencyTypes] = { 0 };
+      for (uint64_t i = 1; FLAGS_fairness && (i <= g_num_threads); i++) {
+        Role role = (i <= FLAGS_producers) ? kProducer : kConsumer;
+        role_operations[role].add(benchmark->operations(i));
+        role_times[role].add(benchmark->thread_time(i));
+        if (role == kConsumer) {
+          retries.add(benchmark->empty_gets(i));
+        }
+        for (uint64_t j = 0; j < kNumLatencyTypes; j++) {
+          const Histogram *histogram = benchmark->thread_histogram(i, j);
+          if (!recorded(j) || histogram == NULL || histogram->count() == 0) {
+            continue;
+          }
+          if (histogram->percentile(99) >= worst_p99[j]) {
+            worst_p99[j] = histogram->percentile(99);
+            worst_thread[j] = i;
+          }
+        }
+      }
+      // Without --duration every thread of a role completes the same number
+      // of operations, so only their completion times can differ.
+      const bool timed = FLAGS_duration > 0;
+      for (uint64_t i = 0; FLAGS_fairness && (i < kNumRoles); i++) {
+        char name[64];
+        if (timed) {
+          snprintf(name, sizeof(name), "%s_ops", kRoleNames[i]);
+          result.add_fairness(name, role_operations[i]);
+        }
+        snprintf(name, sizeof(name), "%s_time", kRoleNames[i]);
+        result.add_fairness(name, role_times[i]);
+      }
+      if (FLAGS_fairness) {
+        result.add_fairness("consumer_retries", retries);
+      }
+      for (uint64_t i = 0; FLAGS_fairness && (i < kNumLatencyTypes); i++) {
+        if (recorded(i)) {
+          char name[64];
+          snprintf(name, sizeof(name), "%s_worst_p99", kLatencyTypeNames[i]);
+          result.add(name, worst_p99[i]);
+          snprintf(name, sizeof(name), "%s_worst_thread",
+                   kLatencyTypeNames[i]);
+          result.add(name, worst_thread[i]);
+        }
+      }
+      ds_get_stats(&result);
+      // Structures add different fields, so each gets its own CSV header.
+      result.print(stdout, format, trial == FLAGS_warmup);
+
+      if (format == Result::kText) {
+        for (uint64_t i = 0; i < kNumLatencyTypes; i++) {
+          if (!recorded(i)) {
+            continue;
+          }
+          printf("%s latency (cycles): n=%" PRIu64 " p50=%" PRIu64
+                 " p90=%" PRIu64 " p99=%" PRIu64 " p99.9=%" PRIu64
+                 " max=%" PRIu64 "\n",
+                 kLatencyTypeNames[i],
+                 latencies[i].count(),
+                 latencies[i].percentile(50),
+                 latencies[i].percentile(90),
+                 latencies[i].percentile(99),
+                 latencies[i].percentile(99.9),
+                 latencies[i].max());
+        }
+        if (!events.empty()) {
+          printf("events per operation:%s\n", events.c_str());
+        }
+        printf("steady state: time=%.0fus throughput=%.0f ramp_up=%.1fus "
+               "tail=%.1fus\n", steady_time, steady_throughput,
+               benchmark->ramp_up(), benchmark->tail());
+        printf("empty gets: n=%" PRIu64 " time=%.1f%% backoff=%s\n",
+               empty_gets, empty_share, FLAGS_backoff.c_str());
+        printf("memory (bytes): requested=%" PRIu64 " consumed=%" PRIu64
+               " init=%" PRIu64 " peak_elements=%" PRIu64 " per_element=%.1f"
+               " peak_rss=%" PRIu64 " prefault_time=%" PRIu64 "us"
+               " huge_pages=%" PRIu64 " unreclaimed_peak=%" PRIu64 "\n",
+               mem_requested, mem_consumed, mem_init, peak_elements,
+               bytes_per_element,
+               scal::peak_rss(), prefault_time, huge_page_bytes,
+               unreclaimed_peak);
+        printf("allocator: bumped=%" PRIu64 " wrap_arounds=%" PRIu64
+               " fallbacks=%" PRIu64 " alignment_waste=%" PRIu64
+               " local_frees=%" PRIu64 " remote_frees=%" PRIu64 "\n",
+               allocated.bumped, allocated.wrap_arounds, allocated.fallbacks,
+               allocated.alignment_waste, allocated.local_frees,
+               allocated.remote_frees);
+        for (uint64_t i = 0; FLAGS_fairness && (i < kNumRoles); i++) {
+          std::string name(kRoleNames[i]);
+          if (timed) {
+            Result::print_fairness(stdout, (name + " ops").c_str(),
+                                   role_operations[i]);
+          }
+          Result::print_fairness(stdout, (name + " time (us)").c_str(),
+                                 role_times[i]);
+        }
+        if (FLAGS_fairness) {
+          Result::print_fairness(stdout, "consumer retries", retries);
+        }
+        for (uint64_t i = 0; FLAGS_fairness && (i < kNumLatencyTypes); i++) {
+          if (recorded(i)) {
+            printf("%s latency p99 (cycles) per thread: worst=%" PRIu64
+                   " thread=%" PRIu64 "\n",
+                   kLatencyTypeNames[i], worst_p99[i], worst_thread[i]);
+          }
+        }
+      } else if (format == Result::kJson) {
+        uint64_t previous = 0;
+        for (uint64_t i = 0; i < benchmark->num_samples(); i++) {
+          const scal::ThroughputSample &sample = benchmark->sample(i);
+          Result record;
+          record.add("record", "sample");
+          record.add("trial", trial - FLAGS_warmup);
+          record.add("time", sample.time / 1000);
+          record.add("operations", sample.operations);
+          record.add("throughput", (sample.operations * 1000.0) /
+                                   (sample.time - previous));
+          record.print(stdout, format, false);
+          previous = sample.time;
+        }
+      }
+    }
+  }
+  benchmark->shutdown();
+
+  if (format == Result::kText) {
+    if (benchmark->placement() != NULL) {
+      printf("placement %s", benchmark->placement());
+      for (uint64_t i = 1; i <= g_num_threads; i++) {
+        printf(" %" PRIu64 ":%d", i, benchmark->cpu(i));
+      }
+      printf("\n");
     }
-    char *ds_stats = ds_get_stats();
-    if (ds_stats != NULL) {
-      if (n + strlen(ds_stats) >= 1023) {  // separating space + '\0'
-        fprintf(stderr, "%s: error: strings too long\n", __func__);
-        abort();
+    for (uint64_t d = 0; (FLAGS_trials > 1) && (d < structures.size());
+         d++) {
+      // Labels only name the structure if there are several.
+      std::string label = (structures.size() > 1) ? structures[d] + " " : "";
+      Result::print_statistics(
+          stdout, (label + "throughput (operations/ms)").c_str(),
+          statistics[d].throughput);
+      for (uint64_t i = 0; i < kNumLatencyTypes; i++) {
+        for (uint64_t j = 0; recorded(i) && (j < kNumTrialPercentiles); j++) {
+          char name[64];
+          snprintf(name, sizeof(name), "%s%s latency p%.0f (cycles)",
+                   label.c_str(), kLatencyTypeNames[i], kTrialPercentiles[j]);
+          Result::print_statistics(stdout, name, statistics[d].latency[i][j]);
+        }
       }
-      strcat(buffer, " ");
-      strcat(buffer, ds_stats);
     }
-    printf("%s\n", buffer);
+  } else if (format == Result::kJson && FLAGS_trials > 1) {
+    // CSV rows share one header, so the aggregate is left to the reader.
+    for (uint64_t d = 0; d < structures.size(); d++) {
+      Result aggregate;
+      aggregate.add("record", "aggregate");
+      aggregate.add("benchmark", "prodcon");
+      aggregate.add("ds", structures[d].c_str());
+      aggregate.add("trials", FLAGS_trials);
+      aggregate.add_statistics("throughput", statistics[d].throughput);
+      for (uint64_t i = 0; i < kNumLatencyTypes; i++) {
+        for (uint64_t j = 0; recorded(i) && (j < kNumTrialPercentiles); j++) {
+          char name[64];
+          snprintf(name, sizeof(name), "%s_p%.0f",
+                   kLatencyTypeNames[i], kTrialPercentiles[j]);
+          aggregate.add_statistics(name, statistics[d].latency[i][j]);
+        }
+      }
+      aggregate.print(stdout, format, false);
+    }
   }
   return EXIT_SUCCESS;
 }
 
+// Returns the number of elements in the data structure. Gets are read
+// before puts, so that a put racing with the read cannot make it negative.
+uint64_t ProdConBench::elements(void) {
+  uint64_t gets = 0;
+  for (uint64_t i = FLAGS_producers + 1; i <= g_num_threads; i++) {
+    gets += operations(i);
+  }
+  uint64_t puts = 0;
+  for (uint64_t i = 1; i <= FLAGS_producers; i++) {
+    puts += operations(i);
+  }
+  return puts - gets;
+}
+
 void ProdConBench::producer(void) {
   Pool<uint64_t> *ds = static_cast<Pool<uint64_t>*>(data_);
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  Histogram *latencies = recorded(kPutLatency) ? histogram(kPutLatency) : NULL;
+  volatile uint64_t *counter = operation_counter();
+  scal::Workload *workload = this->workload();
+  const uint64_t units = workload_units();
+  const bool timed = FLAGS_duration > 0;
+  scal::ArrivalProcess arrivals(
+      g_arrival_gap, g_on_period, g_off_period, get_hwtime());
   uint64_t item;
+  uint64_t start = 0;
+  uint64_t peak_elements = 0;
   // Do not use 0 as value, since there may be datastructures that do not
   // support it.
-  for (uint64_t i = 1; i <= FLAGS_operations; i++) {
-    item = thread_id * FLAGS_operations + i;
+  for (uint64_t i = 1; timed ? !stopped() : (i <= FLAGS_operations); i++) {
+    if (open_loop()) {
+      // The item is its arrival time rather than the time it is actually
+      // put, so that a producer falling behind its schedule shows up in the
+      // sojourn times instead of lowering the offered load.
+      item = arrivals.next();
+      while (get_hwtime() < item && !(timed && stopped())) {}
+    } else {
+      // Items of different producers stay distinct in timed runs, where a
+      // producer may put more than FLAGS_operations items.
+      item = (thread_id << 48) | i;
+    }
     scal::StdOperationLogger::get().invoke(scal::LogType::kEnqueue);
+    if (latencies != NULL) {
+      start = get_hwtime();
+    }
     if (!ds->put(item)) {
       // We should always be able to insert an item.
       fprintf(stderr, "%s: error: put operation failed.\n", __func__);
       abort();
     }
+    if (g_backoff == scal::Backoff::kPark) {
+      g_parking_lot.notify();
+    }
+    if (latencies != NULL) {
+      latencies->add(get_hwtime() - start);
+    }
     scal::StdOperationLogger::get().response(true, item);
-    calculate_pi(FLAGS_c);
+    (*counter)++;
+    if (i % kElementsSampleInterval == 0) {
+      peak_elements = std::max(peak_elements, elements());
+    }
+    // The arrival process takes the place of the workload.
+    if (!open_loop()) {
+      workload->run(units);
+    }
   }
+  peak_elements_[thread_id * kEmptyGetsStride] =
+      std::max(peak_elements, elements());
 }
 
 void ProdConBench::consumer(void) {
@@ -145,19 +744,75 @@ void ProdConBench::consumer(void) {
   if (rest >= thread_id) {
     operations++;
   }
+  Histogram *latencies = recorded(kGetLatency) ? histogram(kGetLatency) : NULL;
+  Histogram *sojourns =
+      recorded(kSojournLatency) ? histogram(kSojournLatency) : NULL;
+  volatile uint64_t *counter = operation_counter();
+  scal::Workload *workload = this->workload();
+  const uint64_t units = workload_units();
+  const bool timed = FLAGS_duration > 0;
+  scal::Backoff backoff(g_backoff, FLAGS_backoff_pauses,
+                        FLAGS_backoff_max_pauses, &g_parking_lot);
+  uint64_t empty_gets = 0;
+  uint64_t empty_time = 0;
+  // Start of the current run of empty gets, 0 if the last get succeeded.
+  uint64_t empty_start = 0;
   uint64_t j = 0;
   uint64_t ret;
+  uint64_t start = 0;
+  uint64_t now;
   bool ok;
-  while (j < operations) {
+  while (timed ? !stopped() : (j < operations)) {
     scal::StdOperationLogger::get().invoke(scal::LogType::kDequeue);
+    if (latencies != NULL) {
+      start = get_hwtime();
+    }
     ok = ds->get(&ret);
+    // Only successful gets are recorded; empty returns would otherwise
+    // dominate the distribution whenever consumers outpace producers.
+    if ((latencies != NULL || sojourns != NULL) && ok) {
+      now = get_hwtime();
+      if (latencies != NULL) {
+        latencies->add(now - start);
+      }
+      // Items are arrival times. The hwtime of different cores may be off by
+      // a few ticks, which must not wrap around.
+      if (sojourns != NULL) {
+        sojourns->add((now > ret) ? (now - ret) : 0);
+      }
+    }
     scal::StdOperationLogger::get().response(ok, ret);
-    calculate_pi(FLAGS_c);
+    if (ok && empty_start != 0) {
+      empty_time += get_hwtime() - empty_start;
+      empty_start = 0;
+      backoff.reset();
+    }
+    workload->run(units);
     if (!ok) {
-      continue;
+      empty_gets++;
+      if (empty_start == 0) {
+        empty_start = get_hwtime();
+      }
+      bool retried = backoff.backoff([&]() { return ds->get(&ret); });
+      if (!retried) {
+        continue;
+      }
+      empty_time += get_hwtime() - empty_start;
+      empty_start = 0;
+      backoff.reset();
+      if (sojourns != NULL) {
+        now = get_hwtime();
+        sojourns->add((now > ret) ? (now - ret) : 0);
+      }
     }
+    (*counter)++;
     j++;
   }
+  if (empty_start != 0) {
+    empty_time += get_hwtime() - empty_start;
+  }
+  empty_gets_[thread_id * kEmptyGetsStride] = empty_gets;
+  empty_time_[thread_id * kEmptyGetsStride] = empty_time;
 }
 
 void ProdConBench::bench_func(void) {
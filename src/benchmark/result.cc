@@ -0,0 +1,233 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#define __STDC_FORMAT_MACROS 1  // we want PRIu64 and friends
+
+#include "benchmark/result.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <cmath>
+#include <string>
+
+namespace {
+
+std::string json_escape(const std::string &value) {
+  std::string result;
+  for (size_t i = 0; i < value.size(); i++) {
+    char c = value[i];
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      result += buffer;
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+std::string csv_escape(const std::string &value) {
+  if (value.find_first_of(",\"\n") == std::string::npos) {
+    return value;
+  }
+  std::string result("\"");
+  for (size_t i = 0; i < value.size(); i++) {
+    if (value[i] == '"') {
+      result += '"';
+    }
+    result += value[i];
+  }
+  result += '"';
+  return result;
+}
+
+}  // namespace
+
+namespace scal {
+
+bool Result::parse_format(const std::string &name, Format *format) {
+  if (name == "text") {
+    *format = kText;
+  } else if (name == "json") {
+    *format = kJson;
+  } else if (name == "csv") {
+    *format = kCsv;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Result::add_field(const char *name, const std::string &value,
+                       bool quoted, bool column) {
+  Field field;
+  field.name = name;
+  field.value = value;
+  field.quoted = quoted;
+  field.column = column;
+  fields_.push_back(field);
+}
+
+void Result::add(const char *name, uint64_t value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+  add_field(name, buffer, false, false);
+}
+
+void Result::add(const char *name, int64_t value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%" PRId64, value);
+  add_field(name, buffer, false, false);
+}
+
+void Result::add(const char *name, double value) {
+  // NaN and infinity, e.g., a mean over no samples, have no JSON literal.
+  if (!std::isfinite(value)) {
+    add_field(name, "null", false, false);
+    return;
+  }
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.3f", value);
+  add_field(name, buffer, false, false);
+}
+
+void Result::add(const char *name, const char *value) {
+  add_field(name, value, true, false);
+}
+
+void Result::add_percentiles(const char *prefix, const Histogram &histogram) {
+  const double percentiles[] = { 50, 90, 99, 99.9 };
+  const char *names[] = { "p50", "p90", "p99", "p999" };
+  char name[64];
+  snprintf(name, sizeof(name), "%s_count", prefix);
+  add(name, histogram.count());
+  for (uint64_t i = 0; i < 4; i++) {
+    snprintf(name, sizeof(name), "%s_%s", prefix, names[i]);
+    add(name, histogram.percentile(percentiles[i]));
+  }
+  snprintf(name, sizeof(name), "%s_max", prefix);
+  add(name, histogram.max());
+}
+
+void Result::add_statistics(const char *prefix, const Statistics &statistics) {
+  const char *names[] = { "mean", "stddev", "min", "ci95" };
+  const double values[] = {
+    statistics.mean(), statistics.stddev(), statistics.min(), statistics.ci95()
+  };
+  char name[64];
+  for (uint64_t i = 0; i < 4; i++) {
+    snprintf(name, sizeof(name), "%s_%s", prefix, names[i]);
+    add(name, values[i]);
+  }
+}
+
+void Result::print_statistics(FILE *out, const char *name,
+                              const Statistics &statistics) {
+  fprintf(out, "%s over %" PRIu64 " trials: mean=%.1f stddev=%.1f min=%.1f "
+          "ci95=%.1f\n",
+          name,
+          statistics.count(),
+          statistics.mean(),
+          statistics.stddev(),
+          statistics.min(),
+          statistics.ci95());
+}
+
+void Result::add_fairness(const char *prefix, const Statistics &per_thread) {
+  const char *names[] = { "min", "max", "stddev", "jain" };
+  const double values[] = {
+    per_thread.min(), per_thread.max(), per_thread.stddev(), per_thread.jain()
+  };
+  char name[64];
+  for (uint64_t i = 0; i < 4; i++) {
+    snprintf(name, sizeof(name), "%s_%s", prefix, names[i]);
+    add(name, values[i]);
+  }
+}
+
+void Result::print_fairness(FILE *out, const char *name,
+                            const Statistics &per_thread) {
+  fprintf(out, "%s per thread: min=%.1f max=%.1f stddev=%.1f jain=%.3f\n",
+          name,
+          per_thread.min(),
+          per_thread.max(),
+          per_thread.stddev(),
+          per_thread.jain());
+}
+
+void Result::add_column(const char *name, uint64_t value) {
+  add(name, value);
+  fields_.back().column = true;
+}
+
+void Result::add_column(const char *name, const char *value) {
+  add(name, value);
+  fields_.back().column = true;
+}
+
+std::string Result::format(Format format) const {
+  std::string result;
+  switch (format) {
+  case kText:
+    for (size_t i = 0; i < fields_.size(); i++) {
+      if (fields_[i].column) {
+        if (!result.empty()) {
+          result += " ";
+        }
+        result += fields_[i].value;
+      }
+    }
+    break;
+  case kJson:
+    result = "{";
+    for (size_t i = 0; i < fields_.size(); i++) {
+      if (i > 0) {
+        result += ",";
+      }
+      result += "\"" + json_escape(fields_[i].name) + "\":";
+      if (fields_[i].quoted) {
+        result += "\"" + json_escape(fields_[i].value) + "\"";
+      } else {
+        result += fields_[i].value;
+      }
+    }
+    result += "}";
+    break;
+  case kCsv:
+    for (size_t i = 0; i < fields_.size(); i++) {
+      if (i > 0) {
+        result += ",";
+      }
+      result += csv_escape(fields_[i].value);
+    }
+    break;
+  }
+  return result;
+}
+
+std::string Result::csv_header() const {
+  std::string result;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    if (i > 0) {
+      result += ",";
+    }
+    result += csv_escape(fields_[i].name);
+  }
+  return result;
+}
+
+void Result::print(FILE *out, Format format, bool header) const {
+  if (format == kCsv && header) {
+    fprintf(out, "%s\n", csv_header().c_str());
+  }
+  fprintf(out, "%s\n", this->format(format).c_str());
+}
+
+}  // namespace scal
@@ -0,0 +1,98 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_BENCHMARK_RESULT_H_
+#define SCAL_BENCHMARK_RESULT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "util/histogram.h"
+#include "util/statistics.h"
+
+namespace scal {
+
+// A benchmark result as a record of named fields that is printed either as
+// the traditional space-separated summary line, as one JSON object per line,
+// or as CSV.
+//
+// Only fields added as columns are part of the summary line, which keeps its
+// positional format stable when new fields are added.
+class Result {
+ public:
+  enum Format {
+    kText,
+    kJson,
+    kCsv
+  };
+
+  // Parses "text", "json", or "csv".
+  static bool parse_format(const std::string &name, Format *format);
+
+  void add(const char *name, uint64_t value);
+  void add(const char *name, int64_t value);
+  void add(const char *name, double value);
+  void add(const char *name, const char *value);
+
+  // Adds <prefix>_count, <prefix>_p50, _p90, _p99, _p999, and _max.
+  void add_percentiles(const char *prefix, const Histogram &histogram);
+
+  // Adds <prefix>_mean, <prefix>_stddev, _min, and _ci95.
+  void add_statistics(const char *prefix, const Statistics &statistics);
+
+  // Prints "<name> over <n> trials: mean=... stddev=... min=... ci95=..." as
+  // the text format counterpart of add_statistics().
+  static void print_statistics(FILE *out, const char *name,
+                               const Statistics &statistics);
+
+  // Adds <prefix>_min, <prefix>_max, _stddev, and _jain of per-thread values.
+  void add_fairness(const char *prefix, const Statistics &per_thread);
+
+  // Prints "<name> per thread: min=... max=... stddev=... jain=..." as the
+  // text format counterpart of add_fairness().
+  static void print_fairness(FILE *out, const char *name,
+                             const Statistics &per_thread);
+
+  // Adds a field that is also a column of the summary line.
+  void add_column(const char *name, uint64_t value);
+  void add_column(const char *name, const char *value);
+
+  inline uint64_t num_fields() const {
+    return fields_.size();
+  }
+
+  inline void clear() {
+    fields_.clear();
+  }
+
+  // Returns the record in |format|, without a trailing newline.
+  std::string format(Format format) const;
+
+  // Returns the CSV header matching format(kCsv).
+  std::string csv_header() const;
+
+  // Prints the record in |format|. A CSV header is printed if |header| is
+  // set.
+  void print(FILE *out, Format format, bool header) const;
+
+ private:
+  struct Field {
+    std::string name;
+    std::string value;
+    bool quoted;
+    bool column;
+  };
+
+  void add_field(const char *name, const std::string &value,
+                 bool quoted, bool column);
+
+  std::vector<Field> fields_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_BENCHMARK_RESULT_H_
@@ -8,16 +8,19 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/boundedsize_kfifo.h"
 
-DEFINE_uint64(k, 80, "k-segment size");
-DEFINE_uint64(num_segments, 1000000, "number of k-segments in the "
-                                     "bounded-size version");
+namespace {
 
-void* ds_new() {
+void* create(void) {
   BoundedSizeKFifo<uint64_t> *kfifo = BoundedSizeKFifo<uint64_t>::get_aligned(
       FLAGS_k, FLAGS_num_segments, 128);
   return static_cast<void*>(kfifo);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("k", FLAGS_k);
+  result->add("num_segments", FLAGS_num_segments);
 }
+
+}  // namespace
+
+REGISTER_DS("bskfifo", create, get_stats);
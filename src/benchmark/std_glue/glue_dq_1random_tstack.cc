@@ -11,18 +11,23 @@
 #include "datastructures/distributed_queue.h"
 #include "datastructures/treiber_stack.h"
 
-DEFINE_uint64(p, 80, "number of partial queues");
-DEFINE_bool(hw_random, false, "use hardware random generator instead "
-                              "of pseudo");
+namespace {
 
-void* ds_new(void) {
-  Balancer1Random *balancer = new Balancer1Random(FLAGS_hw_random);
+void* create(void) {
+  Balancer1Random *balancer = new Balancer1Random();
   DistributedQueue<uint64_t, TreiberStack<uint64_t> > *sp =
       new DistributedQueue<uint64_t, TreiberStack<uint64_t> >(
-          FLAGS_p, g_num_threads + 1, balancer);
+          FLAGS_p, balancer, FLAGS_numa_partials);
   return static_cast<void*>(sp);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("p", FLAGS_p);
+  result->add("hw_random", static_cast<uint64_t>(FLAGS_hw_random));
+  result->add("numa_partials", static_cast<uint64_t>(FLAGS_numa_partials));
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("dq-1random-tstack", create, get_stats,
+                       scal::kReclaimEpoch | scal::kReclaimHazard);
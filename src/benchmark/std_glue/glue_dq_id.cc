@@ -16,16 +16,22 @@
 #include "datastructures/ms_queue.h"
 #include "util/malloc.h"
 
-DEFINE_uint64(p, 80, "number of partial queues");
+namespace {
 
-void* ds_new(void) {
+void* create(void) {
   BalancerId *balancer = new BalancerId();
   DistributedQueue<uint64_t, MSQueue<uint64_t> > *dq =
       new DistributedQueue<uint64_t, MSQueue<uint64_t> >(
-          FLAGS_p, g_num_threads + 1, balancer);
+          FLAGS_p, balancer, FLAGS_numa_partials);
   return static_cast<void*>(dq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("p", FLAGS_p);
+  result->add("numa_partials", static_cast<uint64_t>(FLAGS_numa_partials));
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("dq-id", create, get_stats,
+                       scal::kReclaimEpoch | scal::kReclaimHazard);
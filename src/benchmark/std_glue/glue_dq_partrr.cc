@@ -2,41 +2,34 @@
 // Please see the AUTHORS file for details.  Use of this source code is governed
 // by a BSD license that can be found in the LICENSE file.
 
-#define __STDC_FORMAT_MACROS 1  // we want PRIu64 and friends
-
 #include <gflags/gflags.h>
 #include <stdint.h>
-#include <string.h>
 
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/balancer_partrr.h"
 #include "datastructures/distributed_queue.h"
 #include "datastructures/ms_queue.h"
 
-DEFINE_uint64(p, 80, "number of partial queues");
 DEFINE_uint64(partitions, 1, "number of round robin partitions");
 
-void* ds_new(void) {
+namespace {
+
+void* create(void) {
   BalancerPartitionedRoundRobin *balancer =
       new BalancerPartitionedRoundRobin(FLAGS_partitions, FLAGS_p);
   DistributedQueue<uint64_t, MSQueue<uint64_t> > *sp =
       new DistributedQueue<uint64_t, MSQueue<uint64_t> >(
-          FLAGS_p, g_num_threads + 1, balancer);
+          FLAGS_p, balancer, FLAGS_numa_partials);
   return static_cast<void*>(sp);
 }
 
-char* ds_get_stats(void) {
-  char buffer[255] = { 0 };
-  uint32_t n = snprintf(buffer,
-                        sizeof(buffer),
-                        "%" PRIu64 " %" PRIu64,
-                        FLAGS_p,
-                        FLAGS_partitions);
-  if (n != strlen(buffer)) {
-    fprintf(stderr, "%s: error creating stats string\n", __func__);
-    abort();
-  }
-  char *newbuf = static_cast<char*>(calloc(
-      strlen(buffer) + 1, sizeof(*newbuf)));
-  return strncpy(newbuf, buffer, strlen(buffer));
+void get_stats(scal::Result *result) {
+  result->add_column("p", FLAGS_p);
+  result->add_column("partitions", FLAGS_partitions);
+  result->add("numa_partials", static_cast<uint64_t>(FLAGS_numa_partials));
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("dq-partrr", create, get_stats,
+                       scal::kReclaimEpoch | scal::kReclaimHazard);
@@ -9,15 +9,26 @@
 
 #define TS_DS DTSQueue<uint64_t>
 
+namespace {
+
 TS_DS *ts_;
 
-void* ds_new() {
+void* create(void) {
   ts_ = new TS_DS();
   ts_->initialize(g_num_threads + 1);
 
   return static_cast<void*>(ts_);
 }
 
-char* ds_get_stats(void) {
-  return ts_->ds_get_stats();
+void get_stats(scal::Result *result) {
+  uint64_t c1;
+  uint64_t c2;
+  if (ts_->ds_get_stats(&c1, &c2)) {
+    result->add_column("c1", c1);
+    result->add_column("c2", c2);
+  }
 }
+
+}  // namespace
+
+REGISTER_DS("dts-queue", create, get_stats);
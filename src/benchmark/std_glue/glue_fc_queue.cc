@@ -9,12 +9,18 @@
 
 DEFINE_uint64(array_size, 100, "operations array size");
 
-void* ds_new() {
+namespace {
+
+void* create(void) {
   FlatCombiningQueue<uint64_t> *fcq =
       new FlatCombiningQueue<uint64_t>(FLAGS_array_size);
   return static_cast<void*>(fcq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("array_size", FLAGS_array_size);
 }
+
+}  // namespace
+
+REGISTER_DS("fc", create, get_stats);
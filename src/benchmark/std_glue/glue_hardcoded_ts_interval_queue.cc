@@ -9,17 +9,27 @@
 #include "datastructures/ts_queue_buffer.h"
 #include "datastructures/ts_queue.h"
 
-DEFINE_uint64(delay, 0, "delay in the insert operation");
-
 #define TS_DS TSQueue<uint64_t, TSQueueBuffer<uint64_t, HardwareIntervalTimestamp>, HardwareIntervalTimestamp>
 
+namespace {
+
 TS_DS *ts_;
 
-void* ds_new() {
+void* create(void) {
   ts_ = new TS_DS(g_num_threads + 1, FLAGS_delay);
   return static_cast<void*>(ts_);
 }
 
-char* ds_get_stats(void) {
-  return ts_->ds_get_stats();
+void get_stats(scal::Result *result) {
+  result->add("delay", FLAGS_delay);
+  uint64_t c1;
+  uint64_t c2;
+  if (ts_->ds_get_stats(&c1, &c2)) {
+    result->add_column("c1", c1);
+    result->add_column("c2", c2);
+  }
 }
+
+}  // namespace
+
+REGISTER_DS("hc-ts-interval-queue", create, get_stats);
@@ -8,13 +8,18 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/kstack.h"
 
-DEFINE_uint64(k, 80, "k-segment size");
+namespace {
 
-void* ds_new() {
-  KStack<uint64_t> *kstack = new KStack<uint64_t>(FLAGS_k, g_num_threads + 1);
+void* create(void) {
+  KStack<uint64_t> *kstack = new KStack<uint64_t>(FLAGS_k);
   return static_cast<void*>(kstack);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("k", FLAGS_k);
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("kstack", create, get_stats,
+                       scal::kReclaimEpoch);
@@ -11,12 +11,19 @@ DEFINE_uint64(dequeue_mode, 0, "different APIs for empty dequeue: "
                                "non-blocking (0), blocking (1), timeout (2)");
 DEFINE_uint64(dequeue_timeout, 100, "dequeue timeout in ms");
 
-void* ds_new(void) {
+namespace {
+
+void* create(void) {
   LockBasedQueue<uint64_t> *lbq =
       new LockBasedQueue<uint64_t>(FLAGS_dequeue_mode, FLAGS_dequeue_timeout);
   return static_cast<void*>(lbq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("dequeue_mode", FLAGS_dequeue_mode);
+  result->add("dequeue_timeout", FLAGS_dequeue_timeout);
 }
+
+}  // namespace
+
+REGISTER_DS("lb", create, get_stats);
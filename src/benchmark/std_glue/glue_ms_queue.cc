@@ -7,11 +7,17 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/ms_queue.h"
 
-void* ds_new(void) {
+namespace {
+
+void* create(void) {
   MSQueue<uint64_t> *msq = new MSQueue<uint64_t>();
   return static_cast<void*>(msq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("ms", create, get_stats,
+                       scal::kReclaimEpoch | scal::kReclaimHazard);
@@ -8,14 +8,21 @@
 #include "datastructures/random_dequeue_queue.h"
 
 DEFINE_uint64(quasi_factor, 80, "random dequeue quasi factor");
-DEFINE_uint64(max_retries, 10, "number of retries in dequeue");
 
-void* ds_new(void) {
+namespace {
+
+void* create(void) {
   RandomDequeueQueue<uint64_t> *rdq =
       new RandomDequeueQueue<uint64_t>(FLAGS_quasi_factor, FLAGS_max_retries);
   return static_cast<void*>(rdq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("quasi_factor", FLAGS_quasi_factor);
+  result->add("max_retries", FLAGS_max_retries);
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("rd", create, get_stats,
+                       scal::kReclaimEpoch);
@@ -7,11 +7,17 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/treiber_stack.h"
 
-void* ds_new() {
+namespace {
+
+void* create(void) {
   TreiberStack<uint64_t> *ts = new TreiberStack<uint64_t>();
   return static_cast<void*>(ts);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("tstack", create, get_stats,
+                       scal::kReclaimEpoch | scal::kReclaimHazard);
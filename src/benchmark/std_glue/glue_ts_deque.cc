@@ -17,13 +17,14 @@ DEFINE_bool(hw_clock, false, "use the RDTSC hardware clock");
 DEFINE_bool(hwp_clock, false, "use the RDTSCP hardware clock");
 DEFINE_bool(init_threshold, true, "initializes the dequeue threshold "
     "with the current time");
-DEFINE_int64(delay, 0, "delay in the insert operation");
+
+namespace {
 
 //TSDeque<uint64_t> *ts_;
 
 int64_t g_delay;
 
-void* ds_new() {
+void* create(void) {
 return NULL;
 //   TimeStamp *timestamping;
 //   if (FLAGS_stutter_clock) {
@@ -63,7 +64,10 @@ return NULL;
 //   return static_cast<void*>(ts_);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
-//  return ts_->ds_get_stats();
+void get_stats(scal::Result *result) {
+  result->add("delay", FLAGS_delay);
 }
+
+}  // namespace
+
+// Not registered, since create() is disabled.
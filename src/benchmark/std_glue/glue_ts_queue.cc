@@ -14,10 +14,11 @@ DEFINE_bool(stutter_clock, false, "use the stuttering clock");
 DEFINE_bool(atomic_clock, false, "use atomic fetch-and-inc clock");
 DEFINE_bool(hw_clock, false, "use the RDTSC hardware clock");
 DEFINE_bool(hwp_clock, false, "use the RDTSCP hardware clock");
-DEFINE_uint64(delay, 0, "delay in the insert operation");
+
+namespace {
 
 //TSQueue<uint64_t> *ts;
-void* ds_new() {
+void* create(void) {
   return NULL;
 //   TimeStamp *timestamping;
 //   if (FLAGS_stutter_clock) {
@@ -46,7 +47,10 @@ void* ds_new() {
 //   return static_cast<void*>(ts);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
-//  return ts->ds_get_stats();
+void get_stats(scal::Result *result) {
+  result->add("delay", FLAGS_delay);
 }
+
+}  // namespace
+
+// Not registered, since create() is disabled.
@@ -8,16 +8,20 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/unboundedsize_kfifo.h"
 
-DEFINE_uint64(k, 80, "k-segment size");
-DEFINE_uint64(num_segments, 1000000, "number of k-segments in the "
-                                     "bounded-size version");
+namespace {
 
-void* ds_new() {
+void* create(void) {
   UnboundedSizeKFifo<uint64_t> *kfifo =
       new UnboundedSizeKFifo<uint64_t>(FLAGS_k);
   return static_cast<void*>(kfifo);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("k", FLAGS_k);
+  result->add("num_segments", FLAGS_num_segments);
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("uskfifo", create, get_stats,
+                       scal::kReclaimEpoch);
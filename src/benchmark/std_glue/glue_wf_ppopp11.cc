@@ -7,12 +7,17 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/wf_queue_ppopp11.h"
 
-void* ds_new(void) {
-  // Main thread may also need the queue.
-  WaitfreeQueue<uint64_t> *wfq = new WaitfreeQueue<uint64_t>(g_num_threads + 1);
+namespace {
+
+void* create(void) {
+  WaitfreeQueue<uint64_t> *wfq = new WaitfreeQueue<uint64_t>();
   return static_cast<void*>(wfq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
 }
+
+}  // namespace
+
+REGISTER_RECLAIMING_DS("wf-ppopp11", create, get_stats,
+                       scal::kReclaimEpoch | scal::kReclaimHazard);
@@ -7,16 +7,23 @@
 #include "benchmark/std_glue/std_pipe_api.h"
 #include "datastructures/wf_queue_ppopp12.h"
 
-DEFINE_uint64(max_retries, 10, "maximum number of retries in the fast path");
 DEFINE_uint64(helping_delay, 10, "number of iterations helping is derfered");
 
-void* ds_new(void) {
+namespace {
+
+void* create(void) {
   // Main thread may also need the queue.
-  WaitfreeQueue<uint64_t> *wfq = new WaitfreeQueue<uint64_t>(
-      g_num_threads + 1, FLAGS_max_retries, FLAGS_helping_delay);
+  wf_ppopp12::WaitfreeQueue<uint64_t> *wfq =
+      new wf_ppopp12::WaitfreeQueue<uint64_t>(
+          g_num_threads + 1, FLAGS_max_retries, FLAGS_helping_delay);
   return static_cast<void*>(wfq);
 }
 
-char* ds_get_stats(void) {
-  return NULL;
+void get_stats(scal::Result *result) {
+  result->add("max_retries", FLAGS_max_retries);
+  result->add("helping_delay", FLAGS_helping_delay);
 }
+
+}  // namespace
+
+REGISTER_DS("wf-ppopp12", create, get_stats);
@@ -0,0 +1,207 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "benchmark/std_glue/std_pipe_api.h"
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "util/epoch.h"
+#include "util/hazard_pointers.h"
+#include "util/numa.h"
+#include "util/object_pool.h"
+#include "util/random.h"
+
+DEFINE_string(ds, "", "comma separated list of data structures, e.g., "
+                      "ms,bskfifo (default: the suffix of the binary name "
+                      "<benchmark>-<data structure>)");
+
+DEFINE_uint64(k, 80, "k-segment size");
+DEFINE_uint64(num_segments, 1000000, "number of k-segments in the "
+                                     "bounded-size version");
+DEFINE_uint64(p, 80, "number of partial queues");
+DEFINE_bool(hw_random, false, "use the hardware random generator, same as "
+                              "--rand=hw");
+DEFINE_uint64(delay, 0, "delay in the insert operation");
+DEFINE_uint64(max_retries, 10, "number of retries in dequeue (rd) or in the "
+                               "fast path (wf-ppopp12)");
+DEFINE_bool(numa_partials, false, "spread the partial queues of distributed "
+                                  "queues over the NUMA nodes");
+DEFINE_string(reclaim, "none", "how removed nodes, segments, and descriptors "
+              "are reclaimed for reuse: none, epoch (ms, tstack, rd, "
+              "uskfifo, kstack, wf-ppopp11, and distributed queues of them), "
+              "or hazard (hazard pointers; ms, tstack, wf-ppopp11, and "
+              "distributed queues of them); or per data structure, e.g., "
+              "ms:hazard,tstack:epoch; other data structures are rejected");
+DEFINE_string(rand, "xoshiro", "pseudo-random generator behind the random "
+              "choices of data structures: xoshiro (xoshiro128**), minstd "
+              "(minimal standard, as pseudorand), or hw (time stamp "
+              "counter, as hwrand)");
+DEFINE_string(numa_shared, "first_touch", "NUMA placement of the memory a "
+              "data structure allocates when it is created: first_touch "
+              "(the creating thread's node) or interleave");
+
+namespace {
+
+struct DsEntry {
+  scal::DsNewFunc ds_new;
+  scal::DsGetStatsFunc ds_get_stats;
+  // Supported reclamation schemes, e.g., scal::kReclaimEpoch.
+  uint64_t reclaim;
+};
+
+typedef std::map<std::string, DsEntry> DsRegistry;
+
+// Constructed on first use, since data structures register during static
+// initialization.
+DsRegistry& registry() {
+  static DsRegistry *registry = new DsRegistry();
+  return *registry;
+}
+
+const DsEntry *g_selected = NULL;
+std::string g_selected_name;
+
+}  // namespace
+
+namespace scal {
+
+DsRegistrar::DsRegistrar(const char *name,
+                         DsNewFunc ds_new,
+                         DsGetStatsFunc ds_get_stats,
+                         uint64_t reclaim) {
+  DsEntry entry = { ds_new, ds_get_stats, reclaim };
+  if (!registry().insert(std::make_pair(std::string(name), entry)).second) {
+    fprintf(stderr, "%s: error: data structure %s registered twice\n",
+            __func__, name);
+    abort();
+  }
+}
+
+}  // namespace scal
+
+bool ds_select(const std::string &name) {
+  DsRegistry::const_iterator it = registry().find(name);
+  if (it == registry().end()) {
+    return false;
+  }
+  g_selected = &it->second;
+  g_selected_name = name;
+  return true;
+}
+
+bool ds_parse_list(const std::string &list, std::vector<std::string> *names) {
+  names->clear();
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    names->push_back(list.substr(start, end - start));
+    if (registry().find(names->back()) == registry().end()) {
+      return false;
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+std::string ds_names(void) {
+  std::string names;
+  for (DsRegistry::const_iterator it = registry().begin();
+       it != registry().end();
+       ++it) {
+    if (!names.empty()) {
+      names += ", ";
+    }
+    names += it->first;
+  }
+  return names;
+}
+
+std::string ds_reclaim(void) {
+  std::string reclaim = "none";
+  size_t start = 0;
+  while (start < FLAGS_reclaim.size()) {
+    size_t end = FLAGS_reclaim.find(',', start);
+    if (end == std::string::npos) {
+      end = FLAGS_reclaim.size();
+    }
+    std::string entry = FLAGS_reclaim.substr(start, end - start);
+    size_t colon = entry.find(':');
+    if (colon == std::string::npos) {
+      reclaim = entry;
+    } else if (entry.substr(0, colon) == g_selected_name) {
+      return entry.substr(colon + 1);
+    }
+    start = end + 1;
+  }
+  return reclaim;
+}
+
+void* ds_new(void) {
+  if (g_selected == NULL) {
+    fprintf(stderr, "%s: error: no data structure selected\n", __func__);
+    abort();
+  }
+  // Data structures decide how they reclaim memory when they are created.
+  const std::string reclaim = ds_reclaim();
+  uint64_t scheme = 0;
+  if (reclaim == "epoch") {
+    scheme = scal::kReclaimEpoch;
+  } else if (reclaim == "hazard") {
+    scheme = scal::kReclaimHazard;
+  } else if (reclaim != "none") {
+    fprintf(stderr, "%s: error: unknown reclamation %s\n",
+            __func__, reclaim.c_str());
+    abort();
+  }
+  // Otherwise the data structure would silently run without reclamation.
+  if ((g_selected->reclaim & scheme) != scheme) {
+    fprintf(stderr, "%s: error: %s does not support %s reclamation\n",
+            __func__, g_selected_name.c_str(), reclaim.c_str());
+    abort();
+  }
+  scal::Epoch::set_enabled(reclaim == "epoch");
+  scal::HazardPointers::set_enabled(reclaim == "hazard");
+  scal::Unreclaimed::reset();
+  if (FLAGS_hw_random || FLAGS_rand == "hw") {
+    scal::set_rand_generator(scal::kRandHardware);
+  } else if (FLAGS_rand == "xoshiro") {
+    scal::set_rand_generator(scal::kRandXoshiro);
+  } else if (FLAGS_rand == "minstd") {
+    scal::set_rand_generator(scal::kRandMinStd);
+  } else {
+    fprintf(stderr, "%s: error: unknown generator %s\n",
+            __func__, FLAGS_rand.c_str());
+    abort();
+  }
+  if (FLAGS_numa_shared == "first_touch") {
+    return g_selected->ds_new();
+  }
+  if (FLAGS_numa_shared != "interleave") {
+    fprintf(stderr, "%s: error: unknown NUMA placement %s\n",
+            __func__, FLAGS_numa_shared.c_str());
+    abort();
+  }
+  // Only pages that are faulted in while creating the data structure are
+  // interleaved, e.g., its arrays, but not the creating thread's
+  // thread-local memory.
+  scal::numa_set_thread_policy(scal::kNumaInterleave);
+  void *ds = g_selected->ds_new();
+  scal::numa_set_thread_policy(scal::kNumaFirstTouch);
+  return ds;
+}
+
+void ds_get_stats(scal::Result *result) {
+  if (g_selected != NULL) {
+    g_selected->ds_get_stats(result);
+  }
+}
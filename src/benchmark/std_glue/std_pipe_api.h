@@ -5,13 +5,84 @@
 #ifndef SCAL_BENCHMARK_STD_PIPE_API_H_
 #define SCAL_BENCHMARK_STD_PIPE_API_H_
 
+#include <gflags/gflags.h>
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+
+#include "benchmark/result.h"
+
+// Comma separated data structures to benchmark.
+DECLARE_string(ds);
+
+// Parameters shared by several data structures.
+DECLARE_uint64(k);
+DECLARE_uint64(num_segments);
+DECLARE_uint64(p);
+DECLARE_bool(hw_random);
+DECLARE_uint64(delay);
+DECLARE_uint64(max_retries);
+DECLARE_bool(numa_partials);
+// Reclamation scheme, possibly per data structure; see ds_reclaim().
+DECLARE_string(reclaim);
+
+// NUMA placement of the memory allocated by ds_new().
+DECLARE_string(numa_shared);
+
 extern uint64_t g_num_threads;
 
+namespace scal {
+
+// Creates a data structure for g_num_threads + 1 threads.
+typedef void* (*DsNewFunc)(void);
+// Adds the parameters and counters of the data structure last created by the
+// corresponding DsNewFunc to |result|.
+typedef void (*DsGetStatsFunc)(Result *result);
+
+// Reclamation schemes besides none that a data structure supports, see
+// --reclaim.
+const uint64_t kReclaimEpoch = 1 << 0;
+const uint64_t kReclaimHazard = 1 << 1;
+
+// Registers a data structure under |name| during static initialization; use
+// REGISTER_DS, or REGISTER_RECLAIMING_DS for data structures that support
+// the reclamation schemes in |reclaim|.
+class DsRegistrar {
+ public:
+  DsRegistrar(const char *name,
+              DsNewFunc ds_new,
+              DsGetStatsFunc ds_get_stats,
+              uint64_t reclaim);
+};
+
+}  // namespace scal
+
+#define REGISTER_DS(name, ds_new, ds_get_stats) \
+  static scal::DsRegistrar ds_registrar(name, ds_new, ds_get_stats, 0)
+
+#define REGISTER_RECLAIMING_DS(name, ds_new, ds_get_stats, reclaim) \
+  static scal::DsRegistrar ds_registrar(name, ds_new, ds_get_stats, reclaim)
+
+// Selects the data structure that ds_new() and ds_get_stats() refer to.
+// Returns false if no data structure is registered under |name|.
+bool ds_select(const std::string &name);
+
+// Splits the comma separated |list| into |names|. Returns false if a name is
+// not registered, which is then the last one in |names|.
+bool ds_parse_list(const std::string &list, std::vector<std::string> *names);
+
+// Returns the names of all registered data structures, separated by ", ".
+std::string ds_names(void);
+
+// Returns the reclamation scheme of the selected data structure: none,
+// epoch, or hazard.
+std::string ds_reclaim(void);
+
 extern void* ds_new(void);
 extern bool ds_put(void *ds, uint64_t val);
 extern bool ds_get(void *ds, uint64_t *val);
-extern char* ds_get_stats(void);
+// Adds the parameters and counters of the data structure to |result|.
+extern void ds_get_stats(scal::Result *result);
 
 #endif  // SCAL_BENCHMARK_STD_PIPE_API_H_
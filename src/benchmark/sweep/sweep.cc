@@ -0,0 +1,465 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Scalability sweep: Runs the producer/consumer benchmark for every
+// combination of data structures, thread counts, producer/consumer splits,
+// and data structure parameters within one process, and prints a table of
+// the throughputs and speedups.
+//
+// All cells share one set of worker threads and their thread-local memory,
+// so process startup and faulting in the memory are only paid once.
+
+#define __STDC_FORMAT_MACROS 1  // we want PRIu64 and friends
+
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark/common.h"
+#include "benchmark/result.h"
+#include "benchmark/std_glue/std_pipe_api.h"
+#include "datastructures/pool.h"
+#include "util/malloc.h"
+#include "util/statistics.h"
+#include "util/threadlocals.h"
+#include "util/workloads.h"
+
+DEFINE_string(prealloc_size, "1g", "tread local space that is initialized");
+DEFINE_string(threads, "", "comma-separated thread counts (default: powers "
+                           "of two up to the number of cpus)");
+DEFINE_string(splits, "1:1", "comma-separated producer:consumer ratios, "
+                             "e.g., 1:1,1:3");
+DEFINE_string(params, "", "data structure flags and their values, e.g., "
+                          "\"k=1,2,4;delay=0,100\"");
+DEFINE_uint64(operations, 1000, "number of operations per producer");
+DEFINE_uint64(duration, 0, "run each cell for the given number of ms instead "
+                           "of a fixed number of operations (0: disabled)");
+DEFINE_uint64(c, 5000, "computational workload (units of work, see c_ns and "
+                         "c_buffer)");
+DEFINE_uint64(trials, 1, "number of measured trials per cell, each on a "
+                         "fresh data structure");
+DEFINE_uint64(warmup, 0, "number of unmeasured trials per cell before the "
+                         "measured ones");
+DEFINE_string(format, "text", "result format: text (table), json (one "
+                              "object per line), or csv");
+
+DECLARE_uint64(c_ns);
+DECLARE_string(c_buffer);
+
+using scal::Benchmark;
+using scal::Result;
+using scal::Statistics;
+
+namespace {
+
+// A data structure flag and the values it is swept over.
+struct Param {
+  std::string name;
+  std::vector<std::string> values;
+};
+
+// A producer:consumer ratio.
+struct Split {
+  uint64_t producers;
+  uint64_t consumers;
+  std::string name;
+};
+
+void split_list(const std::string &list, char delimiter,
+                std::vector<std::string> *items) {
+  items->clear();
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(delimiter, start);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    items->push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+}
+
+bool parse_uint64(const std::string &s, uint64_t *value) {
+  char *end;
+  if (s.empty()) {
+    return false;
+  }
+  *value = strtoull(s.c_str(), &end, 10);
+  return *end == '\0';
+}
+
+bool parse_threads(const std::string &list, std::vector<uint64_t> *threads) {
+  threads->clear();
+  if (list.empty()) {
+    uint64_t cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (uint64_t n = 1; n < cpus; n *= 2) {
+      threads->push_back(n);
+    }
+    threads->push_back(cpus);
+    return true;
+  }
+  std::vector<std::string> items;
+  split_list(list, ',', &items);
+  for (uint64_t i = 0; i < items.size(); i++) {
+    uint64_t n;
+    if (!parse_uint64(items[i], &n) || n == 0) {
+      return false;
+    }
+    threads->push_back(n);
+  }
+  // Speedups are relative to the smallest thread count.
+  std::sort(threads->begin(), threads->end());
+  threads->erase(std::unique(threads->begin(), threads->end()),
+                 threads->end());
+  return true;
+}
+
+bool parse_splits(const std::string &list, std::vector<Split> *splits) {
+  splits->clear();
+  std::vector<std::string> items;
+  split_list(list, ',', &items);
+  for (uint64_t i = 0; i < items.size(); i++) {
+    size_t colon = items[i].find(':');
+    Split split;
+    if (colon == std::string::npos ||
+        !parse_uint64(items[i].substr(0, colon), &split.producers) ||
+        !parse_uint64(items[i].substr(colon + 1), &split.consumers) ||
+        split.producers == 0 || split.consumers == 0) {
+      return false;
+    }
+    split.name = items[i];
+    splits->push_back(split);
+  }
+  return true;
+}
+
+// Parses "<flag>=<value>,...;<flag>=<value>,...". Every flag has to exist.
+bool parse_params(const std::string &list, std::vector<Param> *params) {
+  params->clear();
+  if (list.empty()) {
+    return true;
+  }
+  std::vector<std::string> items;
+  split_list(list, ';', &items);
+  for (uint64_t i = 0; i < items.size(); i++) {
+    size_t equals = items[i].find('=');
+    std::string current;
+    Param param;
+    if (equals == std::string::npos) {
+      return false;
+    }
+    param.name = items[i].substr(0, equals);
+    split_list(items[i].substr(equals + 1), ',', &param.values);
+    if (!google::GetCommandLineOption(param.name.c_str(), &current)) {
+      return false;
+    }
+    params->push_back(param);
+  }
+  return true;
+}
+
+// Divides |threads| according to |split|, keeping at least one producer and
+// one consumer. A single thread is both and alternates puts and gets.
+void divide(uint64_t threads, const Split &split,
+            uint64_t *producers, uint64_t *consumers) {
+  if (threads == 1) {
+    *producers = 1;
+    *consumers = 0;
+    return;
+  }
+  *producers = (threads * split.producers + (split.producers +
+                split.consumers) / 2) / (split.producers + split.consumers);
+  *producers = std::max<uint64_t>(1, std::min(*producers, threads - 1));
+  *consumers = threads - *producers;
+}
+
+}  // namespace
+
+class SweepBench : public Benchmark {
+ public:
+  SweepBench(uint64_t num_threads,
+             uint64_t thread_prealloc_size,
+             uint64_t num_histograms,
+             void *data)
+                 : Benchmark(num_threads,
+                             thread_prealloc_size,
+                             num_histograms,
+                             data) {}
+
+ protected:
+  void bench_func(void);
+
+ private:
+  void producer(void);
+  void consumer(void);
+  void pairs(void);
+};
+
+uint64_t g_num_threads;
+// Producers and consumers of the current cell.
+uint64_t g_producers;
+uint64_t g_consumers;
+
+int main(int argc, const char **argv) {
+  std::string usage("Scalability sweep of the producer/consumer benchmark.");
+  google::SetUsageMessage(usage);
+  google::ParseCommandLineFlags(&argc, const_cast<char***>(&argv), true);
+
+  uint64_t tlsize = scal::human_size_to_pages(FLAGS_prealloc_size.c_str(),
+                                              FLAGS_prealloc_size.size());
+
+  std::vector<std::string> structures;
+  if (!ds_parse_list(FLAGS_ds, &structures)) {
+    if (structures.back().empty()) {
+      fprintf(stderr, "%s: error: no data structure selected, use --ds with "
+                      "one or more of: %s\n", __func__, ds_names().c_str());
+    } else {
+      fprintf(stderr, "%s: error: unknown data structure %s, use --ds with "
+                      "one or more of: %s\n",
+              __func__, structures.back().c_str(), ds_names().c_str());
+    }
+    abort();
+  }
+  std::vector<uint64_t> thread_counts;
+  if (!parse_threads(FLAGS_threads, &thread_counts)) {
+    fprintf(stderr, "%s: error: invalid thread counts %s\n",
+            __func__, FLAGS_threads.c_str());
+    abort();
+  }
+  std::vector<Split> splits;
+  if (!parse_splits(FLAGS_splits, &splits)) {
+    fprintf(stderr, "%s: error: invalid splits %s\n",
+            __func__, FLAGS_splits.c_str());
+    abort();
+  }
+  std::vector<Param> params;
+  if (!parse_params(FLAGS_params, &params)) {
+    fprintf(stderr, "%s: error: invalid parameters %s\n",
+            __func__, FLAGS_params.c_str());
+    abort();
+  }
+  if (FLAGS_trials == 0) {
+    fprintf(stderr, "%s: error: at least one trial is needed\n", __func__);
+    abort();
+  }
+  Result::Format format;
+  if (!Result::parse_format(FLAGS_format, &format)) {
+    fprintf(stderr, "%s: error: unknown result format %s\n",
+            __func__, FLAGS_format.c_str());
+    abort();
+  }
+
+  // Threads that are not part of a cell wait in the benchmark's barriers.
+  const uint64_t max_threads = thread_counts.back();
+  g_num_threads = max_threads;
+  scal::tlalloc_init(tlsize, true /* touch pages */);
+  scal::ThreadContext::prepare(max_threads + 1);
+  scal::ThreadContext::assign_context();
+
+  SweepBench *benchmark = new SweepBench(max_threads, tlsize, 0, NULL);
+  benchmark->set_duration(FLAGS_duration);
+  benchmark->set_workload(FLAGS_c);
+
+  uint64_t num_combinations = 1;
+  for (uint64_t i = 0; i < params.size(); i++) {
+    num_combinations *= params[i].values.size();
+  }
+
+  if (format == Result::kText) {
+    printf("%-20s %-24s %-6s %7s %9s %9s %18s %8s\n",
+           "ds", "params", "split", "threads", "producers", "consumers",
+           "throughput(ops/ms)", "speedup");
+  }
+  bool first_run = true;
+  for (uint64_t d = 0; d < structures.size(); d++) {
+    ds_select(structures[d]);
+    for (uint64_t combination = 0; combination < num_combinations;
+         combination++) {
+      // The first parameter varies slowest.
+      std::string assignment;
+      for (uint64_t i = params.size(), rest = combination; i-- > 0;) {
+        const Param &param = params[i];
+        const std::string &value = param.values[rest % param.values.size()];
+        rest /= param.values.size();
+        if (google::SetCommandLineOption(param.name.c_str(),
+                                         value.c_str()).empty()) {
+          fprintf(stderr, "%s: error: invalid value %s of %s\n",
+                  __func__, value.c_str(), param.name.c_str());
+          abort();
+        }
+        assignment = param.name + "=" + value +
+                     (assignment.empty() ? "" : ",") + assignment;
+      }
+      for (uint64_t s = 0; s < splits.size(); s++) {
+        double base_throughput = 0;
+        uint64_t base_threads = 0;
+        bool base_pairs = false;
+        for (uint64_t t = 0; t < thread_counts.size(); t++) {
+          g_num_threads = thread_counts[t];
+          divide(g_num_threads, splits[s], &g_producers, &g_consumers);
+          benchmark->set_active_threads(g_num_threads);
+          Statistics throughput;
+          Statistics steady_throughput;
+          for (uint64_t trial = 0; trial < FLAGS_warmup + FLAGS_trials;
+               trial++) {
+            if (!first_run) {
+              scal::tlalloc_reset();
+            }
+            first_run = false;
+            benchmark->set_data(ds_new());
+            benchmark->run();
+            if (trial < FLAGS_warmup) {
+              continue;
+            }
+            uint64_t total_operations = 0;
+            for (uint64_t i = 1; i <= g_num_threads; i++) {
+              total_operations += benchmark->operations(i);
+            }
+            throughput.add(total_operations /
+                (static_cast<double>(benchmark->execution_time()) / 1000));
+            double steady_time = benchmark->steady_time();
+            if (steady_time > 0) {
+              steady_throughput.add(
+                  benchmark->steady_operations() / (steady_time / 1000));
+            }
+          }
+          // A single thread runs put/get pairs without contention, which is
+          // no baseline for producers and consumers. Cells with a split are
+          // compared to the smallest thread count that runs the split.
+          const bool pairs = g_consumers == 0;
+          const char *split = pairs ? "pairs" : splits[s].name.c_str();
+          if (t == 0 || (base_pairs && !pairs)) {
+            base_throughput = throughput.mean();
+            base_threads = g_num_threads;
+            base_pairs = pairs;
+          }
+          double speedup = (base_throughput > 0)
+              ? throughput.mean() / base_throughput : 0;
+
+          if (format == Result::kText) {
+            printf("%-20s %-24s %-6s %7" PRIu64 " %9" PRIu64 " %9" PRIu64
+                   " %18.0f %8.2f\n",
+                   structures[d].c_str(),
+                   assignment.empty() ? "-" : assignment.c_str(),
+                   split, g_num_threads, g_producers,
+                   g_consumers, throughput.mean(), speedup);
+            fflush(stdout);
+            continue;
+          }
+          Result result;
+          result.add("record", "cell");
+          result.add("benchmark", "sweep");
+          result.add("ds", structures[d].c_str());
+          result.add("params", assignment.c_str());
+          result.add("split", split);
+          result.add("threads", g_num_threads);
+          result.add("producers", g_producers);
+          result.add("consumers", g_consumers);
+          result.add("ops", FLAGS_operations);
+          result.add("duration", FLAGS_duration);
+          result.add("workload", benchmark->workload_units());
+          result.add("trials", FLAGS_trials);
+          result.add_statistics("throughput", throughput);
+          result.add_statistics("steady_throughput", steady_throughput);
+          result.add("base_threads", base_threads);
+          result.add("speedup", speedup);
+          result.add("prefault_time", scal::tlalloc_prefault_time() +
+                                      benchmark->prefault_time());
+          ds_get_stats(&result);
+          // Structures add different fields, so each gets its own CSV header.
+          result.print(stdout, format,
+                       combination == 0 && s == 0 && t == 0);
+        }
+      }
+    }
+  }
+  benchmark->shutdown();
+  return EXIT_SUCCESS;
+}
+
+void SweepBench::producer(void) {
+  Pool<uint64_t> *ds = static_cast<Pool<uint64_t>*>(data_);
+  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  volatile uint64_t *counter = operation_counter();
+  scal::Workload *workload = this->workload();
+  const uint64_t units = workload_units();
+  const bool timed = FLAGS_duration > 0;
+  // Do not use 0 as value, since there may be datastructures that do not
+  // support it.
+  for (uint64_t i = 1; timed ? !stopped() : (i <= FLAGS_operations); i++) {
+    if (!ds->put((thread_id << 48) | i)) {
+      fprintf(stderr, "%s: error: put operation failed.\n", __func__);
+      abort();
+    }
+    (*counter)++;
+    workload->run(units);
+  }
+}
+
+void SweepBench::consumer(void) {
+  Pool<uint64_t> *ds = static_cast<Pool<uint64_t>*>(data_);
+  uint64_t index = scal::ThreadContext::get().thread_id() - g_producers;
+  // The first consumers collect the remaining items.
+  uint64_t operations = g_producers * FLAGS_operations / g_consumers;
+  if (index <= (g_producers * FLAGS_operations) % g_consumers) {
+    operations++;
+  }
+  volatile uint64_t *counter = operation_counter();
+  scal::Workload *workload = this->workload();
+  const uint64_t units = workload_units();
+  const bool timed = FLAGS_duration > 0;
+  uint64_t j = 0;
+  uint64_t item;
+  while (timed ? !stopped() : (j < operations)) {
+    bool ok = ds->get(&item);
+    workload->run(units);
+    if (ok) {
+      (*counter)++;
+      j++;
+    }
+  }
+}
+
+// A single thread puts an item and gets one.
+void SweepBench::pairs(void) {
+  Pool<uint64_t> *ds = static_cast<Pool<uint64_t>*>(data_);
+  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  volatile uint64_t *counter = operation_counter();
+  scal::Workload *workload = this->workload();
+  const uint64_t units = workload_units();
+  const bool timed = FLAGS_duration > 0;
+  uint64_t item;
+  for (uint64_t i = 1; timed ? !stopped() : (i <= FLAGS_operations); i++) {
+    if (!ds->put((thread_id << 48) | i)) {
+      fprintf(stderr, "%s: error: put operation failed.\n", __func__);
+      abort();
+    }
+    (*counter)++;
+    workload->run(units);
+    // Relaxed data structures may miss the item on the first attempt.
+    while (!ds->get(&item)) {}
+    (*counter)++;
+    workload->run(units);
+  }
+}
+
+void SweepBench::bench_func(void) {
+  // As in the producer/consumer benchmark, the lower thread ids are the
+  // producers.
+  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  if (g_consumers == 0) {
+    pairs();
+  } else if (thread_id <= g_producers) {
+    producer();
+  } else {
+    consumer();
+  }
+}
@@ -10,23 +10,15 @@
 
 class Balancer1Random : public BalancerInterface {
  public:
-  explicit Balancer1Random(bool use_hw_random) {
-    use_hw_random_ = use_hw_random;
-  }
+  // The generator is selected through scal::set_rand_generator.
+  Balancer1Random() {}
 
   uint64_t get(uint64_t num_queues, MSQueue<uint64_t> **queues, bool enqueue) {
     if (num_queues == 1) {
       return 0;
     }
-    if (use_hw_random_) {
-      return hwrand() % num_queues;
-    } else {
-      return pseudorand() % num_queues;
-    }
+    return scal::rand_range(0, num_queues);
   }
-
- private:
-  bool use_hw_random_;
 };
 
 #endif  // SCAL_DATASTRUCTURES_BALANCER_1RANDOM_H_
@@ -84,17 +84,23 @@ void BoundedSizeKFifo<T>::find_index(uint64_t start_index,
                                      bool empty,
                                      int64_t *item_index,
                                      AtomicValue<T> *old) {
-  uint64_t random_index = pseudorand() % k_;
+  // The segment is k-aligned and does not wrap around, as the queue size is
+  // a multiple of k.
+  uint64_t segment = start_index % queue_size_;
+  uint64_t random_index = scal::rand_range(0, k_);
   uint64_t index;
   *item_index = kNoIndexFound;
   for (size_t i = 0; i < k_; i++) {
-    index = (start_index + ((random_index + i) % k_)) % queue_size_;
+    index = segment + random_index;
     *old = *queue_[index];
     if ((empty && old->value() == (T)NULL)
         || (!empty && old->value() != (T)NULL)) {
       *item_index = index;
       return;
     }
+    if (++random_index == k_) {
+      random_index = 0;
+    }
   }
 }
 
@@ -12,14 +12,19 @@
 #include "datastructures/ms_queue.h"
 #include "datastructures/pool.h"
 #include "util/malloc.h"
+#include "util/numa.h"
 #include "util/platform.h"
+#include "util/thread_array.h"
 
 template<typename T, class P>
 class DistributedQueue : public Pool<T> {
  public:
+  // If |numa_partials| is set, the partial queues are spread over the NUMA
+  // nodes in blocks of consecutive queues instead of being placed where the
+  // creating thread runs.
   DistributedQueue(size_t num_queues,
-           uint64_t num_threads,
-           BalancerInterface *balancer);
+           BalancerInterface *balancer,
+           bool numa_partials);
   bool put(T item);
   bool get(T *item);
 
@@ -29,23 +34,38 @@ class DistributedQueue : public Pool<T> {
   P **backend_;
   size_t num_queues_;
   BalancerInterface *balancer_;
-  AtomicRaw **tails_;
+  // Empty states of the partial queues last seen by each thread, allocated
+  // by the thread itself.
+  scal::ThreadArray<AtomicRaw*> tails_;
+
+  inline AtomicRaw* tails(uint64_t thread_id);
 };
 
 template<typename T, class P>
 DistributedQueue<T, P>::DistributedQueue(
-    size_t num_queues, uint64_t num_threads, BalancerInterface *balancer) {
+    size_t num_queues, BalancerInterface *balancer, bool numa_partials) {
   num_queues_ = num_queues;
   balancer_ = balancer;
   backend_ = static_cast<P**>(calloc(num_queues_, sizeof(P*)));
+  const uint64_t num_nodes = scal::numa_num_nodes();
   for (uint64_t i = 0; i < num_queues_; i++) {
-    backend_[i] = scal::get<P>(kPtrAlignment);
+    if (numa_partials) {
+      backend_[i] = scal::get_on_node<P>(i * num_nodes / num_queues_);
+    } else {
+      backend_[i] = scal::get<P>(kPtrAlignment);
+    }
   }
-  tails_ = static_cast<AtomicRaw**>(calloc(num_threads, sizeof(*tails_)));
-  for (uint64_t i = 0; i < num_threads; i++) {
-    tails_[i] = static_cast<AtomicRaw*>(scal::tlcalloc_aligned(
+}
+
+template<typename T, class P>
+AtomicRaw* DistributedQueue<T, P>::tails(uint64_t thread_id) {
+  AtomicRaw *tails = tails_[thread_id];
+  if (tails == NULL) {
+    tails = static_cast<AtomicRaw*>(scal::tlcalloc_aligned(
         num_queues_, sizeof(AtomicRaw), kPtrAlignment));
+    tails_[thread_id] = tails;
   }
+  return tails;
 }
 
 template<typename T, class P>
@@ -57,20 +77,20 @@ bool DistributedQueue<T, P>::put(T item) {
 template<typename T, class P>
 bool DistributedQueue<T, P>::get(T *item) {
   size_t i;
-  uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  AtomicRaw *tails = this->tails(scal::ThreadContext::get().thread_id());
   uint64_t start = balancer_->get(num_queues_, NULL, false);
   size_t index;
   while (true) {
     for (i = 0; i < num_queues_; i++) {
       index = (start + i) % num_queues_;
       if (backend_[index]->get_return_empty_state(
-              item, &(tails_[thread_id][index]))) {
+              item, &tails[index])) {
         return true;
       }
     }
     for (i = 0; i < num_queues_; i++) {
       index = (start + i) % num_queues_;
-      if (backend_[index]->empty_state() != tails_[thread_id][index]) {
+      if (backend_[index]->empty_state() != tails[index]) {
         start = index;
         break;
       }
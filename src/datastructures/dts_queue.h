@@ -17,6 +17,7 @@
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
+#include "util/thread_array.h"
 
 #define DTS_DEBUG
 
@@ -29,15 +30,23 @@ class DTSQueue : Queue<T>{
       std::atomic<uint64_t> timestamp[2];
     } Item;
 
-    uint64_t num_threads_;
+    // The insert and remove pointers of a thread-local list, in different
+    // cache lines.
+    typedef struct Buffer {
+      std::atomic<Item*> insert;
+      uint8_t padding[scal::kCachePrefetch * 4 - sizeof(std::atomic<Item*>)];
+      std::atomic<Item*> remove;
+    } Buffer;
+
     AtomicCounterTimestamp *timestamping_;
     AtomicCounterTimestamp *dequeue_timestamping_;
-    std::atomic<Item*> **insert_;
-    std::atomic<Item*> **remove_;
+    // Buffers are kept per thread id and created on first use, so threads
+    // may come and go.
+    scal::ThreadArray<std::atomic<Buffer*> > buffers_;
 
 #ifdef DTS_DEBUG
-    uint64_t* *counter1_;
-    uint64_t* *counter2_;
+    scal::ThreadArray<uint64_t> counter1_;
+    scal::ThreadArray<uint64_t> counter2_;
 #endif
 
     // Helper function to remove the ABA counter from a pointer.
@@ -58,11 +67,23 @@ class DTSQueue : Queue<T>{
       return (void*)((result & 0xffffffffffffff8) | aba);
     }
 
+    Buffer* register_thread(uint64_t thread_id) {
+      Buffer *buffer = scal::get<Buffer>(scal::kCachePrefetch * 4);
+      // Add a sentinal node.
+      Item *new_item = scal::get<Item>(scal::kCachePrefetch * 4);
+      timestamping_->init_sentinel_atomic(new_item->timestamp);
+      new_item->data.store(0);
+      new_item->next.store(NULL);
+      buffer->insert.store(new_item);
+      buffer->remove.store(new_item);
+      buffers_[thread_id].store(buffer);
+      return buffer;
+    }
+
   public:
+    // Threads register on their first enqueue.
     void initialize(uint64_t num_threads) {
 
-      num_threads_ = num_threads;
-
       timestamping_ = static_cast<AtomicCounterTimestamp*>(
           scal::get<AtomicCounterTimestamp>(scal::kCachePrefetch * 4));
 
@@ -72,96 +93,35 @@ class DTSQueue : Queue<T>{
           scal::get<AtomicCounterTimestamp>(scal::kCachePrefetch * 4));
 
       dequeue_timestamping_->initialize(0, num_threads);
-
-      insert_ = static_cast<std::atomic<Item*>**>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<Item*>*), 
-            scal::kCachePrefetch * 4));
-
-      remove_ = static_cast<std::atomic<Item*>**>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<Item*>*), 
-            scal::kCachePrefetch * 4));
-
-      for (int i = 0; i < num_threads_; i++) {
-
-        insert_[i] = static_cast<std::atomic<Item*>*>(
-            scal::get<std::atomic<Item*>>(scal::kCachePrefetch * 4));
-
-        remove_[i] = static_cast<std::atomic<Item*>*>(
-            scal::get<std::atomic<Item*>>(scal::kCachePrefetch * 4));
-
-        // Add a sentinal node.
-        Item *new_item = scal::get<Item>(scal::kCachePrefetch * 4);
-        timestamping_->init_sentinel_atomic(new_item->timestamp);
-        new_item->data.store(0);
-        new_item->next.store(NULL);
-        insert_[i]->store(new_item);
-        remove_[i]->store(new_item);
-      }
-
-#ifdef DTS_DEBUG
-      counter1_ = static_cast<uint64_t**>(
-          scal::calloc_aligned(num_threads, sizeof(uint64_t*),
-            scal::kCachePrefetch * 4));
-      counter2_ = static_cast<uint64_t**>(
-          scal::calloc_aligned(num_threads, sizeof(uint64_t*),
-            scal::kCachePrefetch * 4));
-
-      for (uint64_t i = 0; i < num_threads; i++) {
-        counter1_[i] = scal::get<uint64_t>(scal::kCachePrefetch * 4);
-        *(counter1_[i]) = 0;
-        counter2_[i] = scal::get<uint64_t>(scal::kCachePrefetch * 4);
-        *(counter2_[i]) = 0;
-      }
-#endif
     }
 
 #ifdef DTS_DEBUG
     inline void inc_counter1(uint64_t value) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      (*counter1_[thread_id]) += value;
+      counter1_[thread_id] += value;
     }
     
     inline void inc_counter2(uint64_t value) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      (*counter2_[thread_id]) += value;
+      counter2_[thread_id] += value;
     }
 #endif
 
-    char* ds_get_stats(void) {
+    bool ds_get_stats(uint64_t *c1, uint64_t *c2) {
 #ifdef DTS_DEBUG
-      uint64_t sum1 = 0;
-      uint64_t sum2 = 1;
-
-      for (int i = 0; i < num_threads_; i++) {
-        sum1 += *counter1_[i];
-        sum2 += *counter2_[i];
-      }
-
-      if (sum1 == 0) {
-        // Avoid division by zero.
-        sum1 = 1;
-      }
-
-      double avg1 = sum1;
-      avg1 = (double)0;
-
-      double avg2 = sum2;
-      avg2 /= (double)sum1;
-
-      char buffer[255] = { 0 };
-      uint32_t n = snprintf(buffer,
-                            sizeof(buffer),
-                            ";c1: %.2f ;c2: %.2f",
-                            avg1, avg2);
-      if (n != strlen(buffer)) {
-        fprintf(stderr, "%s: error creating stats string\n", __func__);
-        abort();
+      *c1 = 0;
+      *c2 = 0;
+      for (uint64_t i = 0; i < scal::ThreadContext::num_ids(); i++) {
+        if (counter1_.find(i) != NULL) {
+          *c1 += *counter1_.find(i);
+        }
+        if (counter2_.find(i) != NULL) {
+          *c2 += *counter2_.find(i);
+        }
       }
-      char *newbuf = static_cast<char*>(calloc(
-          strlen(buffer) + 1, sizeof(*newbuf)));
-      return strncpy(newbuf, buffer, strlen(buffer));
+      return true;
 #else
-      return NULL;
+      return false;
 #endif
     }
 
@@ -177,18 +137,23 @@ class DTSQueue : Queue<T>{
       new_item->data.store(element);
       new_item->next.store(NULL);
 
+      Buffer *buffer = buffers_[thread_id].load();
+      if (buffer == NULL) {
+        buffer = register_thread(thread_id);
+      }
+
       // Add the item to the thread-local list.
-      Item* old_insert = insert_[thread_id]->load();
+      Item* old_insert = buffer->insert.load();
       old_insert->next.store(new_item);
-      insert_[thread_id]->store(new_item);
+      buffer->insert.store(new_item);
     };
 
     bool try_remove_oldest(T *element, uint64_t *dequeue_timestamp) {
       // Initialize the result pointer to NULL, which means that no 
       // element has been removed.
       Item *result = NULL;
-      // Indicates the index of the buffer which contains the oldest item.
-      uint64_t buffer_index = -1;
+      // The buffer which contains the oldest item.
+      Buffer *result_buffer = NULL;
       // Memory on the stack frame where timestamps of items can be stored
       // temporarily.
       uint64_t tmp_timestamp[2][2];
@@ -203,20 +168,26 @@ class DTSQueue : Queue<T>{
       Item* old_remove = NULL;
 
       // We start iterating of the thread-local lists at a random index.
-      uint64_t start = hwrand();
+      uint64_t num_buffers = scal::ThreadContext::num_ids();
+      uint64_t start = scal::rand_range(0, num_buffers);
       // We iterate over all thead-local buffers
-      uint64_t num_buffers = num_threads_;
       for (uint64_t i = 0; i < num_buffers; i++) {
 #ifdef DTS_DEBUG
         inc_counter2(1);
 #endif
 
         uint64_t tmp_buffer_index = (start + i) % (num_buffers);
+        std::atomic<Buffer*> *entry = buffers_.find(tmp_buffer_index);
+        Buffer *buffer = (entry != NULL) ? entry->load() : NULL;
+        if (buffer == NULL) {
+          // The thread has not enqueued anything yet.
+          continue;
+        }
 
         // We get the remove/insert pointer of the current thread-local 
         // buffer.
-        Item* tmp_remove = remove_[tmp_buffer_index]->load();
-        Item* tmp_insert = insert_[tmp_buffer_index]->load();
+        Item* tmp_remove = buffer->remove.load();
+        Item* tmp_insert = buffer->insert.load();
         Item* item = 
           ((Item*)get_aba_free_pointer(tmp_remove))->next.load();
         // We get the oldest element from that thread-local buffer.
@@ -230,8 +201,8 @@ class DTSQueue : Queue<T>{
           // Check if we can remove the element immediately.
           if (!timestamping_->is_later(item_timestamp, dequeue_timestamp)) {
             uint64_t expected = 0;
-            if ((remove_[tmp_buffer_index]->load() == tmp_remove) &&
-                remove_[tmp_buffer_index]->compare_exchange_weak(
+            if ((buffer->remove.load() == tmp_remove) &&
+                buffer->remove.compare_exchange_weak(
                     tmp_remove, (Item*)add_next_aba(item, tmp_remove, 1))) {
 
               // The item has been removed. 
@@ -240,8 +211,8 @@ class DTSQueue : Queue<T>{
             } else {
               // Elimination failed, we have to load a new element of that
               // buffer.
-              tmp_remove = remove_[tmp_buffer_index]->load();
-              tmp_insert = insert_[tmp_buffer_index]->load();
+              tmp_remove = buffer->remove.load();
+              tmp_insert = buffer->insert.load();
               item =((Item*)get_aba_free_pointer(tmp_remove))->next.load();
               if (get_aba_free_pointer(tmp_remove) != tmp_insert) {
                 timestamping_->load_timestamp(tmp_timestamp[tmp_index], item->timestamp);
@@ -254,7 +225,7 @@ class DTSQueue : Queue<T>{
             if (timestamping_->is_later(timestamp, item_timestamp)) {
               // We found a new oldest element, so we remember it.
               result = item;
-              buffer_index = tmp_buffer_index;
+              result_buffer = buffer;
               timestamp = item_timestamp;
               tmp_index ^=1;
               old_remove = tmp_remove;
@@ -263,8 +234,8 @@ class DTSQueue : Queue<T>{
         }
       }
       if (result != NULL) {
-        if (remove_[buffer_index]->load() == old_remove) {
-          if (remove_[buffer_index]->compare_exchange_weak(
+        if (result_buffer->remove.load() == old_remove) {
+          if (result_buffer->remove.compare_exchange_weak(
                 old_remove, (Item*)add_next_aba(result, old_remove, 1))) {
             *element = result->data.load();
             return true;
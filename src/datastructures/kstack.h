@@ -20,9 +20,11 @@
 
 #include "datastructures/stack.h"
 #include "util/atomic_value.h"
+#include "util/epoch.h"
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
+#include "util/thread_array.h"
 #include "util/threadlocals.h"
 
 namespace kstack_details {
@@ -55,7 +57,7 @@ uint64_t KSegment<T>::K = 1;
 template<typename T>
 class KStack : public Stack<T> {
  public:
-  KStack(uint64_t k, uint64_t num_threads);
+  explicit KStack(uint64_t k);
   bool push(T item);
   bool pop(T *item);
 
@@ -79,50 +81,79 @@ class KStack : public Stack<T> {
                  uint64_t index);
 
   AtomicPointer<KSegment*> *top_;
-  AtomicRaw **item_records_;
+  // Items of a segment last seen empty by each thread, allocated by the
+  // thread itself.
+  scal::ThreadArray<AtomicRaw*> item_records_;
   uint64_t k_;
-  uint64_t num_threads_;
+  // Segments removed from the top for reuse, NULL if reclamation is
+  // disabled.
+  scal::EpochPool<KSegment> *pool_;
+
+  inline KSegment* ksegment_new(void);
 };
 
 template<typename T>
-KStack<T>::KStack(uint64_t k, uint64_t num_threads) {
+KStack<T>::KStack(uint64_t k) {
   k_ = k;
-  num_threads_ = num_threads;
   KSegment::K = k_;
+  if (scal::Epoch::enabled()) {
+    // Items are reused with their segment.
+    pool_ = new scal::EpochPool<KSegment>(sizeof(KSegment) +
+        sizeof(uint64_t) + sizeof(AtomicPointer<KSegment*>) +
+        k_ * (sizeof(AtomicValue<T>*) + sizeof(AtomicValue<T>)));
+  } else {
+    pool_ = NULL;
+  }
   top_ = scal::tlget<AtomicPointer<KSegment*> >(kSegmentSize);
   top_->weak_set_value(scal::tlget<KSegment>(kSegmentSize));
-  item_records_ = static_cast<AtomicRaw**>(scal::calloc_aligned(
-      num_threads_, sizeof(*item_records_), kPtrAlignment));
-  for (uint64_t i = 0; i < num_threads_; i++) {
-    item_records_[i] = static_cast<AtomicRaw*>(scal::tlcalloc_aligned(
-        k_, sizeof(*(item_records_[i])), kPtrAlignment));
+}
+
+template<typename T>
+kstack_details::KSegment<T>* KStack<T>::ksegment_new(void) {
+  KSegment *segment = (pool_ != NULL) ? pool_->get() : NULL;
+  if (segment == NULL) {
+    return scal::tlget<KSegment>(kSegmentSize);
   }
+  // All items have been popped or withdrawn before the segment was removed.
+  *(segment->remove) = 0;
+  return segment;
 }
 
 template<typename T>
 bool KStack<T>::is_empty(KSegment* segment) {
   // Distributed Queue style empty check.
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
-  uint64_t random_index = pseudorand() % k_;
-  uint64_t index;
+  AtomicRaw *item_records = item_records_[thread_id];
+  if (item_records == NULL) {
+    item_records = static_cast<AtomicRaw*>(scal::tlcalloc_aligned(
+        k_, sizeof(*item_records), kPtrAlignment));
+    item_records_[thread_id] = item_records;
+  }
+  uint64_t random_index = scal::rand_range(0, k_);
+  uint64_t index = random_index;
   AtomicValue<T> item_old;
   for (uint64_t i =0; i < k_; i++) {
-    index = (random_index + i) % k_;
     item_old = *(segment->items[index]);
     AtomicValue<T> item_empty((T)NULL, item_old.aba() + 1);
     if (item_old.value() != (T)NULL) {
       return false;
     } else {
-     item_records_[thread_id][index] = item_old.raw(); 
+     item_records[index] = item_old.raw(); 
+    }
+    if (++index == k_) {
+      index = 0;
     }
   }
+  index = random_index;
   for (uint64_t i = 0; i < k_; i++) {
-    index = (random_index + i) % k_;
     item_old = *(segment->items[index]);
     AtomicValue<T> item_empty((T)NULL, item_old.aba() + 1);
-    if (item_old.raw() != item_records_[thread_id][index]) {
+    if (item_old.raw() != item_records[index]) {
       return false;
     }
+    if (++index == k_) {
+      index = 0;
+    }
   }
   return true;
 }
@@ -130,10 +161,12 @@ bool KStack<T>::is_empty(KSegment* segment) {
 template<typename T>
 void KStack<T>::try_add_new_ksegment(AtomicPointer<KSegment*> top_old) {
   if (top_->raw() == top_old.raw()) {
-    KSegment *segment_new = scal::tlget<KSegment>(kSegmentSize);
+    KSegment *segment_new = ksegment_new();
     segment_new->next->weak_set_value(top_old.value());
     AtomicPointer<KSegment*> top_new(segment_new, top_old.aba());
-    top_->cas(top_old, top_new);
+    if (!top_->cas(top_old, top_new) && pool_ != NULL) {
+      pool_->retire(segment_new);
+    }
   }
 }
 
@@ -147,6 +180,9 @@ void KStack<T>::try_remove_ksegment(AtomicPointer<KSegment*> top_old) {
         AtomicPointer<KSegment*> top_new(top_old.value()->next->value(),
                                          top_old.aba() + 1);
         if (top_->cas(top_old, top_new)) {
+          if (pool_ != NULL) {
+            pool_->retire(top_old.value());
+          }
           return;
         }
       }
@@ -187,22 +223,24 @@ void KStack<T>::find_index(KSegment *segment,
                            bool empty,
                            uint64_t *item_index,
                            AtomicValue<T> *old) {
-  uint64_t random_index = pseudorand() % k_;
-  uint64_t i;
+  uint64_t i = scal::rand_range(0, k_);
   *item_index = kNoIndexFound;
   for (uint64_t _cnt = 0; _cnt < k_; _cnt++) {
-    i = (random_index + _cnt) % k_;
     *old = *(segment->items[i]);
     if ((empty && old->value() == (T)NULL) ||
         (!empty && old->value() != (T)NULL)) {
       *item_index = i;
       return;
     }
+    if (++i == k_) {
+      i = 0;
+    }
   }
 }
 
 template<typename T>
 bool KStack<T>::push(T item) {
+  scal::EpochGuard guard;
   AtomicPointer<KSegment*> top_old;
   AtomicValue<T> item_old;
   uint64_t item_index;
@@ -226,6 +264,7 @@ bool KStack<T>::push(T item) {
 
 template<typename T>
 bool KStack<T>::pop(T *item) {
+  scal::EpochGuard guard;
   AtomicPointer<KSegment*> top_old;
   AtomicValue<T> item_old;
   uint64_t item_index;
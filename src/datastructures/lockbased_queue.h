@@ -83,7 +83,8 @@ LockBasedQueue<T>::LockBasedQueue(uint64_t dequeue_mode,
   enqueue_cond_ = scal::get<pthread_cond_t>(kPtrAlignment);
   rc = pthread_cond_init(enqueue_cond_, NULL);
   check_error("pthread_cond_init", rc);
-  Node *node = scal::get<Node>(kPtrAlignment);
+  // Dequeued sentinels are freed through tlfree.
+  Node *node = scal::tlget<Node>(kPtrAlignment);
   head_ = node;
   tail_ = node;
   dequeue_mode_ = dequeue_mode;
@@ -115,10 +116,12 @@ bool LockBasedQueue<T>::dequeue_default(T *item) {
     check_error("pthread_mutex_unlock", rc);
     return false;
   }
+  Node *head_old = head_;
   *item = head_->next->value;
   head_ = head_->next;
   rc = pthread_mutex_unlock(global_lock_);
   check_error("pthread_mutex_unlock", rc);
+  scal::tlfree(head_old, sizeof(Node));
   return true;
 }
 
@@ -132,10 +135,12 @@ bool LockBasedQueue<T>::dequeue_blocking(T *item) {
       pthread_cond_wait(enqueue_cond_, global_lock_);
     }
     assert(head_ != tail_);
+    Node *head_old = head_;
     *item = head_->next->value;
     head_ = head_->next;
     rc = pthread_mutex_unlock(global_lock_);
     check_error("pthread_mutex_unlock", rc);
+    scal::tlfree(head_old, sizeof(Node));
     return true;
   }
 }
@@ -173,10 +178,12 @@ bool LockBasedQueue<T>::dequeue_timeout(T *item, uint64_t timeout_ms) {
       check_error("pthread_cond_timedwait", rc);
     }
     assert(head_ != tail_);
+    Node *head_old = head_;
     *item = head_->next->value;
     head_ = head_->next;
     rc = pthread_mutex_unlock(global_lock_);
     check_error("pthread_mutex_unlock", rc);
+    scal::tlfree(head_old, sizeof(Node));
     return true;
   }
 }
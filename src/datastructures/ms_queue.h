@@ -18,9 +18,12 @@
 #include "datastructures/distributed_queue_interface.h"
 #include "datastructures/queue.h"
 #include "util/atomic_value.h"
+#include "util/epoch.h"
+#include "util/hazard_pointers.h"
 #include "util/malloc.h"
 #include "util/operation_logger.h"
 #include "util/platform.h"
+#include "util/reclamation.h"
 #include "util/threadlocals.h"
 
 namespace ms_details {
@@ -63,6 +66,8 @@ class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
   bool dequeue(T *item);
 
   bool dequeue_return_tail(T *item, AtomicRaw *tail_raw);
+  // With epoch-based reclamation, callers have to read |tail_old| and
+  // |head_old| within an EpochGuard of their own.
   bool try_enqueue(T item, AtomicPointer<ms_details::Node<T>*> tail_old);
   uint8_t try_dequeue(T *item,
                       AtomicPointer<ms_details::Node<T>*> head_old,
@@ -87,9 +92,14 @@ class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
 
   AtomicPointer<Node*> *head_;
   AtomicPointer<Node*> *tail_;
+  // Dequeued nodes for reuse, NULL if reclamation is disabled.
+  scal::Reclaimer<Node> *pool_;
 
   inline Node* node_new(T item) const {
-    Node *node = scal::tlget_aligned<Node>(scal::kCachePrefetch);
+    Node *node = (pool_ != NULL) ? pool_->get() : NULL;
+    if (node == NULL) {
+      node = scal::tlget_aligned<Node>(scal::kCachePrefetch);
+    }
     node->next.weak_set_value(NULL);
     node->next.weak_set_aba(0);
     node->value = item;
@@ -99,6 +109,7 @@ class MSQueue : public Queue<T>, public DistributedQueueInterface<T> {
 
 template<typename T>
 MSQueue<T>::MSQueue(void) {
+  pool_ = scal::Reclaimer<Node>::create();
   head_ = scal::get_aligned<AtomicPointer<Node*> >(4 * 128);
   tail_ = scal::get_aligned<AtomicPointer<Node*> >(4 * 128);
   Node *node = node_new((T)NULL);
@@ -108,11 +119,15 @@ MSQueue<T>::MSQueue(void) {
 
 template<typename T>
 bool MSQueue<T>::enqueue(T item) {
+  scal::EpochGuard guard;
   Node *node = node_new(item);
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> next;
   while (true) {
     tail_old = *tail_;
+    if (!scal::HazardPointers::protect(0, tail_old, tail_)) {
+      continue;
+    }
     next = tail_old.value()->next;
     if (tail_old.raw() == tail_->raw()) {
       if (next.value() == NULL) {
@@ -134,13 +149,19 @@ bool MSQueue<T>::enqueue(T item) {
 
 template<typename T>
 bool MSQueue<T>::dequeue(T *item) {
+  scal::EpochGuard guard;
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> next;
   while (true) {
     head_old = *head_;
+    if (!scal::HazardPointers::protect(0, head_old, head_)) {
+      continue;
+    }
     tail_old = *tail_;
     next = head_old.value()->next;
+    // Validated by checking that the head has not moved on.
+    scal::HazardPointers::publish(1, next.value());
     if (head_->raw() == head_old.raw()) {
       if (head_old.value() == tail_old.value()) {
         if (next.value() == NULL) {
@@ -154,6 +175,9 @@ bool MSQueue<T>::dequeue(T *item) {
         AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
         if (head_->cas(head_old, head_new)) {
           scal::StdOperationLogger::get().linearization();
+          if (pool_ != NULL) {
+            pool_->retire(head_old.value());
+          }
           break;
         }
       }
@@ -164,13 +188,19 @@ bool MSQueue<T>::dequeue(T *item) {
 
 template<typename T>
 bool MSQueue<T>::dequeue_return_tail(T *item, AtomicRaw *tail_raw) {
+  scal::EpochGuard guard;
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> next;
   while (true) {
     head_old = *head_;
+    if (!scal::HazardPointers::protect(0, head_old, head_)) {
+      continue;
+    }
     tail_old = *tail_;
     next = head_old.value()->next;
+    // Validated by checking that the head has not moved on.
+    scal::HazardPointers::publish(1, next.value());
     if (head_->raw() == head_old.raw()) {
       if (head_old.value() == tail_old.value()) {
         if (next.value() == NULL) {
@@ -185,6 +215,9 @@ bool MSQueue<T>::dequeue_return_tail(T *item, AtomicRaw *tail_raw) {
         AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
         if (head_->cas(head_old, head_new)) {
           scal::StdOperationLogger::get().linearization();
+          if (pool_ != NULL) {
+            pool_->retire(head_old.value());
+          }
           *tail_raw = tail_old.raw();
           break;
         }
@@ -197,6 +230,10 @@ bool MSQueue<T>::dequeue_return_tail(T *item, AtomicRaw *tail_raw) {
 template<typename T>
 bool MSQueue<T>::try_enqueue(
     T item, AtomicPointer<ms_details::Node<T>*> tail_old) {
+  scal::EpochGuard guard;
+  if (!scal::HazardPointers::protect(0, tail_old, tail_)) {
+    return false;
+  }
   AtomicPointer<Node*> next = tail_old.value()->next;
   if (tail_->raw() == tail_old.raw()) {
     if (next.value() == NULL) {
@@ -208,6 +245,9 @@ bool MSQueue<T>::try_enqueue(
         tail_->cas(tail_old, tail_new);
         return true;
       }
+      if (pool_ != NULL) {
+        pool_->retire(node);
+      }
     } else {
       AtomicPointer<Node*> tail_new(next.value(), tail_old.aba() + 1);
       tail_->cas(tail_old, tail_new);
@@ -219,8 +259,14 @@ bool MSQueue<T>::try_enqueue(
 template<typename T>
 uint8_t MSQueue<T>::try_dequeue(
     T *item, AtomicPointer<ms_details::Node<T>*> head_old, uint64_t *tail_raw) {
+  scal::EpochGuard guard;
+  if (!scal::HazardPointers::protect(0, head_old, head_)) {
+    scal::StdOperationLogger::get().linearization();
+    return 2;  // failed
+  }
   AtomicPointer<Node*> tail_old = *tail_;
   AtomicPointer<Node*> next = head_old.value()->next;
+  scal::HazardPointers::publish(1, next.value());
   if (head_->raw() == head_old.raw()) {
     if (head_old.value() == tail_old.value()) {
       if (next.value() == NULL) {
@@ -236,6 +282,9 @@ uint8_t MSQueue<T>::try_dequeue(
       AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
       if (head_->cas(head_old, head_new)) {
         scal::StdOperationLogger::get().linearization();
+        if (pool_ != NULL) {
+          pool_->retire(head_old.value());
+        }
         *tail_raw = tail_old.aba();
         return 0;  // ok
       }
@@ -26,6 +26,7 @@
 
 #include "datastructures/queue.h"
 #include "util/atomic_value.h"
+#include "util/epoch.h"
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
@@ -55,12 +56,16 @@ class RandomDequeueQueue : public Queue<T> {
   uint64_t max_retries_;
   AtomicPointer<Node*> *head_;
   AtomicPointer<Node*> *tail_;
+  // Nodes unlinked from the head for reuse, NULL if reclamation is
+  // disabled.
+  scal::EpochPool<Node> *pool_;
 };
 
 template<typename T>
 RandomDequeueQueue<T>::RandomDequeueQueue(uint64_t quasi_factor,
                                           uint64_t max_retries) {
   quasi_factor_ = quasi_factor;
+  pool_ = scal::Epoch::enabled() ? new scal::EpochPool<Node>() : NULL;
   Node *n = scal::get<Node>(scal::kCachePrefetch);
   head_ = scal::get<AtomicPointer<Node*> >(scal::kPageSize);
   tail_ = scal::get<AtomicPointer<Node*> >(scal::kPageSize);
@@ -71,7 +76,14 @@ RandomDequeueQueue<T>::RandomDequeueQueue(uint64_t quasi_factor,
 template<typename T> bool
 RandomDequeueQueue<T>::enqueue(T item) {
   assert(item != (T)NULL);
-  Node *node = scal::tlget<Node>(scal::kCachePrefetch);
+  scal::EpochGuard guard;
+  Node *node = (pool_ != NULL) ? pool_->get() : NULL;
+  if (node == NULL) {
+    node = scal::tlget<Node>(scal::kCachePrefetch);
+  } else {
+    node->next.weak_set_value(NULL);
+    node->deleted = false;
+  }
   node->value = item;
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> next;
@@ -97,6 +109,7 @@ RandomDequeueQueue<T>::enqueue(T item) {
 
 template<typename T>
 bool RandomDequeueQueue<T>::dequeue(T *item) {
+  scal::EpochGuard guard;
   AtomicPointer<Node*> tail_old;
   AtomicPointer<Node*> head_old;
   AtomicPointer<Node*> next;
@@ -118,7 +131,7 @@ bool RandomDequeueQueue<T>::dequeue(T *item) {
         if (retries >= max_retries_) {
           random_index = 0;
         } else {
-          random_index = pseudorand() % quasi_factor_;
+          random_index = scal::rand_range(0, quasi_factor_);
         }
         retries++;
 
@@ -126,7 +139,13 @@ bool RandomDequeueQueue<T>::dequeue(T *item) {
         if (random_index == 0) {
           while (node != NULL && node->deleted == true) {
             AtomicPointer<Node*> head_new(node, head_old.aba() + 1);
-            if (!head_->cas(head_old, head_new) || node == tail_old.value()) {
+            if (!head_->cas(head_old, head_new)) {
+              goto TOP_WHILE;
+            }
+            if (pool_ != NULL) {
+              pool_->retire(head_old.value());
+            }
+            if (node == tail_old.value()) {
               goto TOP_WHILE;
             }
             head_old = head_new;
@@ -34,7 +34,8 @@ class SingleList : public Queue<T> {
 
 template<typename T>
 SingleList<T>::SingleList() {
-  Node<T> *n = scal::get<Node<T> >(0);
+  // Dequeued sentinels are freed through tlfree.
+  Node<T> *n = scal::tlget<Node<T> >(0);
   head_ = n;
   tail_ = n;
 }
@@ -63,8 +64,10 @@ bool SingleList<T>::dequeue(T *item) {
     *item = (T)NULL;
     return false;
   } else {
+    Node<T> *head_old = head_;
     *item = head_->next->value;
     head_ = head_->next;
+    scal::tlfree(head_old, sizeof(Node<T>));
     return true;
   }
 }
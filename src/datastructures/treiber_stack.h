@@ -13,8 +13,11 @@
 #include "datastructures/distributed_queue_interface.h"
 #include "datastructures/stack.h"
 #include "util/atomic_value.h"
+#include "util/epoch.h"
+#include "util/hazard_pointers.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/reclamation.h"
 
 namespace ts_internal {
 
@@ -49,16 +52,22 @@ class TreiberStack : public Stack<T> {
   typedef ts_internal::Node<T> Node;
 
   AtomicPointer<Node*> *top_;
+  // Popped nodes for reuse, NULL if reclamation is disabled.
+  scal::Reclaimer<Node> *pool_;
 };
 
 template<typename T>
 TreiberStack<T>::TreiberStack() {
+  pool_ = scal::Reclaimer<Node>::create();
   top_ = scal::get<AtomicPointer<Node*> >(scal::kCachePrefetch);
 }
 
 template<typename T>
 bool TreiberStack<T>::push(T item) {
-  Node *n = scal::tlget<Node>(0);
+  Node *n = (pool_ != NULL) ? pool_->get() : NULL;
+  if (n == NULL) {
+    n = scal::tlget<Node>(0);
+  }
   n->data = item;
   AtomicPointer<Node*> top_old;
   AtomicPointer<Node*> top_new;
@@ -73,34 +82,46 @@ bool TreiberStack<T>::push(T item) {
 
 template<typename T>
 bool TreiberStack<T>::pop(T *item) {
+  scal::EpochGuard guard;
   AtomicPointer<Node*> top_old;
   AtomicPointer<Node*> top_new;
   do {
-    top_old = *top_;
-    if (top_old.value() == NULL) {
-      return false;
-    }
+    do {
+      top_old = *top_;
+      if (top_old.value() == NULL) {
+        return false;
+      }
+    } while (!scal::HazardPointers::protect(0, top_old, top_));
     top_new.weak_set_value(top_old.value()->next.value());
     top_new.weak_set_aba(top_old.aba() + 1);
   } while (!top_->cas(top_old, top_new));
   *item = top_old.value()->data;
+  if (pool_ != NULL) {
+    pool_->retire(top_old.value());
+  }
   return true;
 }
 
 template<typename T>
 inline bool TreiberStack<T>::get_return_empty_state(T *item, AtomicRaw *state) {
+  scal::EpochGuard guard;
   AtomicPointer<Node*> top_old;
   AtomicPointer<Node*> top_new;
   do {
-    top_old = *top_;
-    if (top_old.value() == NULL) {
-      *state = top_old.raw();
-      return false;
-    }
+    do {
+      top_old = *top_;
+      if (top_old.value() == NULL) {
+        *state = top_old.raw();
+        return false;
+      }
+    } while (!scal::HazardPointers::protect(0, top_old, top_));
     top_new.weak_set_value(top_old.value()->next.value());
     top_new.weak_set_aba(top_old.aba() + 1);
   } while (!top_->cas(top_old, top_new));
   *item = top_old.value()->data;
+  if (pool_ != NULL) {
+    pool_->retire(top_old.value());
+  }
   *state = top_old.raw();
   return true;
 }
@@ -33,14 +33,15 @@ class TSDeque : public Pool<T> {
       buffer_->initialize(num_threads, timestamping_);
     }
 
-    char* ds_get_stats(void) {
-      return buffer_->ds_get_stats();
+    // Sets the counters of the buffer, returns false if it has none.
+    bool ds_get_stats(uint64_t *c1, uint64_t *c2) {
+      return buffer_->ds_get_stats(c1, c2);
     }
 
     bool put(T element) {
       // Randomly insert an element either at the left or the right side
       // of the deque.
-      if ((hwrand() % 2) == 0) {
+      if (scal::rand_range(0, 2) == 0) {
         return insert_left(element);
       }
       return insert_right(element);
@@ -49,7 +50,7 @@ class TSDeque : public Pool<T> {
     bool get(T *element) {
       // Randomly remove an element either at the left or the right side
       // of the deque.
-      if ((hwrand() % 2) == 0) {
+      if (scal::rand_range(0, 2) == 0) {
         return remove_left(element);
       }
       return remove_right(element);
@@ -15,6 +15,7 @@
 #include "util/random.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/thread_array.h"
 
 template<typename T, typename TimeStamp>
 class TSDequeBuffer { 
@@ -31,14 +32,22 @@ class TSDequeBuffer {
       std::atomic<int64_t> index;
     } Item;
 
-    // The number of threads.
-    uint64_t num_threads_;
-    std::atomic<Item*> **left_;
-    std::atomic<Item*> **right_;
-    int64_t **next_index_;
+    // The left and right pointers of a thread-local list, in different
+    // cache lines.
+    typedef struct Buffer {
+      std::atomic<Item*> left;
+      uint8_t padding1[scal::kCachePrefetch * 4 - sizeof(std::atomic<Item*>)];
+      std::atomic<Item*> right;
+      uint8_t padding2[scal::kCachePrefetch * 4 - sizeof(std::atomic<Item*>)];
+      int64_t next_index;
+    } Buffer;
+
+    // Buffers and emptiness checks are kept per thread id and created on
+    // first use, so threads may come and go.
+    scal::ThreadArray<std::atomic<Buffer*> > buffers_;
     // The pointers for the emptiness check.
-    Item** *emptiness_check_left_;
-    Item** *emptiness_check_right_;
+    scal::ThreadArray<scal::ThreadArray<Item*>*> emptiness_check_left_;
+    scal::ThreadArray<scal::ThreadArray<Item*>*> emptiness_check_right_;
     TimeStamp *timestamping_;
 
     // Helper function to remove the ABA counter from a pointer.
@@ -60,17 +69,17 @@ class TSDequeBuffer {
     }
 
     // Returns the leftmost not-taken item from the thread-local list 
-    // indicated by thread_id.
-    Item* get_left_item(uint64_t thread_id) {
+    // buffer.
+    Item* get_left_item(Buffer *buffer) {
 
       // Read the item pointed to by the right pointer. The iteration through
       // the linked list can stop at that item.
-      Item* old_right = right_[thread_id]->load();
+      Item* old_right = buffer->right.load();
       Item* right = (Item*)get_aba_free_pointer(old_right);
       int64_t threshold = right->index.load();
 
       // Read the leftmost item.
-      Item* result = (Item*)get_aba_free_pointer(left_[thread_id]->load());
+      Item* result = (Item*)get_aba_free_pointer(buffer->left.load());
 
       // We start at the left pointer and iterate to the right until we
       // find the first item which has not been taken yet.
@@ -95,16 +104,16 @@ class TSDequeBuffer {
     }
 
     // Returns the rightmost not-taken item from the thread-local list
-    // indicated by thread_id.
-    Item* get_right_item(uint64_t thread_id) {
+    // buffer.
+    Item* get_right_item(Buffer *buffer) {
 
       // Read the item pointed to by the left pointer. The iteration through
       // the linked list can stop at that item.
-      Item* old_left = left_[thread_id]->load();
+      Item* old_left = buffer->left.load();
       Item* left = (Item*)get_aba_free_pointer(old_left);
       int64_t threshold = left->index.load();
 
-      Item* result = (Item*)get_aba_free_pointer(right_[thread_id]->load());
+      Item* result = (Item*)get_aba_free_pointer(buffer->right.load());
 
       // We start at the right pointer and iterate to the left until we
       // find the first item which has not been taken yet.
@@ -128,72 +137,59 @@ class TSDequeBuffer {
       }
     }
 
-  public:
-
-    void initialize(uint64_t num_threads, TimeStamp *timestamping) {
-
-      num_threads_ = num_threads;
-      timestamping_ = timestamping;
-
-      left_ = static_cast<std::atomic<Item*>**>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<Item*>*), 
-            scal::kCachePrefetch * 4));
-
-      right_ = static_cast<std::atomic<Item*>**>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<Item*>*), 
-            scal::kCachePrefetch * 4));
-
-      next_index_ = static_cast<int64_t**>(
-          scal::calloc_aligned(num_threads_, sizeof(int64_t*), 
-            scal::kCachePrefetch * 4));
-
-      emptiness_check_left_ = static_cast<Item***>(
-          scal::calloc_aligned(num_threads_, sizeof(Item**), 
-            scal::kCachePrefetch * 4));
-
-      emptiness_check_right_ = static_cast<Item***>(
-          scal::calloc_aligned(num_threads_, sizeof(Item**), 
-            scal::kCachePrefetch * 4));
-
-      for (int i = 0; i < num_threads_; i++) {
-
-        left_[i] = static_cast<std::atomic<Item*>*>(
-            scal::get<std::atomic<Item*>>(scal::kCachePrefetch * 4));
-
-        right_[i] = static_cast<std::atomic<Item*>*>(
-            scal::get<std::atomic<Item*>>(scal::kCachePrefetch * 4));
+    // Returns the buffer of thread_id, creating it on first use.
+    Buffer* get_buffer(uint64_t thread_id) {
+      Buffer *buffer = buffers_[thread_id].load();
+      if (buffer != NULL) {
+        return buffer;
+      }
+      buffer = scal::get<Buffer>(scal::kCachePrefetch * 4);
+      // Add a sentinal node.
+      Item *new_item = scal::get<Item>(scal::kCachePrefetch * 4);
+      timestamping_->init_sentinel_atomic(new_item->timestamp);
+      new_item->data.store(0);
+      new_item->taken.store(1);
+      new_item->left.store(new_item);
+      new_item->right.store(new_item);
+      new_item->index.store(0);
+      buffer->left.store(new_item);
+      buffer->right.store(new_item);
+      buffer->next_index = 1;
+      buffers_[thread_id].store(buffer);
+      return buffer;
+    }
 
-        next_index_[i] = static_cast<int64_t*>(
-            scal::get<int64_t>(scal::kCachePrefetch * 4));
+    // Returns the buffer with index i, or NULL if its thread has not
+    // inserted anything yet.
+    Buffer* find_buffer(uint64_t i) {
+      std::atomic<Buffer*> *entry = buffers_.find(i);
+      return (entry != NULL) ? entry->load() : NULL;
+    }
 
-        // Add a sentinal node.
-        Item *new_item = scal::get<Item>(scal::kCachePrefetch * 4);
-        timestamping_->init_sentinel_atomic(new_item->timestamp);
-        new_item->data.store(0);
-        new_item->taken.store(1);
-        new_item->left.store(new_item);
-        new_item->right.store(new_item);
-        new_item->index.store(0);
-        left_[i]->store(new_item);
-        right_[i]->store(new_item);
-        *next_index_[i] = 1;
+    // Returns the emptiness check pointers of thread_id in checks.
+    scal::ThreadArray<Item*>& emptiness_check(
+        scal::ThreadArray<scal::ThreadArray<Item*>*> &checks,
+        uint64_t thread_id) {
+      if (checks[thread_id] == NULL) {
+        checks[thread_id] = new scal::ThreadArray<Item*>();
+      }
+      return *checks[thread_id];
+    }
 
-        emptiness_check_left_[i] = static_cast<Item**> (
-            scal::calloc_aligned(num_threads_, sizeof(Item*), 
-              scal::kCachePrefetch * 4));
+  public:
 
-        emptiness_check_right_[i] = static_cast<Item**> (
-            scal::calloc_aligned(num_threads_, sizeof(Item*), 
-              scal::kCachePrefetch * 4));
-      }
+    // Threads register on their first insert, their number is not needed.
+    void initialize(uint64_t /* num_threads */, TimeStamp *timestamping) {
+      timestamping_ = timestamping;
     }
 
-    char* ds_get_stats(void) {
-      return NULL;
+    bool ds_get_stats(uint64_t *c1, uint64_t *c2) {
+      return false;
     }
 
     inline std::atomic<uint64_t> *insert_left(T element) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
+      Buffer *buffer = get_buffer(thread_id);
 
       // Create a new item.
       Item *new_item = scal::tlget_aligned<Item>(scal::kCachePrefetch);
@@ -205,11 +201,11 @@ class TSDequeBuffer {
       // order of items in the thread-local lists correspond with the
       // order of indices, and we can use the sign of the index to
       // determine on which side an item has been inserted.
-      new_item->index = -((*next_index_[thread_id])++);
+      new_item->index = -(buffer->next_index++);
 
       // Determine leftmost not-taken item in the list. The new item is
       // inserted to the left of that item.
-      Item* old_left = left_[thread_id]->load();
+      Item* old_left = buffer->left.load();
 
       Item* left = (Item*)get_aba_free_pointer(old_left);
       while (left->right.load() != left 
@@ -222,14 +218,14 @@ class TSDequeBuffer {
         // right pointer too to guarantee that a pending right-pointer
         // update of a remove operation does not make the left and the
         // right pointer point to different lists.
-        Item* old_right = right_[thread_id]->load();
-        right_[thread_id]->store((Item*) add_next_aba(left, old_right, 1));
+        Item* old_right = buffer->right.load();
+        buffer->right.store((Item*) add_next_aba(left, old_right, 1));
       }
 
       // Add the new item to the list.
       new_item->right.store(left);
       left->left.store(new_item);
-      left_[thread_id]->store(
+      buffer->left.store(
         (Item*) add_next_aba(new_item, old_left, 1));
  
       // Return a pointer to the timestamp location of the item so that a
@@ -242,6 +238,7 @@ class TSDequeBuffer {
     /////////////////////////////////////////////////////////////////
     inline std::atomic<uint64_t> *insert_right(T element) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
+      Buffer *buffer = get_buffer(thread_id);
 
       // Create a new item.
       Item *new_item = scal::tlget_aligned<Item>(scal::kCachePrefetch);
@@ -249,11 +246,11 @@ class TSDequeBuffer {
       new_item->data.store(element);
       new_item->taken.store(0);
       new_item->right.store(new_item);
-      new_item->index = (*next_index_[thread_id])++;
+      new_item->index = buffer->next_index++;
 
       // Determine the rightmost not-taken item in the list. The new item is
       // inserted to the right of that item.
-      Item* old_right = right_[thread_id]->load();
+      Item* old_right = buffer->right.load();
 
       Item* right = (Item*)get_aba_free_pointer(old_right);
       while (right->left.load() != right 
@@ -266,13 +263,13 @@ class TSDequeBuffer {
         // left pointer too to guarantee that a pending left-pointer
         // update of a remove operation does not make the left and the
         // right pointer point to different lists.
-        Item* old_left = left_[thread_id]->load();
-        left_[thread_id]->store( (Item*) add_next_aba(right, old_left, 1)); }
+        Item* old_left = buffer->left.load();
+        buffer->left.store( (Item*) add_next_aba(right, old_left, 1)); }
 
       // Add the new item to the list.
       new_item->left.store(right);
       right->right.store(new_item);
-      right_[thread_id]->store((Item*) add_next_aba(new_item, old_right, 1));
+      buffer->right.store((Item*) add_next_aba(new_item, old_right, 1));
 
       // Return a pointer to the timestamp location of the item so that a
       // timestamp can be added.
@@ -326,16 +323,16 @@ class TSDequeBuffer {
     bool try_remove_left(T *element, uint64_t *invocation_time) {
       // Initialize the data needed for the emptiness check.
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      Item* *emptiness_check_left = 
-        emptiness_check_left_[thread_id];
-      Item* *emptiness_check_right = 
-        emptiness_check_right_[thread_id];
+      scal::ThreadArray<Item*> &emptiness_check_left =
+        emptiness_check(emptiness_check_left_, thread_id);
+      scal::ThreadArray<Item*> &emptiness_check_right =
+        emptiness_check(emptiness_check_right_, thread_id);
       bool empty = true;
       // Initialize the result pointer to NULL, which means that no 
       // element has been removed.
       Item *result = NULL;
-      // Indicates the index which contains the youngest item.
-      uint64_t buffer_index = -1;
+      // The buffer which contains the youngest item.
+      Buffer *result_buffer = NULL;
       // Memory on the stack frame where timestamps of items can be stored
       // temporarily.
       uint64_t tmp_timestamp[2][2];
@@ -352,15 +349,20 @@ class TSDequeBuffer {
       uint64_t start_time[2];
       timestamping_->read_time(start_time);
       // We start iterating over the thread-local lists at a random index.
-      uint64_t start = hwrand();
+      uint64_t num_buffers = scal::ThreadContext::num_ids();
+      uint64_t start = scal::rand_range(0, num_buffers);
       // We iterate over all thead-local buffers
-      for (uint64_t i = 0; i < num_threads_; i++) {
+      for (uint64_t i = 0; i < num_buffers; i++) {
 
-        uint64_t tmp_buffer_index = (start + i) % num_threads_;
+        uint64_t tmp_buffer_index = (start + i) % num_buffers;
+        Buffer *buffer = find_buffer(tmp_buffer_index);
+        if (buffer == NULL) {
+          continue;
+        }
         // We get the remove/insert pointer of the current thread-local buffer.
-        Item* tmp_left = left_[tmp_buffer_index]->load();
+        Item* tmp_left = buffer->left.load();
         // We get the youngest element from that thread-local buffer.
-        Item* item = get_left_item(tmp_buffer_index);
+        Item* item = get_left_item(buffer);
         // If we found an element, we compare it to the youngest element 
         // we have found until now.
         if (item != NULL) {
@@ -372,7 +374,7 @@ class TSDequeBuffer {
           if (result == NULL || is_more_left(item, item_timestamp, result, timestamp)) {
             // We found a new leftmost item, so we remember it.
             result = item;
-            buffer_index = tmp_buffer_index;
+            result_buffer = buffer;
             timestamp = item_timestamp;
             tmp_index ^=1;
             old_left = tmp_left;
@@ -385,7 +387,7 @@ class TSDequeBuffer {
                     expected, 1)) {
                   // Try to adjust the remove pointer. It does not matter if 
                   // this CAS fails.
-                  left_[buffer_index]->compare_exchange_weak(
+                  result_buffer->left.compare_exchange_weak(
                       old_left, (Item*)add_next_aba(result, old_left, 0));
 
                   *element = result->data.load();
@@ -402,7 +404,7 @@ class TSDequeBuffer {
             emptiness_check_left[tmp_buffer_index] = 
               tmp_left;
           }
-          Item* tmp_right = right_[tmp_buffer_index]->load();
+          Item* tmp_right = buffer->right.load();
           if (emptiness_check_right[tmp_buffer_index] 
               != tmp_right) {
             empty = false;
@@ -421,7 +423,7 @@ class TSDequeBuffer {
                     expected, 1)) {
               // Try to adjust the remove pointer. It does not matter if this 
               // CAS fails.
-              left_[buffer_index]->compare_exchange_weak(
+              result_buffer->left.compare_exchange_weak(
                   old_left, (Item*)add_next_aba(result, old_left, 0));
               *element = result->data.load();
               return true;
@@ -437,16 +439,16 @@ class TSDequeBuffer {
     bool try_remove_right(T *element, uint64_t *invocation_time) {
       // Initialize the data needed for the emptiness check.
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      Item* *emptiness_check_left = 
-        emptiness_check_left_[thread_id];
-      Item* *emptiness_check_right = 
-        emptiness_check_right_[thread_id];
+      scal::ThreadArray<Item*> &emptiness_check_left =
+        emptiness_check(emptiness_check_left_, thread_id);
+      scal::ThreadArray<Item*> &emptiness_check_right =
+        emptiness_check(emptiness_check_right_, thread_id);
       bool empty = true;
       // Initialize the result pointer to NULL, which means that no 
       // element has been removed.
       Item *result = NULL;
-      // Indicates the index which contains the youngest item.
-      uint64_t buffer_index = -1;
+      // The buffer which contains the youngest item.
+      Buffer *result_buffer = NULL;
       // Memory on the stack frame where timestamps of items can be stored
       // temporarily.
       uint64_t tmp_timestamp[2][2];
@@ -463,15 +465,20 @@ class TSDequeBuffer {
       uint64_t start_time[2];
       timestamping_->read_time(start_time);
       // We start iterating over the thread-local lists at a random index.
-      uint64_t start = hwrand();
+      uint64_t num_buffers = scal::ThreadContext::num_ids();
+      uint64_t start = scal::rand_range(0, num_buffers);
       // We iterate over all thead-local buffers
-      for (uint64_t i = 0; i < num_threads_; i++) {
+      for (uint64_t i = 0; i < num_buffers; i++) {
 
-        uint64_t tmp_buffer_index = (start + i) % num_threads_;
+        uint64_t tmp_buffer_index = (start + i) % num_buffers;
+        Buffer *buffer = find_buffer(tmp_buffer_index);
+        if (buffer == NULL) {
+          continue;
+        }
         // We get the remove/insert pointer of the current thread-local buffer.
-        Item* tmp_right = right_[tmp_buffer_index]->load();
+        Item* tmp_right = buffer->right.load();
         // We get the youngest element from that thread-local buffer.
-        Item* item = get_right_item(tmp_buffer_index);
+        Item* item = get_right_item(buffer);
         // If we found an element, we compare it to the youngest element 
         // we have found until now.
         if (item != NULL) {
@@ -483,7 +490,7 @@ class TSDequeBuffer {
           if (result == NULL || is_more_right(item, item_timestamp, result, timestamp)) {
             // We found a new youngest element, so we remember it.
             result = item;
-            buffer_index = tmp_buffer_index;
+            result_buffer = buffer;
             timestamp = item_timestamp;
             tmp_index ^=1;
             old_right = tmp_right;
@@ -497,7 +504,7 @@ class TSDequeBuffer {
 
                   // Try to adjust the remove pointer. It does not matter if 
                   // this CAS fails.
-                  right_[buffer_index]->compare_exchange_weak(
+                  result_buffer->right.compare_exchange_weak(
                       old_right, (Item*)add_next_aba(result, old_right, 0));
 
                   *element = result->data.load();
@@ -514,7 +521,7 @@ class TSDequeBuffer {
             emptiness_check_right[tmp_buffer_index] = 
               tmp_right;
           }
-          Item* tmp_left = left_[tmp_buffer_index]->load();
+          Item* tmp_left = buffer->left.load();
           if (emptiness_check_left[tmp_buffer_index] 
               != tmp_left) {
             empty = false;
@@ -533,7 +540,7 @@ class TSDequeBuffer {
                     expected, 1)) {
               // Try to adjust the remove pointer. It does not matter if
               // this CAS fails.
-              right_[buffer_index]->compare_exchange_weak(
+              result_buffer->right.compare_exchange_weak(
                   old_right, (Item*)add_next_aba(result, old_right, 0));
               *element = result->data.load();
               return true;
@@ -17,6 +17,7 @@
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
+#include "util/thread_array.h"
 
 template<typename T, typename TimeStamp>
 class TSQueueBuffer {
@@ -27,11 +28,19 @@ class TSQueueBuffer {
       std::atomic<uint64_t> timestamp[2];
     } Item;
 
-    uint64_t num_threads_;
+    // The insert and remove pointers of a thread-local list, in different
+    // cache lines.
+    typedef struct Buffer {
+      std::atomic<Item*> insert;
+      uint8_t padding[scal::kCachePrefetch * 4 - sizeof(std::atomic<Item*>)];
+      std::atomic<Item*> remove;
+    } Buffer;
+
     TimeStamp *timestamping_;
-    std::atomic<Item*> **insert_;
-    std::atomic<Item*> **remove_;
-    Item** *emptiness_check_pointers_;
+    // Buffers and emptiness checks are kept per thread id and created on
+    // first use, so threads may come and go.
+    scal::ThreadArray<std::atomic<Buffer*> > buffers_;
+    scal::ThreadArray<scal::ThreadArray<Item*>*> emptiness_check_pointers_;
 
     // Helper function to remove the ABA counter from a pointer.
     inline void *get_aba_free_pointer(void *pointer) {
@@ -51,76 +60,27 @@ class TSQueueBuffer {
       return (void*)((result & 0xffffffffffffff8) | aba);
     }
 
-  public:
-    void initialize(uint64_t num_threads, TimeStamp *timestamping) {
+    Buffer* register_thread(uint64_t thread_id) {
+      Buffer *buffer = scal::get<Buffer>(scal::kCachePrefetch * 4);
+      // Add a sentinal node.
+      Item *new_item = scal::get<Item>(scal::kCachePrefetch * 4);
+      timestamping_->init_sentinel_atomic(new_item->timestamp);
+      new_item->data.store(0);
+      new_item->next.store(NULL);
+      buffer->insert.store(new_item);
+      buffer->remove.store(new_item);
+      buffers_[thread_id].store(buffer);
+      return buffer;
+    }
 
-      num_threads_ = num_threads;
+  public:
+    // Threads register on their first insert, their number is not needed.
+    void initialize(uint64_t /* num_threads */, TimeStamp *timestamping) {
       timestamping_ = timestamping;
-
-      insert_ = static_cast<std::atomic<Item*>**>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<Item*>*), 
-            scal::kCachePrefetch * 4));
-
-      remove_ = static_cast<std::atomic<Item*>**>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<Item*>*), 
-            scal::kCachePrefetch * 4));
-
-      emptiness_check_pointers_ = static_cast<Item***>(
-          scal::calloc_aligned(num_threads_, sizeof(Item**), 
-            scal::kCachePrefetch * 4));
-
-      for (int i = 0; i < num_threads_; i++) {
-
-        insert_[i] = static_cast<std::atomic<Item*>*>(
-            scal::get<std::atomic<Item*>>(scal::kCachePrefetch * 4));
-
-        remove_[i] = static_cast<std::atomic<Item*>*>(
-            scal::get<std::atomic<Item*>>(scal::kCachePrefetch * 4));
-
-        // Add a sentinal node.
-        Item *new_item = scal::get<Item>(scal::kCachePrefetch * 4);
-        timestamping_->init_sentinel_atomic(new_item->timestamp);
-        new_item->data.store(0);
-        new_item->next.store(NULL);
-        insert_[i]->store(new_item);
-        remove_[i]->store(new_item);
-
-        emptiness_check_pointers_[i] = static_cast<Item**> (
-            scal::calloc_aligned(num_threads_, sizeof(Item*), 
-              scal::kCachePrefetch * 4));
-      }
     }
 
-    char* ds_get_stats(void) {
-
-      return NULL;
-      // We do not print any DS stats at the moment.
-      uint64_t sum1 = 0;
-      uint64_t sum2 = 1;
-
-      for (int i = 0; i < num_threads_; i++) {
-//        sum1 += *counter1_[i];
-//        sum2 += *counter2_[i];
-      }
-
-      double avg1 = sum1;
-      avg1 /= (double)40000000.0;
-
-      double avg2 = sum2;
-      avg2 /= (double)40000000.0;
-
-      char buffer[255] = { 0 };
-      uint32_t n = snprintf(buffer,
-                            sizeof(buffer),
-                            ";c1: %.2f ;c2: %.2f",
-                            avg1, avg2);
-      if (n != strlen(buffer)) {
-        fprintf(stderr, "%s: error creating stats string\n", __func__);
-        abort();
-      }
-      char *newbuf = static_cast<char*>(calloc(
-          strlen(buffer) + 1, sizeof(*newbuf)));
-      return strncpy(newbuf, buffer, strlen(buffer));
+    bool ds_get_stats(uint64_t *c1, uint64_t *c2) {
+      return false;
     }
 
     inline std::atomic<uint64_t> *insert_left(T element) {
@@ -132,10 +92,15 @@ class TSQueueBuffer {
       new_item->data.store(element);
       new_item->next.store(NULL);
 
+      Buffer *buffer = buffers_[thread_id].load();
+      if (buffer == NULL) {
+        buffer = register_thread(thread_id);
+      }
+
       // Add the item to the thread-local list.
-      Item* old_insert = insert_[thread_id]->load();
+      Item* old_insert = buffer->insert.load();
       old_insert->next.store(new_item);
-      insert_[thread_id]->store(new_item);
+      buffer->insert.store(new_item);
 
       //Return a pointer to the timestamp location of the item so that
       // a timestamp can be assigned.
@@ -151,14 +116,18 @@ class TSQueueBuffer {
     bool try_remove_right(T *element, uint64_t *invocation_time) {
       // Initialize the data needed for the emptiness check.
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      Item* *emptiness_check_pointers = 
-        emptiness_check_pointers_[thread_id];
+      if (emptiness_check_pointers_[thread_id] == NULL) {
+        emptiness_check_pointers_[thread_id] =
+            new scal::ThreadArray<Item*>();
+      }
+      scal::ThreadArray<Item*> &emptiness_check_pointers =
+        *emptiness_check_pointers_[thread_id];
       bool empty = true;
       // Initialize the result pointer to NULL, which means that no 
       // element has been removed.
       Item *result = NULL;
-      // Indicates the index of the buffer which contains the oldest item.
-      uint64_t buffer_index = -1;
+      // The buffer which contains the oldest item.
+      Buffer *result_buffer = NULL;
       // Memory on the stack frame where timestamps of items can be stored
       // temporarily.
       uint64_t tmp_timestamp[2][2];
@@ -177,16 +146,23 @@ class TSQueueBuffer {
       uint64_t start_time[2];
       timestamping_->read_time(start_time);
       // We start iterating of the thread-local lists at a random index.
-      uint64_t start = hwrand();
+      uint64_t num_buffers = scal::ThreadContext::num_ids();
+      uint64_t start = scal::rand_range(0, num_buffers);
       // We iterate over all thead-local buffers
-      for (uint64_t i = 0; i < num_threads_; i++) {
-
-        uint64_t tmp_buffer_index = (start + i) % num_threads_;
+      for (uint64_t i = 0; i < num_buffers; i++) {
+
+        uint64_t tmp_buffer_index = (start + i) % num_buffers;
+        std::atomic<Buffer*> *entry = buffers_.find(tmp_buffer_index);
+        Buffer *buffer = (entry != NULL) ? entry->load() : NULL;
+        if (buffer == NULL) {
+          // The thread has not inserted anything yet.
+          continue;
+        }
 
         // We get the remove/insert pointer of the current thread-local 
         // buffer.
-        Item* tmp_remove = remove_[tmp_buffer_index]->load();
-        Item* tmp_insert = insert_[tmp_buffer_index]->load();
+        Item* tmp_remove = buffer->remove.load();
+        Item* tmp_insert = buffer->insert.load();
         Item* item = 
           ((Item*)get_aba_free_pointer(tmp_remove))->next.load();
         // We get the oldest element from that thread-local buffer.
@@ -202,7 +178,7 @@ class TSQueueBuffer {
           if (timestamping_->is_later(timestamp, item_timestamp)) {
             // We found a new oldest element, so we remember it.
             result = item;
-            buffer_index = tmp_buffer_index;
+            result_buffer = buffer;
             timestamp = item_timestamp;
             tmp_index ^=1;
             old_remove = tmp_remove;
@@ -219,8 +195,8 @@ class TSQueueBuffer {
       }
       if (result != NULL) {
         if (!timestamping_->is_later(timestamp, start_time)) {
-          if (remove_[buffer_index]->load() == old_remove) {
-            if (remove_[buffer_index]->compare_exchange_weak(
+          if (result_buffer->remove.load() == old_remove) {
+            if (result_buffer->remove.compare_exchange_weak(
                   old_remove, (Item*)add_next_aba(result, old_remove, 1))) {
               *element = result->data.load();
               return true;
@@ -32,8 +32,9 @@ class TSStack : public Stack<T> {
       buffer_->initialize(num_threads, timestamping_);
     }
 
-    char* ds_get_stats(void) {
-      return buffer_->ds_get_stats();
+    // Sets the counters of the buffer, returns false if it has none.
+    bool ds_get_stats(uint64_t *c1, uint64_t *c2) {
+      return buffer_->ds_get_stats(c1, c2);
     }
 
     inline bool push(T element) {
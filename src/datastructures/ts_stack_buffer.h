@@ -16,6 +16,7 @@
 #include "util/random.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/thread_array.h"
 #include "util/time.h"
 
 template<typename T, typename Timestamp>
@@ -34,15 +35,15 @@ class TSStackBuffer {
       int64_t index;
     } SPBuffer;
 
-    uint64_t num_threads_;
-
     std::atomic<uint64_t> unlink_lock;
-    std::atomic<SPBuffer*> *spBuffers_;
+    // Buffers and emptiness checks are kept per thread id and created on
+    // first use, so threads may come and go.
+    scal::ThreadArray<std::atomic<SPBuffer*> > spBuffers_;
     std::atomic<SPBuffer*> entry_buffer_;
-    Item** *emptiness_check_pointers_;
+    scal::ThreadArray<scal::ThreadArray<Item*>*> emptiness_check_pointers_;
     Timestamp *timestamping_;
-    uint64_t* *counter1_;
-    uint64_t* *counter2_;
+    scal::ThreadArray<uint64_t> counter1_;
+    scal::ThreadArray<uint64_t> counter2_;
 
     // Helper function to remove the ABA counter from a pointer. 
     inline void *get_aba_free_pointer(void *pointer) {
@@ -149,28 +150,12 @@ class TSStackBuffer {
 
   public:
 
-    void initialize(uint64_t num_threads, Timestamp *timestamping) {
+    // Threads register on their first insert, their number is not needed.
+    void initialize(uint64_t /* num_threads */, Timestamp *timestamping) {
 
       unlink_lock.store(0);
-      num_threads_ = num_threads;
       timestamping_ = timestamping; 
 
-      spBuffers_ = static_cast<std::atomic<SPBuffer*>*>(
-          scal::calloc_aligned(num_threads_, sizeof(std::atomic<SPBuffer*>), 
-            scal::kCachePrefetch * 4));
-
-      emptiness_check_pointers_ = static_cast<Item***>(
-          scal::calloc_aligned(num_threads_, sizeof(Item**), 
-            scal::kCachePrefetch * 4));
-
-       for (int i = 0; i < num_threads_; i++) {
-         spBuffers_[i].store(NULL); 
-
-        emptiness_check_pointers_[i] = static_cast<Item**> (
-            scal::calloc_aligned(num_threads_, sizeof(Item*), 
-              scal::kCachePrefetch * 4));
-      }
-
       // Create the entry buffer.
       SPBuffer* buffer = scal::tlget_aligned<SPBuffer>(scal::kCachePrefetch);
       buffer->next.store(buffer);
@@ -187,54 +172,30 @@ class TSStackBuffer {
       buffer->list->store(new_item);
       buffer->index = -1;
       entry_buffer_.store(buffer);
-
-      counter1_ = static_cast<uint64_t**>(
-          scal::calloc_aligned(num_threads, sizeof(uint64_t*),
-            scal::kCachePrefetch * 4));
-      counter2_ = static_cast<uint64_t**>(
-          scal::calloc_aligned(num_threads, sizeof(uint64_t*),
-            scal::kCachePrefetch * 4));
-
-      for (uint64_t i = 0; i < num_threads; i++) {
-        counter1_[i] = scal::get<uint64_t>(scal::kCachePrefetch * 4);
-        *(counter1_[i]) = 0;
-        counter2_[i] = scal::get<uint64_t>(scal::kCachePrefetch * 4);
-        *(counter2_[i]) = 0;
-      }
     }
 
     inline void inc_counter1(uint64_t value) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      (*counter1_[thread_id]) += value;
+      counter1_[thread_id] += value;
     }
     
     inline void inc_counter2(uint64_t value) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      (*counter2_[thread_id]) += value;
+      counter2_[thread_id] += value;
     }
     
-    char* ds_get_stats(void) {
-
-      uint64_t sum1 = 0;
-      uint64_t sum2 = 1;
-
-      for (int i = 0; i < num_threads_; i++) {
-        sum1 += *counter1_[i];
-        sum2 += *counter2_[i];
-      }
-
-      char buffer[255] = { 0 };
-      uint32_t n = snprintf(buffer,
-                            sizeof(buffer),
-                            ";c1: %lu ;c2: %lu",
-                            sum1, sum2);
-      if (n != strlen(buffer)) {
-        fprintf(stderr, "%s: error creating stats string\n", __func__);
-        abort();
+    bool ds_get_stats(uint64_t *c1, uint64_t *c2) {
+      *c1 = 0;
+      *c2 = 0;
+      for (uint64_t i = 0; i < scal::ThreadContext::num_ids(); i++) {
+        if (counter1_.find(i) != NULL) {
+          *c1 += *counter1_.find(i);
+        }
+        if (counter2_.find(i) != NULL) {
+          *c2 += *counter2_.find(i);
+        }
       }
-      char *newbuf = static_cast<char*>(calloc(
-          strlen(buffer) + 1, sizeof(*newbuf)));
-      return strncpy(newbuf, buffer, strlen(buffer));
+      return true;
     }
 
     inline std::atomic<uint64_t> *insert_right(T element) {
@@ -328,8 +289,12 @@ class TSStackBuffer {
 //      inc_counter2(1);
       // Initialize the data needed for the emptiness check.
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      Item* *emptiness_check_pointers = 
-        emptiness_check_pointers_[thread_id];
+      if (emptiness_check_pointers_[thread_id] == NULL) {
+        emptiness_check_pointers_[thread_id] =
+            new scal::ThreadArray<Item*>();
+      }
+      scal::ThreadArray<Item*> &emptiness_check_pointers =
+        *emptiness_check_pointers_[thread_id];
       bool empty = true;
       // Initialize the result pointer to NULL, which means that no 
       // element has been found yet.
@@ -350,7 +315,7 @@ class TSStackBuffer {
       Item* old_top = NULL;
 
       // We start iterating over the thread-local lists at a random index.
-      uint64_t start = hwrand() % num_threads_;
+      uint64_t start = scal::rand_range(0, scal::ThreadContext::num_ids());
       SPBuffer* current_buffer;
       SPBuffer* youngest_buffer;
       current_buffer = entry_buffer_.load();
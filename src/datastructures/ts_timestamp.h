@@ -11,6 +11,7 @@
 #include "util/time.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/thread_array.h"
 
 
 //////////////////////////////////////////////////////////////////////
@@ -242,10 +243,14 @@ class AtomicCounterTimestamp {
 //////////////////////////////////////////////////////////////////////
 class StutteringTimestamp {
   private:
-    // An array of thread-local clocks.
-    std::atomic<uint64_t>* *clocks_;
-    // The number of threads.
-    uint64_t num_threads_;
+    typedef struct Clock {
+      std::atomic<uint64_t> time;
+      uint8_t padding[scal::kCachePrefetch - sizeof(std::atomic<uint64_t>)];
+    } Clock;
+
+    // Thread-local clocks, kept per thread id and created on first use. A
+    // clock of 0 has not been set yet.
+    scal::ThreadArray<Clock> clocks_;
 
     // Returns the maximum of x and y.
     inline uint64_t max(uint64_t x, uint64_t y) {
@@ -256,17 +261,21 @@ class StutteringTimestamp {
     }
 
   public:
+    // Threads register on their first timestamp, their number is not
+    // needed.
     inline void initialize(uint64_t delay, uint64_t num_threads) {
-      num_threads_ = num_threads;
-      clocks_ = static_cast<std::atomic<uint64_t>**>(
-          scal::calloc_aligned(num_threads_, 
-            sizeof(std::atomic<uint64_t>*), scal::kCachePrefetch));
-
-      for (int i = 0; i < num_threads_; i++) {
-        clocks_[i] = 
-          scal::get<std::atomic<uint64_t>>(scal::kCachePrefetch);
-        clocks_[i]->store(1);
+    }
+
+    // Returns the latest of all thread-local times.
+    inline uint64_t latest_time(void) {
+      uint64_t latest_time = 0;
+      for (uint64_t i = 0; i < scal::ThreadContext::num_ids(); i++) {
+        Clock *clock = clocks_.find(i);
+        if (clock != NULL) {
+          latest_time = max(latest_time, clock->time.load());
+        }
       }
+      return latest_time;
     }
 
     inline void init_sentinel(uint64_t *result) {
@@ -291,29 +300,17 @@ class StutteringTimestamp {
 
     inline void set_timestamp(std::atomic<uint64_t> *result) {
       uint64_t thread_id = scal::ThreadContext::get().thread_id();
-      uint64_t latest_time = 0;
-
-      // Find the latest of all thread-local times.
-      for (int i = 0; i < num_threads_; i++) {
-        latest_time = max(latest_time, clocks_[i]->load());
-      }
+      uint64_t latest_time = this->latest_time();
 
       // Set the thread-local time to the latest found time + 1.
-      clocks_[thread_id]->store(latest_time + 1);
+      clocks_[thread_id].time.store(latest_time + 1);
       // Return the current local time.
       result[0].store(latest_time + 1);
     }
 
     inline void read_time(uint64_t *result) {
-      uint64_t latest_time = 0;
-
-      // Find the latest of all thread-local times.
-      for (int i = 0; i < num_threads_; i++) {
-        latest_time = max(latest_time, clocks_[i]->load());
-      }
-
       // Return the current local time.
-      result[0] = latest_time;
+      result[0] = latest_time();
     }
 
     // Compares two timestamps, returns true if timestamp1 is later than
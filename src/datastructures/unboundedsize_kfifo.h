@@ -17,6 +17,7 @@
 
 #include "datastructures/queue.h"
 #include "util/atomic_value.h"
+#include "util/epoch.h"
 #include "util/malloc.h"
 #include "util/platform.h"
 #include "util/random.h"
@@ -49,6 +50,9 @@ class UnboundedSizeKFifo : public Queue<T> {
   AtomicPointer<KSegment*> *head_;
   AtomicPointer<KSegment*> *tail_;
   uint64_t k_;
+  // Segments unlinked from the head for reuse, NULL if reclamation is
+  // disabled.
+  scal::EpochPool<KSegment> *pool_;
 
   inline KSegment* ksegment_new(void);
   void advance_head(AtomicPointer<KSegment*> head_old);
@@ -69,7 +73,15 @@ class UnboundedSizeKFifo : public Queue<T> {
 
 template<typename T>
 uskfifo_details::KSegment<T>* UnboundedSizeKFifo<T>::ksegment_new() {
-  KSegment *ksegment = static_cast<KSegment*>(scal::tlcalloc(
+  KSegment *ksegment = (pool_ != NULL) ? pool_->get() : NULL;
+  if (ksegment != NULL) {
+    // All items have been dequeued or withdrawn before the segment was
+    // unlinked, and keep their ABA counters.
+    ksegment->next.weak_set_value(NULL);
+    ksegment->deleted = false;
+    return ksegment;
+  }
+  ksegment = static_cast<KSegment*>(scal::tlcalloc(
       1, sizeof(KSegment)));
   ksegment->k = k_;
   ksegment->items = static_cast<AtomicValue<T>**>(scal::tlcalloc(
@@ -85,6 +97,13 @@ uskfifo_details::KSegment<T>* UnboundedSizeKFifo<T>::ksegment_new() {
 template<typename T>
 UnboundedSizeKFifo<T>::UnboundedSizeKFifo(uint64_t k) {
   k_ = k;
+  if (scal::Epoch::enabled()) {
+    // Items are reused with their segment.
+    pool_ = new scal::EpochPool<KSegment>(sizeof(KSegment) +
+        k_ * (sizeof(AtomicValue<T>*) + sizeof(AtomicValue<T>)));
+  } else {
+    pool_ = NULL;
+  }
   KSegment *ksegment = ksegment_new();
 
   head_ = scal::get<AtomicPointer<KSegment*> >(scal::kPageSize);
@@ -113,7 +132,9 @@ void UnboundedSizeKFifo<T>::advance_head(
       }
       head_old.value()->deleted = true;
       head_next_ksegment.set_aba(head_old.aba() + 1);
-      head_->cas(head_old, head_next_ksegment);
+      if (head_->cas(head_old, head_next_ksegment) && pool_ != NULL) {
+        pool_->retire(head_old.value());
+      }
     }
   }
 }
@@ -136,6 +157,8 @@ void UnboundedSizeKFifo<T>::advance_tail(
         if (tail_old.value()->next.cas(next_ksegment, new_ksegment)) {
           new_ksegment.set_aba(tail_old.aba() + 1);
           tail_->cas(tail_old, new_ksegment);
+        } else if (pool_ != NULL) {
+          pool_->retire(ksegment);
         }
       }
     }
@@ -146,17 +169,18 @@ template<typename T>
 void UnboundedSizeKFifo<T>::find_index(
     uskfifo_details::KSegment<T> *start_index, bool empty, int64_t *item_index,
     AtomicValue<T> *old) {
-  uint64_t random_index = pseudorand() % start_index->k;
-  uint64_t index;
+  uint64_t index = scal::rand_range(0, start_index->k);
   *item_index = kNoIndexFound;
   for (size_t i = 0; i < start_index->k; i++) {
-    index = ((random_index + i) % start_index->k);
     *old = *start_index->items[index];
     if ((empty && old->value() == (T)NULL)
         || (!empty && old->value() != (T)NULL)) {
       *item_index = index;
       return;
     }
+    if (++index == start_index->k) {
+      index = 0;
+    }
   }
 }
 
@@ -198,6 +222,7 @@ bool UnboundedSizeKFifo<T>::committed(
 
 template<typename T>
 bool UnboundedSizeKFifo<T>::dequeue(T *item) {
+  scal::EpochGuard guard;
   AtomicPointer<KSegment*> tail_old;
   AtomicPointer<KSegment*> head_old;
   int64_t item_index;
@@ -232,6 +257,7 @@ bool UnboundedSizeKFifo<T>::enqueue(T item) {
     printf("%s: unable to enqueue NULL or equivalent value\n", __func__);
     abort();
   }
+  scal::EpochGuard guard;
   AtomicPointer<KSegment*> tail_old;
   AtomicPointer<KSegment*> head_old;
   int64_t item_index;
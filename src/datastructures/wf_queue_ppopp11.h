@@ -17,8 +17,12 @@
 
 #include "datastructures/queue.h"
 #include "util/atomic_value.h"
+#include "util/epoch.h"
+#include "util/hazard_pointers.h"
 #include "util/malloc.h"
 #include "util/platform.h"
+#include "util/reclamation.h"
+#include "util/thread_array.h"
 #include "util/threadlocals.h"
 
 namespace wf_details {
@@ -83,7 +87,7 @@ struct OperationDescriptor {
 template<typename T>
 class WaitfreeQueue : public Queue<T> {
  public:
-  explicit WaitfreeQueue(uint64_t num_threads);
+  WaitfreeQueue();
   bool enqueue(T item);
   bool dequeue(T *item);
 
@@ -93,6 +97,23 @@ class WaitfreeQueue : public Queue<T> {
 
   static const uint64_t kPtrAlignment = scal::kCachePrefetch;
 
+  typedef volatile AtomicPointer<OperationDescriptor*> State;
+
+  // Whether thread |thread_id| has a state, i.e., has ever operated on the
+  // queue. Only those are helped.
+  inline bool has_state(uint64_t thread_id);
+  // Creates the state of the calling thread |thread_id| if needed.
+  inline void register_thread(uint64_t thread_id);
+  // Reads the state of |thread_id|. With hazard pointers, its descriptor is
+  // protected until the next call.
+  inline AtomicPointer<OperationDescriptor*> state(uint64_t thread_id);
+  inline OperationDescriptor* descriptor_new(void);
+  // Installs |new_desc| as the state of the calling thread |thread_id|.
+  inline void install(uint64_t thread_id, OperationDescriptor *new_desc);
+  // Installs |new_desc| if the state of |thread_id| is still |cur_state|.
+  inline bool replace(uint64_t thread_id,
+                      AtomicPointer<OperationDescriptor*> cur_state,
+                      OperationDescriptor *new_desc);
   int64_t max_phase(void);
   inline bool is_still_pending(uint64_t thread_id, int64_t phase);
   void help(int64_t phase);
@@ -101,15 +122,18 @@ class WaitfreeQueue : public Queue<T> {
   void help_finish_enqueue(void);
   void help_finish_dequeue(void);
 
-  uint64_t num_threads_;
   volatile AtomicPointer<Node*> *head_;
   volatile AtomicPointer<Node*> *tail_;
-  volatile AtomicPointer<OperationDescriptor*> **state_;
+  // Each thread gets its own OperationDescriptor on its first operation.
+  scal::ThreadArray<State*> state_;
+  // Replaced descriptors for reuse, NULL if reclamation is disabled. Nodes
+  // are not reclaimed.
+  scal::Reclaimer<OperationDescriptor> *pool_;
 };
 
 template<typename T>
-WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads) {
-  num_threads_ = num_threads;
+WaitfreeQueue<T>::WaitfreeQueue() {
+  pool_ = scal::Reclaimer<OperationDescriptor>::create();
 
   // Create sentinel node.
   Node *node = scal::get<Node>(kPtrAlignment);
@@ -120,27 +144,98 @@ WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads) {
   AtomicPointer<Node*> *tail = scal::get<AtomicPointer<Node*> >(kPtrAlignment);
   tail->weak_set_value(node);
   tail_ = const_cast<volatile AtomicPointer<Node*>*>(tail);
+}
 
-  // Each thread gets its own OperationDescriptor.
-  state_ = const_cast<volatile AtomicPointer<OperationDescriptor*>**>(
-      static_cast<AtomicPointer<OperationDescriptor*>**>(calloc(
-          num_threads_, sizeof(AtomicPointer<OperationDescriptor*>*))));
-  for (uint64_t i = 0; i < num_threads_; i++) {
-    OperationDescriptor *opdesc = scal::get<OperationDescriptor>(kPtrAlignment);
-    opdesc->init(OperationDescriptor::kNoPhase,
-                 false,
-                 OperationDescriptor::Type::kEnqueue,
-                 NULL);
-    state_[i] = scal::get<AtomicPointer<OperationDescriptor*> >(kPtrAlignment);
-    state_[i]->weak_set_value(opdesc);
+template<typename T>
+bool WaitfreeQueue<T>::has_state(uint64_t thread_id) {
+  State **state = state_.find(thread_id);
+  return (state != NULL) && (*state != NULL);
+}
+
+template<typename T>
+void WaitfreeQueue<T>::register_thread(uint64_t thread_id) {
+  if (state_[thread_id] != NULL) {
+    return;
+  }
+  OperationDescriptor *opdesc = scal::tlget<OperationDescriptor>(
+      kPtrAlignment);
+  opdesc->init(OperationDescriptor::kNoPhase,
+               false,
+               OperationDescriptor::Type::kEnqueue,
+               NULL);
+  AtomicPointer<OperationDescriptor*> *state =
+      scal::tlget<AtomicPointer<OperationDescriptor*> >(kPtrAlignment);
+  state->weak_set_value(opdesc);
+  // Helpers must not see the state before its descriptor.
+  __sync_synchronize();
+  state_[thread_id] = const_cast<State*>(state);
+}
+
+template<typename T>
+AtomicPointer<wf_details::OperationDescriptor<T>*> WaitfreeQueue<T>::state(
+    uint64_t thread_id) {
+  AtomicPointer<OperationDescriptor*> current;
+  do {
+    current = *state_[thread_id];
+  } while (!scal::HazardPointers::protect(0, current, state_[thread_id]));
+  return current;
+}
+
+template<typename T>
+wf_details::OperationDescriptor<T>* WaitfreeQueue<T>::descriptor_new(void) {
+  OperationDescriptor *desc = (pool_ != NULL) ? pool_->get() : NULL;
+  if (desc == NULL) {
+    desc = scal::tlget<OperationDescriptor>(kPtrAlignment);
+  }
+  return desc;
+}
+
+template<typename T>
+void WaitfreeQueue<T>::install(uint64_t thread_id,
+                               OperationDescriptor *new_desc) {
+  AtomicPointer<OperationDescriptor*> new_state(new_desc,
+                                                state_[thread_id]->aba() + 1);
+  if (pool_ == NULL) {
+    state_[thread_id]->set_raw(new_state.raw());
+    return;
   }
+  // A late helper may still replace the descriptor of the last operation,
+  // which then must not be retired twice.
+  AtomicPointer<OperationDescriptor*> cur_state;
+  do {
+    cur_state = *state_[thread_id];
+    new_state.weak_set_aba(cur_state.aba() + 1);
+  } while (!state_[thread_id]->cas(cur_state, new_state));
+  pool_->retire(cur_state.value());
+}
+
+template<typename T>
+bool WaitfreeQueue<T>::replace(uint64_t thread_id,
+                               AtomicPointer<OperationDescriptor*> cur_state,
+                               OperationDescriptor *new_desc) {
+  AtomicPointer<OperationDescriptor*> new_state(new_desc,
+                                                cur_state.aba() + 1);
+  if (state_[thread_id]->cas(cur_state, new_state)) {
+    if (pool_ != NULL) {
+      pool_->retire(cur_state.value());
+    }
+    return true;
+  }
+  if (pool_ != NULL) {
+    pool_->retire(new_desc);
+  }
+  return false;
 }
 
 template<typename T>
 int64_t WaitfreeQueue<T>::max_phase(void) {
   int64_t max_phase = OperationDescriptor::kNoPhase;
-  for (uint64_t i = 0; i < num_threads_; i++) {
-    int64_t phase = state_[i]->value()->phase;
+  const uint64_t num_ids = scal::ThreadContext::num_ids();
+  for (uint64_t i = 0; i < num_ids; i++) {
+    if (!has_state(i)) {
+      continue;
+    }
+    int64_t phase = state(i).value()->phase;
     if (phase > max_phase) {
       max_phase = phase;
     }
@@ -150,14 +245,18 @@ int64_t WaitfreeQueue<T>::max_phase(void) {
 
 template <typename T>
 bool WaitfreeQueue<T>::is_still_pending(uint64_t thread_id, int64_t phase) {
-  return state_[thread_id]->value()->pending &&
-         state_[thread_id]->value()->phase <= phase;
+  OperationDescriptor *desc = state(thread_id).value();
+  return desc->pending && desc->phase <= phase;
 }
 
 template<typename T>
 void WaitfreeQueue<T>::help(int64_t phase) {
-  for (uint64_t i = 0; i < num_threads_; i++) {
-    volatile OperationDescriptor *desc = state_[i]->value();
+  const uint64_t num_ids = scal::ThreadContext::num_ids();
+  for (uint64_t i = 0; i < num_ids; i++) {
+    if (!has_state(i)) {
+      continue;
+    }
+    volatile OperationDescriptor *desc = state(i).value();
     if (desc->pending && desc->phase <= phase) {
       switch (desc->type) {
       case OperationDescriptor::Type::kEnqueue:
@@ -174,15 +273,15 @@ void WaitfreeQueue<T>::help(int64_t phase) {
 template<typename T>
 bool WaitfreeQueue<T>::enqueue(T item) {
   assert(item != (T)NULL);
-  int64_t phase = max_phase() + 1;
+  scal::EpochGuard guard;
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  register_thread(thread_id);
+  int64_t phase = max_phase() + 1;
   Node *node = scal::tlget<Node>(kPtrAlignment);
   node->init(item, thread_id);
-  OperationDescriptor *opdesc = scal::tlget<OperationDescriptor>(kPtrAlignment);
+  OperationDescriptor *opdesc = descriptor_new();
   opdesc->init(phase, true, OperationDescriptor::Type::kEnqueue, node);
-  AtomicPointer<OperationDescriptor*> new_state(opdesc,
-                                                state_[thread_id]->aba() + 1);
-  state_[thread_id]->set_raw(new_state.raw());
+  install(thread_id, opdesc);
   help(phase);
   help_finish_enqueue();
   return true;
@@ -198,7 +297,7 @@ void WaitfreeQueue<T>::help_enqueue(uint64_t thread_id, int64_t phase) {
     if (tail_old.raw() == tail_->raw()) {
       if (next.value() == NULL) {
         if (is_still_pending(thread_id, phase)) {
-          AtomicPointer<Node*> new_next(state_[thread_id]->value()->node,
+          AtomicPointer<Node*> new_next(state(thread_id).value()->node,
                                         next.aba() + 1);
           if (tail_old.value()->next.cas(next, new_next)) {
             help_finish_enqueue();
@@ -218,16 +317,13 @@ void WaitfreeQueue<T>::help_finish_enqueue(void) {
   AtomicPointer<Node*> next = tail_old.value()->next;
   if (next.value() != NULL) {
     uint64_t thread_id = next.value()->enq_tid;
-    AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
+    AtomicPointer<OperationDescriptor*> cur_state = state(thread_id);
     if ((tail_old.raw() == tail_->raw())
-        && ((state_[thread_id]->value())->node == next.value())) {
-      OperationDescriptor *new_desc =
-          scal::tlget<OperationDescriptor>(kPtrAlignment);
-      new_desc->init(state_[thread_id]->value()->phase, false,
+        && (cur_state.value()->node == next.value())) {
+      OperationDescriptor *new_desc = descriptor_new();
+      new_desc->init(cur_state.value()->phase, false,
                      OperationDescriptor::Type::kEnqueue, next.value());
-      AtomicPointer<OperationDescriptor*> new_state(new_desc,
-                                                    cur_state.aba() + 1);
-      state_[thread_id]->cas(cur_state, new_state);
+      replace(thread_id, cur_state, new_desc);
       AtomicPointer<Node*> new_tail(next.value(), tail_old.aba() + 1);
       tail_->cas(tail_old, new_tail);
     }
@@ -236,16 +332,16 @@ void WaitfreeQueue<T>::help_finish_enqueue(void) {
 
 template<typename T>
 bool WaitfreeQueue<T>::dequeue(T *item) {
-  int64_t phase = max_phase() + 1;
+  scal::EpochGuard guard;
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
-  OperationDescriptor *opdesc = scal::tlget<OperationDescriptor>(kPtrAlignment);
+  register_thread(thread_id);
+  int64_t phase = max_phase() + 1;
+  OperationDescriptor *opdesc = descriptor_new();
   opdesc->init(phase, true, OperationDescriptor::Type::kDequeue, NULL);
-  AtomicPointer<OperationDescriptor*> new_state(opdesc,
-                                                state_[thread_id]->aba() + 1);
-  state_[thread_id]->set_raw(new_state.raw());
+  install(thread_id, opdesc);
   help(phase);
   help_finish_dequeue();
-  Node *node = state_[thread_id]->value()->node;
+  Node *node = state(thread_id).value()->node;
   if (node == NULL) {
     return false;
   }
@@ -265,27 +361,25 @@ void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
     if (head_->raw() == head_old.raw()) {
       if (head_old.value() == tail_old.value()) {
         if (next.value() == NULL) {  // Queue is empty.
-          AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
+          AtomicPointer<OperationDescriptor*> cur_state = state(thread_id);
           if (tail_old.value() == tail_->value()
-              && is_still_pending(thread_id, phase)) {
-            OperationDescriptor *new_desc =
-                scal::tlget<OperationDescriptor>(kPtrAlignment);
-            new_desc->init(state_[thread_id]->value()->phase,
+              && cur_state.value()->pending
+              && cur_state.value()->phase <= phase) {
+            OperationDescriptor *new_desc = descriptor_new();
+            new_desc->init(cur_state.value()->phase,
                            false,
                            OperationDescriptor::Type::kDequeue,
                            NULL);
-            AtomicPointer<OperationDescriptor*> new_state(new_desc,
-                                                        cur_state.aba() + 1);
             // If the next CAS fails, another thread changed the state, which
             // is also ok since the descriptor will not indicate pending in the
             // next try.
-            state_[thread_id]->cas(cur_state, new_state);
+            replace(thread_id, cur_state, new_desc);
           }
         } else {  // Help finish a pending enqueue.
           help_finish_enqueue();
         }
       } else {  // Queue is not empty.
-        AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
+        AtomicPointer<OperationDescriptor*> cur_state = state(thread_id);
         OperationDescriptor *cur_desc = cur_state.value();
         Node *node = cur_desc->node;
         if (!is_still_pending(thread_id, phase)) {
@@ -293,14 +387,17 @@ void WaitfreeQueue<T>::help_dequeue(uint64_t thread_id, int64_t phase) {
         }
         if (head_->raw() == head_old.raw()
             && node != head_old.value()) {
-          OperationDescriptor *new_desc =
-              scal::tlget<OperationDescriptor>(kPtrAlignment);
-          new_desc->init(state_[thread_id]->value()->phase, true,
+          // is_still_pending has protected the current state, which has to
+          // be the one we replace.
+          if (!scal::HazardPointers::protect(0, cur_state,
+                                             state_[thread_id])) {
+            continue;
+          }
+          OperationDescriptor *new_desc = descriptor_new();
+          new_desc->init(cur_state.value()->phase, true,
                          OperationDescriptor::Type::kDequeue,
                          head_old.value());
-          AtomicPointer<OperationDescriptor*> new_state(new_desc,
-              cur_state.aba() + 1);
-          if (!state_[thread_id]->cas(cur_state, new_state)) {
+          if (!replace(thread_id, cur_state, new_desc)) {
             continue;
           }
         }
@@ -320,18 +417,15 @@ void WaitfreeQueue<T>::help_finish_dequeue(void) {
   AtomicPointer<Node*> next = head_old.value()->next;
   uint64_t thread_id = head_old.value()->deq_tid.value();
   if (thread_id != Node::kTidNotSet) {
-    AtomicPointer<OperationDescriptor*> cur_state = *state_[thread_id];
+    AtomicPointer<OperationDescriptor*> cur_state = state(thread_id);
     if (head_old.raw() == head_->raw()
         && next.value() != NULL) {
-      OperationDescriptor *new_desc =
-          scal::tlget<OperationDescriptor>(kPtrAlignment);
-      new_desc->init(state_[thread_id]->value()->phase,
+      OperationDescriptor *new_desc = descriptor_new();
+      new_desc->init(cur_state.value()->phase,
                      false,
                      OperationDescriptor::Type::kDequeue,
-                     state_[thread_id]->value()->node);
-      AtomicPointer<OperationDescriptor*> new_state(new_desc,
-                                                    cur_state.aba() + 1);
-      state_[thread_id]->cas(cur_state, new_state);
+                     cur_state.value()->node);
+      replace(thread_id, cur_state, new_desc);
       AtomicPointer<Node*> head_new(next.value(), head_old.aba() + 1);
       head_->cas(head_old, head_new);
     }
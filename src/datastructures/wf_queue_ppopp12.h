@@ -16,13 +16,16 @@
 //
 // We also cannot use the queue with more than kAbaMax threads, which is a
 // problem when used with single-word CAS, where the last few bits represent the
-// ABA counter.
+// ABA counter. Threads are helped in turns over a fixed number of thread ids,
+// so only ids below the number passed at creation may use the queue.
 
 #ifndef SCAL_DATASTRUCTURES_WF_QUEUE_PPOPP12_H_
 #define SCAL_DATASTRUCTURES_WF_QUEUE_PPOPP12_H_
 
 #include <assert.h>
 #include <stdint.h> 
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "datastructures/queue.h"
 #include "util/atomic_value.h"
@@ -144,6 +147,10 @@ volatile AtomicPointer<OperationDescriptor<T>*>** HelpRecord<T>::State = NULL;
 
 }  // namespace wf_ppopp12_details
 
+// Shares its name with the queue of wf_queue_ppopp11.h, so both can be
+// linked into one binary.
+namespace wf_ppopp12 {
+
 template<typename T>
 class WaitfreeQueue : public Queue<T> {
  public:
@@ -224,6 +231,11 @@ WaitfreeQueue<T>::WaitfreeQueue(uint64_t num_threads,
 template<typename T>
 void WaitfreeQueue<T>::help_if_needed() {
   uint64_t thread_id = scal::ThreadContext::get().thread_id();
+  if (thread_id >= num_threads_) {
+    fprintf(stderr, "%s: error: thread id %lu exceeds the %lu threads of the "
+            "queue\n", __func__, thread_id, num_threads_);
+    abort();
+  }
   volatile HelpRecord *rec = records_[thread_id];
   if (rec->do_next_check()) {
     OperationDescriptor *desc = state_[rec->cur_thread_id()]->value();
@@ -480,4 +492,6 @@ void WaitfreeQueue<T>::help_finish_deq(void) {
   }
 }
 
+}  // namespace wf_ppopp12
+
 #endif  // SCAL_DATASTRUCTURES_WF_QUEUE_PPOPP12_H_
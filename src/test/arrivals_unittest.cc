@@ -0,0 +1,61 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include "util/arrivals.h"
+#include "util/threadlocals.h"
+
+using scal::ArrivalProcess;
+
+namespace {
+
+const uint64_t kN = 100000;
+
+class ArrivalsEnvironment : public testing::Environment {
+ public:
+  virtual void SetUp() {
+    scal::ThreadContext::prepare(1);
+    scal::ThreadContext::assign_context();
+  }
+};
+
+::testing::Environment* const arrivals_env =
+    ::testing::AddGlobalTestEnvironment(new ArrivalsEnvironment());
+
+}  // namespace
+
+TEST(ArrivalsTest, PoissonMeanGap) {
+  ArrivalProcess arrivals(1000, 0, 0, 5000);
+  uint64_t first = arrivals.next();
+  uint64_t last = first;
+  for (uint64_t i = 1; i < kN; i++) {
+    uint64_t next = arrivals.next();
+    EXPECT_LE(last, next);
+    last = next;
+  }
+  EXPECT_LE(5000u, first);
+  double mean_gap = static_cast<double>(last - 5000) / kN;
+  EXPECT_NEAR(1000, mean_gap, 20);
+}
+
+TEST(ArrivalsTest, OnOffKeepsMeanGap) {
+  ArrivalProcess arrivals(1000, 20000, 60000, 0);
+  uint64_t last = 0;
+  for (uint64_t i = 0; i < kN; i++) {
+    last = arrivals.next();
+  }
+  double mean_gap = static_cast<double>(last) / kN;
+  EXPECT_NEAR(1000, mean_gap, 40);
+}
+
+TEST(ArrivalsTest, NoArrivalsInOffPeriods) {
+  const uint64_t on = 20000;
+  const uint64_t off = 60000;
+  ArrivalProcess arrivals(1000, on, off, 0);
+  for (uint64_t i = 0; i < kN; i++) {
+    EXPECT_LT(arrivals.next() % (on + off), on);
+  }
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "util/backoff.h"
+#include "util/time.h"
+
+using scal::Backoff;
+using scal::ParkingLot;
+
+namespace {
+
+bool fail() {
+  return false;
+}
+
+bool succeed() {
+  return true;
+}
+
+void* notify_later(void *lot) {
+  usleep(100);
+  static_cast<ParkingLot*>(lot)->notify();
+  return NULL;
+}
+
+}  // namespace
+
+TEST(BackoffTest, ParsePolicy) {
+  Backoff::Policy policy;
+  EXPECT_TRUE(Backoff::parse_policy("none", &policy));
+  EXPECT_EQ(Backoff::kNone, policy);
+  EXPECT_TRUE(Backoff::parse_policy("exp", &policy));
+  EXPECT_EQ(Backoff::kExponentialPause, policy);
+  EXPECT_TRUE(Backoff::parse_policy("futex", &policy));
+  EXPECT_EQ(Backoff::kPark, policy);
+  EXPECT_FALSE(Backoff::parse_policy("sleep", &policy));
+}
+
+TEST(BackoffTest, OnlyParkRetries) {
+  const Backoff::Policy policies[] = {
+    Backoff::kNone, Backoff::kPause, Backoff::kExponentialPause, Backoff::kYield
+  };
+  // Unused by these policies, but the compiler cannot tell.
+  ParkingLot lot;
+  for (uint64_t i = 0; i < 4; i++) {
+    Backoff backoff(policies[i], 4, 64, &lot);
+    for (uint64_t j = 0; j < 10; j++) {
+      EXPECT_FALSE(backoff.backoff(succeed));
+    }
+    backoff.reset();
+  }
+}
+
+TEST(BackoffTest, ParkReturnsSuccessfulRetry) {
+  ParkingLot lot;
+  Backoff backoff(Backoff::kPark, 0, 0, &lot);
+  EXPECT_TRUE(backoff.backoff(succeed));
+}
+
+TEST(BackoffTest, ParkTimesOut) {
+  ParkingLot lot;
+  Backoff backoff(Backoff::kPark, 0, 0, &lot);
+  uint64_t start = get_utime();
+  EXPECT_FALSE(backoff.backoff(fail));
+  EXPECT_LE(ParkingLot::kMaxParkTime / 1000 / 2, get_utime() - start);
+}
+
+TEST(BackoffTest, NotifyWakesParkedThread) {
+  ParkingLot lot;
+  Backoff backoff(Backoff::kPark, 0, 0, &lot);
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, notify_later, &lot));
+  // Either woken up by the notification or by the timeout; both return.
+  EXPECT_FALSE(backoff.backoff(fail));
+  pthread_join(thread, NULL);
+}
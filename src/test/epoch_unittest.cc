@@ -0,0 +1,115 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "util/epoch.h"
+#include "util/malloc.h"
+#include "util/threadlocals.h"
+
+using scal::Epoch;
+using scal::EpochGuard;
+using scal::EpochPool;
+
+namespace {
+
+pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+void init(void) {
+  scal::ThreadContext::prepare(2);
+  scal::ThreadContext::assign_context();
+  scal::tlalloc_init(1024, false);
+  Epoch::set_enabled(true);
+}
+
+void setup(void) {
+  pthread_once(&init_once, init);
+}
+
+struct Reader {
+  volatile bool entered;
+  volatile bool done;
+};
+
+// Stays within a guard until |done| is set.
+void* reader(void *data) {
+  Reader *r = static_cast<Reader*>(data);
+  scal::ThreadContext::assign_context();
+  EpochGuard guard;
+  r->entered = true;
+  while (!r->done) {
+    __asm__ __volatile__("pause" ::: "memory");
+  }
+  return NULL;
+}
+
+}  // namespace
+
+TEST(EpochTest, AdvancesWhenIdle) {
+  setup();
+  uint64_t epoch = Epoch::current();
+  EXPECT_EQ(epoch + 1, Epoch::try_advance());
+  {
+    EpochGuard guard;
+    // The calling thread has announced the current epoch.
+    EXPECT_EQ(epoch + 2, Epoch::try_advance());
+    // But not the new one.
+    EXPECT_EQ(epoch + 2, Epoch::try_advance());
+  }
+  EXPECT_EQ(epoch + 3, Epoch::try_advance());
+}
+
+TEST(EpochTest, GuardsNest) {
+  setup();
+  uint64_t epoch = Epoch::current();
+  EpochGuard outer;
+  {
+    EpochGuard inner;
+  }
+  EXPECT_EQ(epoch + 1, Epoch::try_advance());
+  EXPECT_EQ(epoch + 1, Epoch::try_advance());
+}
+
+TEST(EpochTest, ReaderHoldsEpoch) {
+  setup();
+  Reader r;
+  r.entered = false;
+  r.done = false;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, reader, &r));
+  while (!r.entered) {}
+  uint64_t epoch = Epoch::try_advance();
+  EXPECT_EQ(epoch, Epoch::try_advance());
+  EXPECT_EQ(epoch, Epoch::try_advance());
+  r.done = true;
+  pthread_join(thread, NULL);
+  EXPECT_EQ(epoch + 1, Epoch::try_advance());
+}
+
+TEST(EpochTest, PoolReusesRetiredObjects) {
+  setup();
+  EpochPool<uint64_t> pool;
+  uint64_t objects[3];
+  EXPECT_EQ(NULL, pool.get());
+  {
+    EpochGuard guard;
+    pool.retire(&objects[0]);
+  }
+  // Objects are handed out by the next retire two epochs later.
+  Epoch::try_advance();
+  {
+    EpochGuard guard;
+    pool.retire(&objects[1]);
+  }
+  EXPECT_EQ(NULL, pool.get());
+  Epoch::try_advance();
+  {
+    EpochGuard guard;
+    pool.retire(&objects[2]);
+  }
+  EXPECT_EQ(&objects[0], pool.get());
+  EXPECT_EQ(NULL, pool.get());
+}
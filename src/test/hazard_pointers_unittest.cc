@@ -0,0 +1,97 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <set>
+
+#include "util/hazard_pointers.h"
+#include "util/malloc.h"
+#include "util/object_pool.h"
+#include "util/threadlocals.h"
+
+using scal::HazardPointers;
+using scal::HazardPool;
+using scal::Unreclaimed;
+
+namespace {
+
+const uint64_t kNumObjects = 10000;
+
+pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+void init(void) {
+  scal::ThreadContext::prepare(2);
+  scal::ThreadContext::assign_context();
+  scal::tlalloc_init(1024, false);
+  HazardPointers::set_enabled(true);
+}
+
+void setup(void) {
+  pthread_once(&init_once, init);
+}
+
+struct Reader {
+  uint64_t *object;
+  volatile bool protected_;
+  volatile bool done;
+};
+
+// Protects |object| and stalls until |done| is set.
+void* reader(void *data) {
+  Reader *r = static_cast<Reader*>(data);
+  scal::ThreadContext::assign_context();
+  HazardPointers::set(0, r->object);
+  r->protected_ = true;
+  while (!r->done) {
+    __asm__ __volatile__("pause" ::: "memory");
+  }
+  HazardPointers::set(0, NULL);
+  return NULL;
+}
+
+}  // namespace
+
+TEST(HazardPointersTest, ReclaimsUnprotectedObjects) {
+  setup();
+  HazardPool<uint64_t> pool;
+  static uint64_t objects[kNumObjects];
+  EXPECT_EQ(NULL, pool.get());
+  for (uint64_t i = 0; i < kNumObjects; i++) {
+    pool.retire(&objects[i]);
+  }
+  std::set<uint64_t*> reused;
+  uint64_t *object;
+  while ((object = pool.get()) != NULL) {
+    EXPECT_TRUE(reused.insert(object).second);
+  }
+  // All but the last unscanned objects are reclaimed.
+  EXPECT_GE(reused.size(), kNumObjects - 64);
+}
+
+TEST(HazardPointersTest, StalledReaderBoundsGarbage) {
+  setup();
+  Unreclaimed::reset();
+  HazardPool<uint64_t> pool;
+  static uint64_t objects[kNumObjects];
+  Reader r;
+  r.object = &objects[0];
+  r.protected_ = false;
+  r.done = false;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, reader, &r));
+  while (!r.protected_) {}
+  for (uint64_t i = 0; i < kNumObjects; i++) {
+    pool.retire(&objects[i]);
+    uint64_t *object = pool.get();
+    EXPECT_NE(&objects[0], object);
+  }
+  // The stalled reader only keeps the object it protects, so the garbage
+  // does not grow with the number of retired objects.
+  EXPECT_LE(Unreclaimed::peak(), 2 * 64 * sizeof(uint64_t));
+  r.done = true;
+  pthread_join(thread, NULL);
+}
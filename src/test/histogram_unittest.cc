@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include "util/histogram.h"
+
+using scal::Histogram;
+
+TEST(HistogramTest, Empty) {
+  Histogram h;
+  EXPECT_EQ(0u, h.count());
+  EXPECT_EQ(0u, h.min());
+  EXPECT_EQ(0u, h.max());
+  EXPECT_EQ(0u, h.percentile(50));
+}
+
+TEST(HistogramTest, SmallValuesAreExact) {
+  Histogram h;
+  for (uint64_t i = 1; i <= 20; i++) {
+    h.add(i);
+  }
+  EXPECT_EQ(20u, h.count());
+  EXPECT_EQ(1u, h.min());
+  EXPECT_EQ(20u, h.max());
+  EXPECT_EQ(10u, h.percentile(50));
+  EXPECT_EQ(18u, h.percentile(90));
+  EXPECT_EQ(20u, h.percentile(100));
+  EXPECT_DOUBLE_EQ(10.5, h.mean());
+}
+
+TEST(HistogramTest, RelativeError) {
+  Histogram h;
+  const uint64_t kValues = 100000;
+  for (uint64_t i = 1; i <= kValues; i++) {
+    h.add(i * 97);
+  }
+  const double percentiles[] = { 50, 90, 99, 99.9 };
+  for (uint64_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    double exact = percentiles[i] / 100.0 * kValues * 97;
+    double reported = static_cast<double>(h.percentile(percentiles[i]));
+    EXPECT_GE(reported, exact * 0.999);
+    EXPECT_LE(reported, exact * (1.0 + 1.0 / Histogram::kSubBuckets));
+  }
+  EXPECT_EQ(kValues * 97, h.percentile(100));
+}
+
+TEST(HistogramTest, LargeValues) {
+  Histogram h;
+  h.add(1ul << 63);
+  h.add(std::numeric_limits<uint64_t>::max());
+  EXPECT_EQ(2u, h.count());
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), h.percentile(100));
+  EXPECT_GE(h.percentile(50), 1ul << 63);
+}
+
+TEST(HistogramTest, Merge) {
+  Histogram a;
+  Histogram b;
+  for (uint64_t i = 0; i < 99; i++) {
+    a.add(10);
+  }
+  b.add(100000);
+  a.merge(b);
+  EXPECT_EQ(100u, a.count());
+  EXPECT_EQ(10u, a.min());
+  EXPECT_EQ(100000u, a.max());
+  EXPECT_EQ(10u, a.percentile(99));
+  EXPECT_EQ(100000u, a.percentile(100));
+}
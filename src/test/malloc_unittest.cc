@@ -0,0 +1,147 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <set>
+
+#include "util/malloc.h"
+
+DECLARE_bool(size_classes);
+
+namespace {
+
+const uint64_t kNumObjects = 1000;
+
+void setup(void) {
+  FLAGS_size_classes = true;
+  scal::tlalloc_init(1024, false);
+  scal::tlalloc_reset();
+}
+
+struct Freer {
+  void **objects;
+  uint64_t num_objects;
+  size_t size;
+};
+
+// Frees objects allocated by another thread.
+void* freer(void *data) {
+  Freer *f = static_cast<Freer*>(data);
+  scal::tlalloc_init(1024, false);
+  for (uint64_t i = 0; i < f->num_objects; i++) {
+    scal::tlfree(f->objects[i], f->size);
+  }
+  return NULL;
+}
+
+}  // namespace
+
+TEST(MallocTest, RecyclesLocalFrees) {
+  setup();
+  void *objects[kNumObjects];
+  for (uint64_t i = 0; i < kNumObjects; i++) {
+    objects[i] = scal::tlmalloc(24);
+  }
+  std::set<void*> freed(objects, objects + kNumObjects);
+  for (uint64_t i = 0; i < kNumObjects; i++) {
+    scal::tlfree(objects[i], 24);
+  }
+  // Objects of the same size class are reused, those of another are not.
+  void *other = scal::tlmalloc(100);
+  EXPECT_EQ(0u, freed.count(other));
+  for (uint64_t i = 0; i < kNumObjects; i++) {
+    EXPECT_EQ(1u, freed.erase(scal::tlmalloc(17)));
+  }
+  scal::tlfree(other, 100);
+  EXPECT_EQ(other, scal::tlmalloc(97));
+}
+
+TEST(MallocTest, ReturnsRemoteFreesToOwner) {
+  setup();
+  const uint64_t kNumRemote = 64 * 10;
+  void *objects[kNumRemote];
+  for (uint64_t i = 0; i < kNumRemote; i++) {
+    objects[i] = scal::tlmalloc(64);
+  }
+  Freer f;
+  f.objects = objects;
+  f.num_objects = kNumRemote;
+  f.size = 64;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, freer, &f));
+  pthread_join(thread, NULL);
+  // Full batches are handed back to the owner.
+  std::set<void*> freed(objects, objects + kNumRemote);
+  for (uint64_t i = 0; i < kNumRemote; i++) {
+    EXPECT_EQ(1u, freed.erase(scal::tlmalloc(64)));
+  }
+}
+
+TEST(MallocTest, ReturnsPartialBatchesOnExit) {
+  setup();
+  const uint64_t kNumRemote = 10;
+  void *objects[kNumRemote];
+  for (uint64_t i = 0; i < kNumRemote; i++) {
+    objects[i] = scal::tlmalloc(64);
+  }
+  Freer f;
+  f.objects = objects;
+  f.num_objects = kNumRemote;
+  f.size = 64;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, freer, &f));
+  pthread_join(thread, NULL);
+  // Less than a batch, which the freer hands back when it exits.
+  std::set<void*> freed(objects, objects + kNumRemote);
+  for (uint64_t i = 0; i < kNumRemote; i++) {
+    EXPECT_EQ(1u, freed.erase(scal::tlmalloc(64)));
+  }
+}
+
+TEST(MallocTest, AlignsSizeClasses) {
+  setup();
+  for (uint64_t alignment = 16; alignment <= 4096; alignment *= 2) {
+    for (size_t size = 1; size <= 4096; size += 123) {
+      void *object = scal::tlmalloc_aligned(size, alignment);
+      EXPECT_EQ(0u, reinterpret_cast<uint64_t>(object) % alignment);
+      scal::tlfree(object, size);
+      EXPECT_EQ(object, scal::tlmalloc_aligned(size, alignment));
+    }
+  }
+}
+
+TEST(MallocTest, CountsAllocations) {
+  setup();
+  const scal::AllocStats before = scal::alloc_stats();
+  void *object = scal::tlmalloc_aligned(100, 64);
+  scal::tlfree(object, 100);
+  scal::tlmalloc_aligned(100, 64);
+  scal::tlmalloc(2 * 4096);
+  scal::AllocStats stats = scal::alloc_stats();
+  stats.subtract(before);
+  EXPECT_EQ(2 * 100u + 2 * 4096u, stats.requested);
+  EXPECT_EQ(1u, stats.local_frees);
+  EXPECT_EQ(0u, stats.remote_frees);
+  EXPECT_EQ(1u, stats.fallbacks);
+  EXPECT_EQ(0u, stats.wrap_arounds);
+}
+
+TEST(MallocTest, GrowsInsteadOfWrapping) {
+  setup();
+  // Twice the memory of the buffer.
+  const uint64_t kNumLarge = 2 * 1024;
+  uint64_t *objects[kNumLarge];
+  for (uint64_t i = 0; i < kNumLarge; i++) {
+    objects[i] = static_cast<uint64_t*>(scal::tlmalloc(4096));
+    *objects[i] = i;
+  }
+  for (uint64_t i = 0; i < kNumLarge; i++) {
+    EXPECT_EQ(i, *objects[i]);
+  }
+  EXPECT_EQ(0u, scal::alloc_stats().wrap_arounds);
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util/perf_counters.h"
+
+using scal::PerfCounters;
+
+TEST(PerfCountersTest, Names) {
+  EXPECT_STREQ("cycles", PerfCounters::name(PerfCounters::kCycles));
+  EXPECT_STREQ("page_faults", PerfCounters::name(PerfCounters::kPageFaults));
+}
+
+TEST(PerfCountersTest, ClosedCountersAreNotAvailable) {
+  PerfCounters counters;
+  for (uint64_t i = 0; i < PerfCounters::kNumEvents; i++) {
+    EXPECT_FALSE(counters.available(static_cast<PerfCounters::Event>(i)));
+  }
+}
+
+// Whether any events can be counted depends on the environment, so only the
+// available ones are checked.
+TEST(PerfCountersTest, CountsAvailableEvents) {
+  PerfCounters counters;
+  counters.open();
+  counters.start();
+  volatile uint64_t sum = 0;
+  for (uint64_t i = 0; i < 1000000; i++) {
+    sum += i;
+  }
+  counters.stop();
+  if (counters.available(PerfCounters::kTaskClock)) {
+    EXPECT_LT(0u, counters.value(PerfCounters::kTaskClock));
+  }
+  if (counters.available(PerfCounters::kInstructions)) {
+    EXPECT_LT(1000000u, counters.value(PerfCounters::kInstructions));
+  }
+  counters.close();
+  EXPECT_FALSE(counters.available(PerfCounters::kTaskClock));
+}
@@ -64,10 +64,13 @@ class RandomTest : public testing::Test {
     scal::ThreadContext::get().new_random_seed();
   }
 
+  virtual void TearDown() {
+    scal::set_rand_generator(scal::kRandXoshiro);
+  }
+
   // Perform a chi-square test; alpha: 0.1%, kClasses-1 degrees of freedom
   bool chi_square(const RandomWrapper &rw) {
     uint64_t frequency[kClasses];
-    const double expected_frequency = static_cast<double>(kN) / kClasses;
     for (uint64_t i = 0; i < kClasses; i++) {
       frequency[i] = 0;
     }
@@ -75,6 +78,26 @@ class RandomTest : public testing::Test {
       uint64_t rand = rw.rand_range(0, kClasses);
       frequency[rand]++;
     }
+    return chi_square(frequency);
+  }
+
+  // Chi-square test of consecutive pairs of values in [0,4), which fails
+  // for generators whose values depend on their predecessors.
+  bool serial_chi_square(const RandomWrapper &rw) {
+    uint64_t frequency[kClasses];
+    for (uint64_t i = 0; i < kClasses; i++) {
+      frequency[i] = 0;
+    }
+    for (uint64_t i = 0; i < kN; i++) {
+      uint64_t first = rw.rand_range(0, 4);
+      uint64_t second = rw.rand_range(0, 4);
+      frequency[4 * first + second]++;
+    }
+    return chi_square(frequency);
+  }
+
+  bool chi_square(const uint64_t *frequency) {
+    const double expected_frequency = static_cast<double>(kN) / kClasses;
     double chi_square = 0;
     for (uint64_t i = 0; i < kClasses; i++) {
       chi_square += ((frequency[i] - expected_frequency) * 
@@ -156,3 +179,83 @@ TEST_F(RandomTest, HWRandomDependence) {
   rw.set_rand1(scal::hwrand);
   EXPECT_FALSE(run_test(rw));
 }
+
+TEST_F(RandomTest, PseudoRandomSerialDistribution) {
+  RandomWrapper rw;
+  rw.set_rand2(scal::rand_range);
+  EXPECT_TRUE(serial_chi_square(rw));
+}
+
+TEST_F(RandomTest, MinStdDistribution) {
+  scal::set_rand_generator(scal::kRandMinStd);
+  RandomWrapper rw;
+  rw.set_rand1(scal::rand);
+  EXPECT_TRUE(chi_square(rw));
+  rw.set_rand2(scal::rand_range);
+  EXPECT_TRUE(chi_square(rw));
+  EXPECT_TRUE(serial_chi_square(rw));
+}
+
+TEST_F(RandomTest, MinStdIndependence) {
+  scal::set_rand_generator(scal::kRandMinStd);
+  RandomWrapper rw;
+  rw.set_rand1(scal::rand);
+  EXPECT_TRUE(run_test(rw));
+}
+
+TEST_F(RandomTest, HardwareRangeDistribution) {
+  scal::set_rand_generator(scal::kRandHardware);
+  RandomWrapper rw;
+  rw.set_rand2(scal::rand_range);
+  EXPECT_TRUE(chi_square(rw));
+  for (uint64_t i = 0; i < kN; i++) {
+    EXPECT_GT(8u, scal::rand_range(0, 8));
+  }
+}
+
+TEST_F(RandomTest, RangeBounds) {
+  for (uint64_t i = 0; i < kN; i++) {
+    uint64_t rand = scal::rand_range(5, 8);
+    EXPECT_LE(5u, rand);
+    EXPECT_GT(8u, rand);
+    EXPECT_GE(static_cast<uint64_t>(scal::kRandMax), scal::rand());
+  }
+}
+
+TEST_F(RandomTest, FillMatchesSequence) {
+  const uint64_t kValues = 1000;
+  uint64_t values[kValues];
+  scal::srand(42);
+  scal::rand_fill(values, kValues);
+  scal::srand(42);
+  for (uint64_t i = 0; i < kValues; i++) {
+    EXPECT_EQ(scal::rand(), values[i]);
+  }
+  scal::rand_range_fill(10, 20, values, kValues);
+  scal::srand(42);
+  for (uint64_t i = 0; i < kValues; i++) {
+    scal::rand();
+  }
+  for (uint64_t i = 0; i < kValues; i++) {
+    EXPECT_EQ(scal::rand_range(10, 20), values[i]);
+  }
+}
+
+// Threads are seeded with close seeds (see ThreadContext::new_random_seed),
+// which must not give correlated sequences.
+TEST_F(RandomTest, CloseSeedsIndependence) {
+  static uint64_t first[kN];
+  static uint64_t second[kN];
+  scal::srand(1);
+  scal::rand_range_fill(0, 4, first, kN);
+  scal::srand(2);
+  scal::rand_range_fill(0, 4, second, kN);
+  uint64_t frequency[kClasses];
+  for (uint64_t i = 0; i < kClasses; i++) {
+    frequency[i] = 0;
+  }
+  for (uint64_t i = 0; i < kN; i++) {
+    frequency[4 * first[i] + second[i]]++;
+  }
+  EXPECT_TRUE(chi_square(frequency));
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include "benchmark/result.h"
+
+using scal::Result;
+
+TEST(ResultTest, ParseFormat) {
+  Result::Format format;
+  EXPECT_TRUE(Result::parse_format("json", &format));
+  EXPECT_EQ(Result::kJson, format);
+  EXPECT_TRUE(Result::parse_format("csv", &format));
+  EXPECT_EQ(Result::kCsv, format);
+  EXPECT_TRUE(Result::parse_format("text", &format));
+  EXPECT_EQ(Result::kText, format);
+  EXPECT_FALSE(Result::parse_format("xml", &format));
+}
+
+TEST(ResultTest, TextOnlyContainsColumns) {
+  Result result;
+  result.add("ds", "ms");
+  result.add_column("threads", static_cast<uint64_t>(4));
+  result.add("operations", static_cast<uint64_t>(1000));
+  result.add_column("throughput", static_cast<uint64_t>(250));
+  EXPECT_EQ("4 250", result.format(Result::kText));
+}
+
+TEST(ResultTest, Json) {
+  Result result;
+  result.add("ds", "a\"b\\c");
+  result.add("threads", static_cast<uint64_t>(4));
+  result.add("delay", static_cast<int64_t>(-2));
+  result.add("throughput", 1.5);
+  EXPECT_EQ("{\"ds\":\"a\\\"b\\\\c\",\"threads\":4,\"delay\":-2,"
+            "\"throughput\":1.500}",
+            result.format(Result::kJson));
+}
+
+TEST(ResultTest, JsonNonFinite) {
+  Result result;
+  result.add("mean", 0.0 / 0.0);
+  result.add("ratio", 1.0 / 0.0);
+  EXPECT_EQ("{\"mean\":null,\"ratio\":null}", result.format(Result::kJson));
+}
+
+TEST(ResultTest, Csv) {
+  Result result;
+  result.add("ds", "ms");
+  result.add("cpus", "1:0, 2:1");
+  result.add_column("threads", static_cast<uint64_t>(2));
+  EXPECT_EQ("ds,cpus,threads", result.csv_header());
+  EXPECT_EQ("ms,\"1:0, 2:1\",2", result.format(Result::kCsv));
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include "util/statistics.h"
+
+using scal::Statistics;
+
+TEST(StatisticsTest, Empty) {
+  Statistics s;
+  EXPECT_EQ(0u, s.count());
+  EXPECT_EQ(0, s.mean());
+  EXPECT_EQ(0, s.min());
+  EXPECT_EQ(0, s.max());
+  EXPECT_EQ(0, s.stddev());
+  EXPECT_EQ(0, s.ci95());
+}
+
+TEST(StatisticsTest, SingleSample) {
+  Statistics s;
+  s.add(42);
+  EXPECT_EQ(42, s.mean());
+  EXPECT_EQ(42, s.min());
+  EXPECT_EQ(42, s.max());
+  EXPECT_EQ(0, s.stddev());
+  EXPECT_EQ(0, s.ci95());
+}
+
+TEST(StatisticsTest, Samples) {
+  Statistics s;
+  const double samples[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+  for (uint64_t i = 0; i < 8; i++) {
+    s.add(samples[i]);
+  }
+  EXPECT_EQ(8u, s.count());
+  EXPECT_DOUBLE_EQ(5, s.mean());
+  EXPECT_EQ(2, s.min());
+  EXPECT_EQ(9, s.max());
+  EXPECT_NEAR(2.138, s.stddev(), 0.001);
+  // t(7) = 2.365
+  EXPECT_NEAR(2.365 * 2.138 / sqrt(8.0), s.ci95(), 0.001);
+}
+
+TEST(StatisticsTest, CriticalValues) {
+  EXPECT_DOUBLE_EQ(12.706, Statistics::t95(1));
+  EXPECT_DOUBLE_EQ(2.042, Statistics::t95(30));
+  EXPECT_DOUBLE_EQ(1.960, Statistics::t95(1000));
+  for (uint64_t df = 2; df < 200; df++) {
+    EXPECT_LE(Statistics::t95(df), Statistics::t95(df - 1));
+  }
+}
+
+TEST(StatisticsTest, Reset) {
+  Statistics s;
+  s.add(1);
+  s.add(3);
+  s.reset();
+  s.add(5);
+  EXPECT_EQ(1u, s.count());
+  EXPECT_EQ(5, s.mean());
+  EXPECT_EQ(5, s.min());
+}
+
+TEST(StatisticsTest, Jain) {
+  Statistics s;
+  EXPECT_EQ(1, s.jain());
+  for (uint64_t i = 0; i < 4; i++) {
+    s.add(100);
+  }
+  EXPECT_DOUBLE_EQ(1, s.jain());
+  s.reset();
+  s.add(100);
+  for (uint64_t i = 0; i < 3; i++) {
+    s.add(0);
+  }
+  EXPECT_DOUBLE_EQ(0.25, s.jain());
+  s.reset();
+  s.add(1);
+  s.add(3);
+  // (1 + 3)^2 / (2 * (1 + 9))
+  EXPECT_DOUBLE_EQ(0.8, s.jain());
+}
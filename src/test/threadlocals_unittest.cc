@@ -0,0 +1,116 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "util/thread_array.h"
+#include "util/threadlocals.h"
+
+using scal::ThreadArray;
+using scal::ThreadContext;
+
+namespace {
+
+const uint64_t kNumThreads = 8;
+const uint64_t kNumGenerations = 100;
+
+void* get_id(void *data) {
+  *static_cast<uint64_t*>(data) = ThreadContext::get().thread_id();
+  return NULL;
+}
+
+struct Waiter {
+  uint64_t thread_id;
+  volatile bool registered;
+  volatile bool done;
+};
+
+// Registers and stays registered until |done| is set.
+void* wait(void *data) {
+  Waiter *w = static_cast<Waiter*>(data);
+  w->thread_id = ThreadContext::get().thread_id();
+  w->registered = true;
+  while (!w->done) {
+    __asm__ __volatile__("pause" ::: "memory");
+  }
+  return NULL;
+}
+
+}  // namespace
+
+TEST(ThreadContextTest, RecyclesIdsOfExitedThreads) {
+  ThreadContext::get();
+  // Threads coming and going one at a time keep reusing the same id.
+  uint64_t first_id;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, get_id, &first_id));
+  pthread_join(thread, NULL);
+  for (uint64_t i = 0; i < kNumGenerations; i++) {
+    uint64_t thread_id;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, get_id, &thread_id));
+    pthread_join(thread, NULL);
+    EXPECT_EQ(first_id, thread_id);
+  }
+  EXPECT_LE(ThreadContext::num_ids(), first_id + 1);
+}
+
+TEST(ThreadContextTest, HandsOutLowestFreeId) {
+  uint64_t own_id = ThreadContext::get().thread_id();
+  Waiter waiters[kNumThreads];
+  pthread_t threads[kNumThreads];
+  for (uint64_t i = 0; i < kNumThreads; i++) {
+    waiters[i].registered = false;
+    waiters[i].done = false;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, wait, &waiters[i]));
+    while (!waiters[i].registered) {}
+  }
+  // Running threads have distinct ids, and the ids stay dense.
+  bool taken[kNumThreads + 1] = { false };
+  taken[own_id] = true;
+  for (uint64_t i = 0; i < kNumThreads; i++) {
+    ASSERT_LE(waiters[i].thread_id, kNumThreads);
+    EXPECT_FALSE(taken[waiters[i].thread_id]);
+    taken[waiters[i].thread_id] = true;
+  }
+  waiters[3].done = true;
+  pthread_join(threads[3], NULL);
+  uint64_t thread_id;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, get_id, &thread_id));
+  pthread_join(thread, NULL);
+  EXPECT_EQ(waiters[3].thread_id, thread_id);
+  for (uint64_t i = 0; i < kNumThreads; i++) {
+    waiters[i].done = true;
+    if (i != 3) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}
+
+TEST(ThreadContextTest, ReleaseContextFreesId) {
+  uint64_t thread_id = ThreadContext::get().thread_id();
+  ThreadContext::release_context();
+  uint64_t other_id;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, get_id, &other_id));
+  pthread_join(thread, NULL);
+  EXPECT_EQ(thread_id, other_id);
+  // Registers again.
+  EXPECT_EQ(thread_id, ThreadContext::get().thread_id());
+}
+
+TEST(ThreadArrayTest, AllocatesSegmentsOnDemand) {
+  ThreadArray<uint64_t> array;
+  EXPECT_EQ(NULL, array.find(0));
+  EXPECT_EQ(NULL, array.find(ThreadContext::kMaxThreads - 1));
+  array[ThreadContext::kMaxThreads - 1] = 1;
+  EXPECT_EQ(1u, *array.find(ThreadContext::kMaxThreads - 1));
+  EXPECT_EQ(0u, *array.find(ThreadContext::kMaxThreads - 2));
+  EXPECT_EQ(NULL, array.find(0));
+  uint64_t *entry = &array[5];
+  array[1000] = 2;
+  EXPECT_EQ(entry, array.find(5));
+}
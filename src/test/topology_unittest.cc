@@ -0,0 +1,122 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "util/topology.h"
+
+using scal::CpuTopology;
+
+namespace {
+
+void write_file(const std::string &path, const std::string &content) {
+  FILE *f = fopen(path.c_str(), "w");
+  ASSERT_TRUE(f != NULL);
+  fprintf(f, "%s\n", content.c_str());
+  fclose(f);
+}
+
+std::string to_string(const std::vector<int> &cpus) {
+  std::string result;
+  char buffer[16];
+  for (size_t i = 0; i < cpus.size(); i++) {
+    snprintf(buffer, sizeof(buffer), (i == 0) ? "%d" : ",%d", cpus[i]);
+    result += buffer;
+  }
+  return result;
+}
+
+// Two packages with two cores each and two hardware threads per core,
+// numbered like Linux does on x86: cpus 0-3 are the first threads of all
+// cores, cpus 4-7 their siblings.
+class TopologyTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char dir[] = "/tmp/scal_topologyXXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    root_ = dir;
+    write_file(root_ + "/online", "0-7");
+    for (int cpu = 0; cpu < 8; cpu++) {
+      char name[64];
+      snprintf(name, sizeof(name), "/cpu%d", cpu);
+      std::string cpu_dir = root_ + name;
+      mkdir(cpu_dir.c_str(), 0755);
+      snprintf(name, sizeof(name), "/node%d", (cpu % 4) / 2);
+      mkdir((cpu_dir + name).c_str(), 0755);
+      std::string topology_dir = cpu_dir + "/topology";
+      mkdir(topology_dir.c_str(), 0755);
+      snprintf(name, sizeof(name), "%d", (cpu % 4) / 2);
+      write_file(topology_dir + "/physical_package_id", name);
+      snprintf(name, sizeof(name), "%d", cpu % 2);
+      write_file(topology_dir + "/core_id", name);
+      snprintf(name, sizeof(name), "%d,%d", cpu % 4, cpu % 4 + 4);
+      write_file(topology_dir + "/thread_siblings_list", name);
+    }
+  }
+
+  virtual void TearDown() {
+    std::string command = "rm -rf " + root_;
+    if (system(command.c_str()) != 0) {
+      fprintf(stderr, "warning: could not remove %s\n", root_.c_str());
+    }
+  }
+
+  std::string placement(const char *policy) {
+    CpuTopology topology(root_.c_str());
+    std::vector<int> cpus;
+    if (!topology.placement(policy, &cpus)) {
+      return "invalid";
+    }
+    return to_string(cpus);
+  }
+
+  std::string root_;
+};
+
+}  // namespace
+
+TEST(ParseCpuListTest, Formats) {
+  std::vector<int> cpus;
+  EXPECT_TRUE(scal::parse_cpu_list("0", &cpus));
+  EXPECT_EQ("0", to_string(cpus));
+  EXPECT_TRUE(scal::parse_cpu_list("0-3,8,10-11", &cpus));
+  EXPECT_EQ("0,1,2,3,8,10,11", to_string(cpus));
+  EXPECT_FALSE(scal::parse_cpu_list("", &cpus));
+  EXPECT_FALSE(scal::parse_cpu_list("3-1", &cpus));
+  EXPECT_FALSE(scal::parse_cpu_list("1,a", &cpus));
+}
+
+TEST_F(TopologyTest, Topology) {
+  CpuTopology topology(root_.c_str());
+  EXPECT_EQ(8u, topology.num_cpus());
+  EXPECT_EQ(2u, topology.num_packages());
+  EXPECT_EQ(2u, topology.num_nodes());
+  EXPECT_EQ(1, topology.find(5)->smt);
+  EXPECT_EQ(1, topology.find(6)->package);
+  EXPECT_TRUE(topology.find(8) == NULL);
+}
+
+TEST_F(TopologyTest, Policies) {
+  EXPECT_EQ("0,1,4,5,2,3,6,7", placement("compact"));
+  EXPECT_EQ("0,2,1,3,4,6,5,7", placement("scatter"));
+  EXPECT_EQ("0,1,2,3", placement("physical"));
+  EXPECT_EQ("0,4,1,5,2,6,3,7", placement("smt"));
+  EXPECT_EQ("7,0,2", placement("7,0,2"));
+  EXPECT_EQ("invalid", placement("0,9"));
+  EXPECT_EQ("invalid", placement("spread"));
+}
+
+TEST(CpuTopologyTest, Host) {
+  CpuTopology topology;
+  std::vector<int> cpus;
+  EXPECT_LT(0u, topology.num_cpus());
+  EXPECT_TRUE(topology.placement("compact", &cpus));
+  EXPECT_EQ(topology.num_cpus(), cpus.size());
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include "util/workloads.h"
+
+using scal::Workload;
+
+TEST(WorkloadsTest, CalibratesComputation) {
+  Workload workload(0);
+  uint64_t short_units = workload.calibrate(1000);
+  uint64_t long_units = workload.calibrate(100000);
+  EXPECT_LE(1u, short_units);
+  EXPECT_LT(short_units, long_units);
+}
+
+TEST(WorkloadsTest, CalibratesStreaming) {
+  Workload workload(1 << 20);
+  uint64_t short_units = workload.calibrate(1000);
+  uint64_t long_units = workload.calibrate(100000);
+  EXPECT_LE(1u, short_units);
+  EXPECT_LT(short_units, long_units);
+}
+
+TEST(WorkloadsTest, StreamsBeyondBufferEnd) {
+  // 4 cache lines, streamed through several times.
+  Workload workload(256);
+  workload.run(10);
+  workload.run(1000);
+}
+
+TEST(WorkloadsTest, CalibratesTinyBudgetToOneUnit) {
+  Workload workload(0);
+  EXPECT_EQ(1u, workload.calibrate(0));
+}
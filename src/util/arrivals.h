@@ -0,0 +1,60 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_UTIL_ARRIVALS_H_
+#define SCAL_UTIL_ARRIVALS_H_
+
+#include <math.h>
+#include <stdint.h>
+
+#include "util/random.h"
+
+namespace scal {
+
+// Arrival times of an open-loop load generator, in an arbitrary time unit
+// (e.g. cycles).
+//
+// Arrivals form a Poisson process with a mean gap of |mean_gap|. If |off| is
+// non-zero, the process is bursty: it alternates between on periods of
+// length |on| during which arrivals are Poisson, and off periods of length
+// |off| without arrivals. The rate during on periods is raised so that the
+// mean gap over time remains |mean_gap|.
+//
+// Uses the calling thread's random number generator.
+class ArrivalProcess {
+ public:
+  ArrivalProcess(double mean_gap, uint64_t on, uint64_t off, uint64_t start)
+      : on_(on),
+        off_(off),
+        time_(start),
+        window_end_(static_cast<double>(start) + on) {
+    on_gap_ = (off == 0) ? mean_gap : mean_gap * on / (on + off);
+  }
+
+  // Returns the time of the next arrival.
+  inline uint64_t next() {
+    // Uniform in (0, 1], so that the logarithm is finite.
+    double u = (static_cast<double>(scal::rand()) + 1.0) /
+               (static_cast<double>(scal::kRandMax) + 1.0);
+    time_ -= on_gap_ * log(u);
+    // Exponential gaps are memoryless, so the part of a gap that reaches
+    // beyond an on period carries over to the next one.
+    while (off_ > 0 && time_ >= window_end_) {
+      time_ += off_;
+      window_end_ += on_ + off_;
+    }
+    return static_cast<uint64_t>(time_);
+  }
+
+ private:
+  double on_gap_;
+  uint64_t on_;
+  uint64_t off_;
+  double time_;
+  double window_end_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_ARRIVALS_H_
@@ -0,0 +1,160 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_UTIL_BACKOFF_H_
+#define SCAL_UTIL_BACKOFF_H_
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace scal {
+
+// Lets threads that find a data structure empty sleep until another thread
+// announces that it has put an item.
+//
+// Parking is best effort: a relaxed data structure may not return an item
+// even after it has been announced, so parked threads also wake up after
+// kMaxParkTime.
+class ParkingLot {
+ public:
+  static const long kMaxParkTime = 1000000;  // ns
+
+  ParkingLot() : epoch_(0), parked_(0) {}
+
+  // Called after putting an item. Only touches shared state if a thread is
+  // parked.
+  inline void notify() {
+    __sync_synchronize();
+    if (parked_ > 0) {
+      __sync_fetch_and_add(&epoch_, 1);
+      syscall(SYS_futex, &epoch_, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+  }
+
+  // Registers the calling thread as parked and returns the epoch to pass to
+  // park(). The caller should retry its operation in between, since items
+  // put before prepare() are not announced.
+  inline int prepare() {
+    __sync_fetch_and_add(&parked_, 1);
+    return epoch_;
+  }
+
+  // Sleeps until an item is announced after prepare() returned |epoch|, or
+  // at most kMaxParkTime.
+  inline void park(int epoch) {
+    struct timespec timeout = { 0, kMaxParkTime };
+    syscall(SYS_futex, &epoch_, FUTEX_WAIT_PRIVATE, epoch, &timeout, NULL, 0);
+    cancel();
+  }
+
+  // Unregisters a thread whose retry after prepare() succeeded.
+  inline void cancel() {
+    __sync_fetch_and_sub(&parked_, 1);
+  }
+
+ private:
+  volatile int epoch_;
+  volatile uint64_t parked_;
+};
+
+// Back-off between failed attempts of an operation, e.g., gets that find a
+// data structure empty.
+class Backoff {
+ public:
+  enum Policy {
+    kNone,
+    kPause,            // a fixed number of pause instructions
+    kExponentialPause, // doubling the pauses per failure up to a maximum
+    kYield,            // sched_yield()
+    kPark              // sleep on a ParkingLot (futex)
+  };
+
+  // Parses "none", "pause", "exp", "yield", or "futex".
+  static bool parse_policy(const std::string &name, Policy *policy) {
+    static const char *kNames[] = { "none", "pause", "exp", "yield", "futex" };
+    for (int i = 0; i <= kPark; i++) {
+      if (name == kNames[i]) {
+        *policy = static_cast<Policy>(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // |pauses| is the (initial) number of pauses, |max_pauses| bounds the
+  // exponential back-off. |lot| is only used by kPark.
+  Backoff(Policy policy, uint64_t pauses, uint64_t max_pauses,
+          ParkingLot *lot)
+      : policy_(policy),
+        pauses_(pauses),
+        max_pauses_(max_pauses),
+        current_(pauses),
+        lot_(lot) {}
+
+  // Called after a successful attempt.
+  inline void reset() {
+    current_ = pauses_;
+  }
+
+  // Called after a failed attempt. For kPark, |retry| is invoked once the
+  // thread is registered as parked and the thread only sleeps if it returns
+  // false. Returns the result of |retry|, or false if it was not invoked.
+  template<typename Retry>
+  inline bool backoff(Retry retry) {
+    switch (policy_) {
+    case kNone:
+      return false;
+    case kPause:
+      pause(pauses_);
+      return false;
+    case kExponentialPause:
+      pause(current_);
+      if (current_ < max_pauses_) {
+        current_ = (2 * current_ < max_pauses_) ? 2 * current_ : max_pauses_;
+      }
+      return false;
+    case kYield:
+      sched_yield();
+      return false;
+    case kPark: {
+      int epoch = lot_->prepare();
+      if (retry()) {
+        lot_->cancel();
+        return true;
+      }
+      lot_->park(epoch);
+      return false;
+    }
+    }
+    return false;
+  }
+
+  inline Policy policy() const {
+    return policy_;
+  }
+
+ private:
+  static inline void pause(uint64_t pauses) {
+    for (uint64_t i = 0; i < pauses; i++) {
+      __asm__ __volatile__("pause" ::: "memory");
+    }
+  }
+
+  Policy policy_;
+  uint64_t pauses_;
+  uint64_t max_pauses_;
+  uint64_t current_;
+  ParkingLot *lot_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_BACKOFF_H_
@@ -2,21 +2,31 @@
 // Please see the AUTHORS file for details.  Use of this source code is governed
 // by a BSD license that can be found in the LICENSE file.
 
+#ifndef SCAL_UTIL_BARRIER_H_
+#define SCAL_UTIL_BARRIER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "util/malloc.h"
 #include "util/platform.h"
 
 class SpinningBarrier {
  public:
   explicit inline SpinningBarrier(size_t num) {
-    num_ = num; 
+    num_ = num;
     cnt_ = scal::get<uint64_t>(scal::kCachePrefetch);
     *cnt_ = 0;
   }
 
+  inline ~SpinningBarrier() {
+    free(const_cast<uint64_t*>(cnt_));
+  }
+
   inline bool wait() {
     uint64_t old = __sync_fetch_and_add(cnt_, 1);
     // Do not simplfy num_ into the multiplication.
-    uint64_t next = (old / num_) * num_ + num_;  
+    uint64_t next = (old / num_) * num_ + num_;
     while (*cnt_ < next);
     if (old == (next - 1)) {
       return true;
@@ -26,5 +36,7 @@ class SpinningBarrier {
 
  private:
   volatile uint64_t *cnt_;
-  size_t num_;  
+  size_t num_;
 };
+
+#endif  // SCAL_UTIL_BARRIER_H_
@@ -0,0 +1,47 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/epoch.h"
+
+#include <stdint.h>
+
+namespace scal {
+
+bool Epoch::enabled_ = false;
+volatile uint64_t Epoch::global_epoch_ = 0;
+volatile uint64_t Epoch::num_slots_ = 0;
+ThreadArray<Epoch::Slot> Epoch::slots_;
+
+void Epoch::set_enabled(bool enabled) {
+  enabled_ = enabled;
+}
+
+void Epoch::register_slot(uint64_t thread_id, Slot *slot) {
+  uint64_t num_slots;
+  do {
+    num_slots = num_slots_;
+  } while (num_slots <= thread_id &&
+           !__sync_bool_compare_and_swap(&num_slots_, num_slots,
+                                         thread_id + 1));
+  slot->registered = true;
+}
+
+uint64_t Epoch::try_advance(void) {
+  uint64_t epoch = global_epoch_;
+  uint64_t announced = (epoch << 1) | kActive;
+  for (uint64_t i = 0; i < num_slots_; i++) {
+    Slot *slot = slots_.find(i);
+    if (slot == NULL) {
+      continue;
+    }
+    uint64_t state = slot->state;
+    if ((state & kActive) && state != announced) {
+      return epoch;
+    }
+  }
+  __sync_bool_compare_and_swap(&global_epoch_, epoch, epoch + 1);
+  return global_epoch_;
+}
+
+}  // namespace scal
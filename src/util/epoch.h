@@ -0,0 +1,205 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Epoch-based memory reclamation, as described in:
+//
+// K. Fraser. Practical lock-freedom. PhD thesis, University of Cambridge,
+// 2004.
+//
+// Threads announce the global epoch while they operate on a data structure
+// (EpochGuard). Objects unlinked from a data structure are retired into the
+// retiring thread's list of the current epoch (EpochPool). The global epoch
+// only advances once all operating threads have announced it, so objects
+// retired in epoch e cannot be reached by any thread once the epoch is e + 2
+// and are handed out again for reuse.
+//
+// Reclamation is disabled by default, in which case guards and pools do
+// nothing and data structures never reuse memory.
+
+#ifndef SCAL_UTIL_EPOCH_H_
+#define SCAL_UTIL_EPOCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util/malloc.h"
+#include "util/object_pool.h"
+#include "util/platform.h"
+#include "util/thread_array.h"
+#include "util/threadlocals.h"
+
+namespace scal {
+
+class Epoch {
+ public:
+  // Enables or disables reclamation. Must not be changed while threads
+  // operate on data structures.
+  static void set_enabled(bool enabled);
+
+  static inline bool enabled(void) {
+    return enabled_;
+  }
+
+  static inline uint64_t current(void) {
+    return global_epoch_;
+  }
+
+  // Announces the current epoch for the calling thread. Calls nest.
+  static inline void enter(void) {
+    uint64_t thread_id = ThreadContext::get().thread_id();
+    Slot &slot = slots_[thread_id];
+    if (slot.depth++ > 0) {
+      return;
+    }
+    if (!slot.registered) {
+      register_slot(thread_id, &slot);
+    }
+    if ((++slot.num_enters % kAdvanceInterval) == 0) {
+      // Also moves on for threads that rarely retire objects.
+      try_advance();
+    }
+    slot.state = (global_epoch_ << 1) | kActive;
+    // The announcement has to be visible before the data structure is read.
+    __sync_synchronize();
+  }
+
+  static inline void exit(void) {
+    Slot &slot = slots_[ThreadContext::get().thread_id()];
+    if (--slot.depth > 0) {
+      return;
+    }
+    __asm__ __volatile__("" ::: "memory");
+    slot.state = 0;
+  }
+
+  // Advances the global epoch if every thread that is currently within a
+  // guard has announced it. Returns the (possibly new) global epoch.
+  static uint64_t try_advance(void);
+
+ private:
+  static const uint64_t kActive = 1;
+  // Number of outermost enters after which a thread tries to advance the
+  // global epoch.
+  static const uint64_t kAdvanceInterval = 64;
+
+  struct Slot {
+    volatile uint64_t state;  // (announced epoch << 1) | kActive
+    uint64_t depth;
+    uint64_t num_enters;
+    bool registered;
+    uint8_t padding[kCachePrefetch - 3 * sizeof(uint64_t) - sizeof(bool)];
+  };
+
+  static void register_slot(uint64_t thread_id, Slot *slot);
+
+  static bool enabled_;
+  static volatile uint64_t global_epoch_;
+  // One more than the largest id of a thread that has ever entered.
+  static volatile uint64_t num_slots_;
+  static ThreadArray<Slot> slots_;
+};
+
+// Keeps the calling thread within the current epoch while in scope.
+class EpochGuard {
+ public:
+  inline EpochGuard() {
+    if (Epoch::enabled()) {
+      Epoch::enter();
+    }
+  }
+
+  inline ~EpochGuard() {
+    if (Epoch::enabled()) {
+      Epoch::exit();
+    }
+  }
+
+ private:
+  EpochGuard(const EpochGuard &cpy);
+  void operator=(const EpochGuard &rhs);
+};
+
+// Objects of type T that are retired by a data structure and handed out for
+// reuse once no thread can reach them anymore. Objects keep their contents,
+// so the data structure has to reinitialize reused objects.
+template<typename T>
+class EpochPool {
+ public:
+  explicit EpochPool(size_t object_size = sizeof(T))
+      : objects_(object_size) {}
+
+  // Returns an object for reuse, or NULL if there is none and the caller
+  // has to allocate a new one.
+  inline T* get(void) {
+    return objects_.get();
+  }
+
+  // Retires |object|, which the calling thread has unlinked from the data
+  // structure, or which has never been linked. The caller has to be within
+  // an EpochGuard.
+  void retire(T *object);
+
+ private:
+  typedef typename ObjectPool<T>::Batch Batch;
+
+  // Number of epochs an object has to wait, plus one.
+  static const uint64_t kNumLimbos = 3;
+  // Number of retired objects after which a thread tries to advance the
+  // global epoch.
+  static const uint64_t kAdvanceInterval = 16;
+
+  struct ThreadState {
+    // Batches retired in epoch limbo_epochs[e % kNumLimbos].
+    Batch *limbos[kNumLimbos];
+    uint64_t limbo_epochs[kNumLimbos];
+    uint64_t num_retired;
+  };
+
+  ThreadState* state(void);
+
+  ThreadArray<ThreadState*> states_;
+  ObjectPool<T> objects_;
+};
+
+template<typename T>
+typename EpochPool<T>::ThreadState* EpochPool<T>::state(void) {
+  uint64_t thread_id = ThreadContext::get().thread_id();
+  if (states_[thread_id] == NULL) {
+    // Allocated by the owner to keep it in its local memory.
+    states_[thread_id] = static_cast<ThreadState*>(tlcalloc_aligned(
+        1, sizeof(ThreadState), kCachePrefetch));
+  }
+  return states_[thread_id];
+}
+
+template<typename T>
+void EpochPool<T>::retire(T *object) {
+  ThreadState *state = this->state();
+  if ((++state->num_retired % kAdvanceInterval) == 0) {
+    Epoch::try_advance();
+  }
+  uint64_t epoch = Epoch::current();
+  for (uint64_t i = 0; i < kNumLimbos; i++) {
+    // Objects retired two epochs ago are unreachable.
+    if (state->limbos[i] != NULL && state->limbo_epochs[i] + 2 <= epoch) {
+      objects_.release(state->limbos[i]);
+      state->limbos[i] = NULL;
+    }
+  }
+  uint64_t limbo = epoch % kNumLimbos;
+  state->limbo_epochs[limbo] = epoch;
+  Batch *batch = state->limbos[limbo];
+  if (batch == NULL || batch->size == ObjectPool<T>::kBatchSize) {
+    Batch *batch_new = objects_.batch_new();
+    batch_new->next = batch;
+    batch = batch_new;
+    state->limbos[limbo] = batch;
+  }
+  batch->objects[batch->size++] = object;
+  Unreclaimed::add(objects_.object_size());
+}
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_EPOCH_H_
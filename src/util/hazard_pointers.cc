@@ -0,0 +1,46 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/hazard_pointers.h"
+
+#include <stdint.h>
+
+namespace scal {
+
+bool HazardPointers::enabled_ = false;
+volatile uint64_t HazardPointers::num_slots_ = 0;
+ThreadArray<HazardPointers::Slot> HazardPointers::slots_;
+
+void HazardPointers::set_enabled(bool enabled) {
+  enabled_ = enabled;
+}
+
+void HazardPointers::register_slot(uint64_t thread_id, Slot *slot) {
+  uint64_t num_slots;
+  do {
+    num_slots = num_slots_;
+  } while (num_slots <= thread_id &&
+           !__sync_bool_compare_and_swap(&num_slots_, num_slots,
+                                         thread_id + 1));
+  slot->registered = true;
+}
+
+uint64_t HazardPointers::collect(void **hazards, uint64_t num_slots) {
+  uint64_t num_hazards = 0;
+  for (uint64_t i = 0; i < num_slots; i++) {
+    Slot *slot = slots_.find(i);
+    if (slot == NULL) {
+      continue;
+    }
+    for (uint64_t j = 0; j < kHazards; j++) {
+      void *hazard = slot->hazards[j];
+      if (hazard != NULL) {
+        hazards[num_hazards++] = hazard;
+      }
+    }
+  }
+  return num_hazards;
+}
+
+}  // namespace scal
@@ -0,0 +1,243 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Hazard pointers, as described in:
+//
+// M. Michael. Hazard pointers: Safe memory reclamation for lock-free objects.
+// IEEE Transactions on Parallel and Distributed Systems, 15(6):491-504,
+// 2004.
+//
+// Before dereferencing a shared pointer, a thread publishes it as one of its
+// hazard pointers and validates that the pointer is still reachable. Objects
+// unlinked from a data structure are retired into the retiring thread's list
+// (HazardPool), which is scanned against all published hazard pointers once
+// it is long enough. Objects that are not protected are handed out for
+// reuse. Unlike with epochs, a thread that stalls within an operation only
+// keeps the objects it protects from being reused, so the number of retired
+// but unreclaimed objects is bounded by O(threads^2 * hazards). Slots belong
+// to thread ids, so a thread that exits with pointers still published keeps
+// them protected until its id is reused.
+//
+// Hazard pointers are disabled by default, in which case protecting a
+// pointer does nothing.
+
+#ifndef SCAL_UTIL_HAZARD_POINTERS_H_
+#define SCAL_UTIL_HAZARD_POINTERS_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "util/malloc.h"
+#include "util/object_pool.h"
+#include "util/platform.h"
+#include "util/thread_array.h"
+#include "util/threadlocals.h"
+
+namespace scal {
+
+class HazardPointers {
+ public:
+  // Hazard pointers per thread.
+  static const uint64_t kHazards = 2;
+
+  // Enables or disables hazard pointers. Must not be changed while threads
+  // operate on data structures.
+  static void set_enabled(bool enabled);
+
+  static inline bool enabled(void) {
+    return enabled_;
+  }
+
+  // Publishes |pointer| as hazard pointer |index| of the calling thread.
+  static inline void set(uint64_t index, void *pointer) {
+    uint64_t thread_id = ThreadContext::get().thread_id();
+    Slot &slot = slots_[thread_id];
+    if (!slot.registered) {
+      register_slot(thread_id, &slot);
+    }
+    slot.hazards[index] = pointer;
+    // The hazard pointer has to be visible before it is validated.
+    __sync_synchronize();
+  }
+
+  // Publishes |pointer| as hazard pointer |index| if hazard pointers are
+  // enabled. The caller has to validate afterwards that |pointer| has not
+  // been unlinked in the meantime.
+  static inline void publish(uint64_t index, void *pointer) {
+    if (enabled_) {
+      set(index, pointer);
+    }
+  }
+
+  // Protects the pointer of |snapshot|, which has been read from |source|,
+  // with hazard pointer |index|. Returns false if |source| has changed in
+  // the meantime, in which case the pointer may already be retired and the
+  // caller has to read |source| again. Always succeeds if hazard pointers
+  // are disabled.
+  template<typename P, typename S>
+  static inline bool protect(uint64_t index, const P &snapshot, S *source) {
+    if (!enabled_) {
+      return true;
+    }
+    set(index, snapshot.value());
+    return snapshot.raw() == source->raw();
+  }
+
+  // Number of thread slots that have to be scanned.
+  static inline uint64_t num_slots(void) {
+    return num_slots_;
+  }
+
+  // Copies the non-NULL hazard pointers of the first |num_slots| slots into
+  // |hazards|, which has room for |num_slots| * kHazards pointers, and
+  // returns their number. |num_slots| has to be read after the retired
+  // objects have been unlinked and a full barrier.
+  static uint64_t collect(void **hazards, uint64_t num_slots);
+
+ private:
+  struct Slot {
+    void * volatile hazards[kHazards];
+    bool registered;
+    uint8_t padding[kCachePrefetch - kHazards * sizeof(void*) - sizeof(bool)];
+  };
+
+  static void register_slot(uint64_t thread_id, Slot *slot);
+
+  static bool enabled_;
+  // One more than the largest id of a thread that has ever published a
+  // hazard pointer.
+  static volatile uint64_t num_slots_;
+  static ThreadArray<Slot> slots_;
+};
+
+// Objects of type T that are retired by a data structure and handed out for
+// reuse once no thread protects them anymore. Objects keep their contents,
+// so the data structure has to reinitialize reused objects.
+template<typename T>
+class HazardPool {
+ public:
+  explicit HazardPool(size_t object_size = sizeof(T))
+      : objects_(object_size) {}
+
+  // Returns an object for reuse, or NULL if there is none and the caller
+  // has to allocate a new one.
+  inline T* get(void) {
+    return objects_.get();
+  }
+
+  // Retires |object|, which the calling thread has unlinked from the data
+  // structure, or which has never been linked.
+  void retire(T *object);
+
+ private:
+  typedef typename ObjectPool<T>::Batch Batch;
+
+  struct ThreadState {
+    // Retired objects that have not been scanned or were protected at the
+    // last scan.
+    Batch *retired;
+    uint64_t num_retired;
+    // Scan threshold.
+    uint64_t max_retired;
+    // Room for the hazard pointers of |max_slots| threads.
+    void **hazards;
+    uint64_t max_slots;
+  };
+
+  ThreadState* state(void);
+  void scan(ThreadState *state);
+
+  ThreadArray<ThreadState*> states_;
+  ObjectPool<T> objects_;
+};
+
+template<typename T>
+typename HazardPool<T>::ThreadState* HazardPool<T>::state(void) {
+  uint64_t thread_id = ThreadContext::get().thread_id();
+  if (states_[thread_id] == NULL) {
+    // Allocated by the owner to keep it in its local memory.
+    states_[thread_id] = static_cast<ThreadState*>(tlcalloc_aligned(
+        1, sizeof(ThreadState), kCachePrefetch));
+  }
+  return states_[thread_id];
+}
+
+template<typename T>
+void HazardPool<T>::retire(T *object) {
+  ThreadState *state = this->state();
+  Batch *batch = state->retired;
+  if (batch == NULL || batch->size == ObjectPool<T>::kBatchSize) {
+    Batch *batch_new = objects_.batch_new();
+    batch_new->next = batch;
+    batch = batch_new;
+    state->retired = batch;
+  }
+  batch->objects[batch->size++] = object;
+  state->num_retired++;
+  Unreclaimed::add(objects_.object_size());
+  if (state->num_retired >= state->max_retired) {
+    scan(state);
+  }
+}
+
+template<typename T>
+void HazardPool<T>::scan(ThreadState *state) {
+  // Retired objects have to be unlinked before the slots are counted.
+  __sync_synchronize();
+  uint64_t num_slots = HazardPointers::num_slots();
+  if (num_slots > state->max_slots) {
+    // Grows with the number of threads. The old room is not freed, as
+    // tlmalloc memory never is.
+    state->max_slots = 2 * num_slots;
+    state->hazards = static_cast<void**>(tlmalloc_aligned(
+        state->max_slots * HazardPointers::kHazards * sizeof(void*),
+        kCachePrefetch));
+  }
+  void **hazards = state->hazards;
+  uint64_t num_hazards = HazardPointers::collect(hazards, num_slots);
+  std::sort(hazards, hazards + num_hazards);
+  Batch *retired = state->retired;
+  Batch *kept = NULL;
+  Batch *reclaimed = NULL;
+  uint64_t num_kept = 0;
+  while (retired != NULL) {
+    for (uint64_t i = 0; i < retired->size; i++) {
+      T *object = retired->objects[i];
+      Batch **list = &reclaimed;
+      if (std::binary_search(hazards, hazards + num_hazards,
+                             static_cast<void*>(object))) {
+        list = &kept;
+        num_kept++;
+      }
+      if (*list == NULL || (*list)->size == ObjectPool<T>::kBatchSize) {
+        Batch *batch_new = objects_.batch_new();
+        batch_new->next = *list;
+        *list = batch_new;
+      }
+      (*list)->objects[(*list)->size++] = object;
+    }
+    Batch *next = retired->next;
+    objects_.batch_delete(retired);
+    retired = next;
+  }
+  if (reclaimed != NULL) {
+    objects_.release(reclaimed);
+  }
+  state->retired = kept;
+  state->num_retired = num_kept;
+  // Scanning only pays off if a constant fraction of the scanned objects
+  // can be reclaimed, which holds once there are at least twice as many
+  // retired objects as hazard pointers.
+  state->max_retired =
+      2 * HazardPointers::kHazards * HazardPointers::num_slots() + num_kept;
+  if (state->max_retired < ObjectPool<T>::kBatchSize) {
+    state->max_retired = ObjectPool<T>::kBatchSize;
+  }
+}
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_HAZARD_POINTERS_H_
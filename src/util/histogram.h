@@ -0,0 +1,134 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_UTIL_HISTOGRAM_H_
+#define SCAL_UTIL_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+
+namespace scal {
+
+// Log-bucketed histogram, e.g., for operation latencies measured in cycles.
+//
+// Values are grouped into power-of-two ranges that are each split into
+// kSubBuckets linear sub-buckets. Values below 2 * kSubBuckets are recorded
+// exactly, larger values with a relative error of at most 1/kSubBuckets.
+// Recording a value is a couple of arithmetic operations and an increment, so
+// every worker thread can keep its own histogram that is merged afterwards.
+class Histogram {
+ public:
+  static const uint64_t kSubBucketBits = 4;
+  static const uint64_t kSubBuckets = 1 << kSubBucketBits;
+  static const uint64_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  Histogram() {
+    reset();
+  }
+
+  inline void reset() {
+    memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+  }
+
+  inline void add(uint64_t value) {
+    buckets_[bucket_index(value)]++;
+    count_++;
+    sum_ += value;
+    if (value < min_) {
+      min_ = value;
+    }
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  void merge(const Histogram &other) {
+    for (uint64_t i = 0; i < kNumBuckets; i++) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if (other.min_ < min_) {
+      min_ = other.min_;
+    }
+    if (other.max_ > max_) {
+      max_ = other.max_;
+    }
+  }
+
+  inline uint64_t count() const {
+    return count_;
+  }
+
+  inline uint64_t min() const {
+    return (count_ == 0) ? 0 : min_;
+  }
+
+  inline uint64_t max() const {
+    return max_;
+  }
+
+  inline double mean() const {
+    return (count_ == 0) ? 0 : static_cast<double>(sum_) / count_;
+  }
+
+  // Returns the value below or at which |p| percent of all recorded values
+  // fall, rounded up to the upper bound of the containing bucket.
+  uint64_t percentile(double p) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+    if (rank == 0) {
+      rank = 1;
+    }
+    if (rank > count_) {
+      rank = count_;
+    }
+    uint64_t seen = 0;
+    for (uint64_t i = 0; i < kNumBuckets; i++) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        uint64_t upper = bucket_upper_bound(i);
+        return (upper < max_) ? upper : max_;
+      }
+    }
+    return max_;
+  }
+
+ private:
+  static inline uint64_t bucket_index(uint64_t value) {
+    if (value < kSubBuckets) {
+      return value;
+    }
+    uint64_t msb = 63 - __builtin_clzll(value);
+    uint64_t shift = msb - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+  }
+
+  static inline uint64_t bucket_upper_bound(uint64_t index) {
+    if (index < 2 * kSubBuckets) {
+      return index;
+    }
+    uint64_t shift = index / kSubBuckets - 1;
+    uint64_t lower = (kSubBuckets + index % kSubBuckets) << shift;
+    return lower + ((1ul << shift) - 1);
+  }
+
+  uint64_t buckets_[kNumBuckets];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_HISTOGRAM_H_
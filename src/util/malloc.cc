@@ -13,30 +13,185 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <string>
+
+#include "util/time.h"
 
 DEFINE_bool(reuse_memory, true, "reuse memory, no matter what");
 DEFINE_bool(disable_tl_allocator, false, "all thread local calls are mapped"
                                          " to malloc");
+DEFINE_string(prefault, "populate", "how thread-local memory is faulted in: "
+              "populate (mmap with MAP_POPULATE) or touch (write one word "
+              "per page)");
+DEFINE_string(numa_arenas, "first_touch", "NUMA placement of thread-local "
+              "memory: first_touch (where the thread faults it in), local "
+              "(bound to the thread's node), or interleave");
+DEFINE_string(huge_pages, "none", "back thread-local memory and aligned "
+              "allocations with 2MB pages: none, thp (transparent huge "
+              "pages), or hugetlb (reserved huge pages for thread-local "
+              "memory, thp otherwise); other than none also makes malloc "
+              "grow the heap of the whole process in 32MB steps");
+DEFINE_bool(size_classes, false, "serve thread-local allocations of up to a "
+            "page from per-thread size-class free lists, so that memory "
+            "returned through tlfree is reused");
 
 namespace {
 
+// Size classes are multiples of 16 bytes up to 128 bytes, and then four
+// classes per power of two up to a page.
+const uint64_t kNumSizeClasses = 28;
+const uint64_t kSizeClasses[kNumSizeClasses] = {
+  16, 32, 48, 64, 80, 96, 112, 128,
+  160, 192, 224, 256, 320, 384, 448, 512,
+  640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+  2560, 3072, 3584, 4096
+};
+// Objects of a size class are carved from spans, which start with a Span
+// header and are aligned to their size, so that the header of an object is
+// found by masking its address.
+const uint64_t kSpanSize = 64 * 1024;
+// Objects freed by a thread other than the owner are returned to the owner
+// in batches of this size.
+const uint64_t kRemoteBatchSize = 64;
+// Threads that keep remote batches for each other. Indices of exited
+// threads are reused.
+const uint64_t kMaxRemoteOwners = 1024;
+// Memory a buffer grows by once it is used up, if size classes are used.
+const uint64_t kSpanGrowth = 16 * kSpanSize;
+
+// A free object of any size class.
+struct FreeObject {
+  FreeObject *next;
+  // Next batch in an owner's inbox, only used by the first object of a
+  // batch.
+  FreeObject *next_batch;
+};
+
+struct RemoteList {
+  FreeObject *head;
+  uint64_t count;
+};
+
+// Memory a buffer has grown by, freed when the buffer is reset.
+struct GrownChunk {
+  void *memory;
+  GrownChunk *next;
+};
+
 struct MemBuffer {
   void* memory;
   size_t mem_size;
   void* pointer;
   void* start;
-  uint64_t wrap_around_cnt;
+  size_t start_size;
   uint64_t last_size;
+  // Memory allocated since the last reset, beyond the initial buffer.
+  GrownChunk *grown;
+  scal::AllocStats stats;
+  // Whether the fallback warning has been printed.
+  bool warned;
+  uint64_t prefault_time;
+  // Range of 2MB blocks already advised to use transparent huge pages.
+  uint64_t advised_start;
+  uint64_t advised_end;
+  // Size classes (see FLAGS_size_classes).
+  uint64_t index;
+  void *last_object;
+  FreeObject *free_lists[kNumSizeClasses];
+  // Part of the current span of each class that has not been handed out.
+  uint64_t span_pointers[kNumSizeClasses];
+  uint64_t span_ends[kNumSizeClasses];
+  // Objects of other threads freed by this thread, indexed by owner.
+  RemoteList *remote;
+  // Batches of this thread's objects freed by other threads.
+  FreeObject * volatile inbox __attribute__((aligned(128)));
+};
+
+struct Span {
+  MemBuffer *owner;
+  uint64_t size_class;
+};
+
+enum HugePages {
+  kNoHugePages,
+  kTransparentHugePages,
+  kHugetlbPages
 };
 
 const void* kWord;
 const uint64_t kPageSize = 4096;
 const uint64_t kTLABSize = kPageSize;  // carefull!!
+const uint64_t kHugePageSize = 2 * 1024 * 1024;
 pthread_once_t key_once = PTHREAD_ONCE_INIT;
 pthread_key_t talloc_key;
+pthread_once_t top_pad_once = PTHREAD_ONCE_INIT;
+pthread_mutex_t indices_lock = PTHREAD_MUTEX_INITIALIZER;
+uint64_t used_indices[kMaxRemoteOwners / 64];
+
+// Pushes the batch starting at |object| to the inbox of |owner|.
+void push_batch(MemBuffer *owner, FreeObject *object) {
+  FreeObject *inbox;
+  do {
+    inbox = owner->inbox;
+    object->next_batch = inbox;
+  } while (!__sync_bool_compare_and_swap(&owner->inbox, inbox, object));
+}
+
+inline Span* span_of(void *object) {
+  return reinterpret_cast<Span*>(
+      reinterpret_cast<uint64_t>(object) & ~(kSpanSize - 1));
+}
+
+// Lets a new thread take over the index of an exited thread. The buffer
+// itself stays, since other threads may still free its objects, which are
+// from then on returned unbatched. Objects that other threads have already
+// batched under the index may end up with the new owner, which reuses them
+// like its own. Partial batches of objects the thread has freed for others
+// are returned first, since nobody else would.
+void release_buffer(void *mem) {
+  MemBuffer *buffer = static_cast<MemBuffer*>(mem);
+  if (buffer->remote != NULL) {
+    for (uint64_t i = 0; i < kMaxRemoteOwners; i++) {
+      FreeObject *head = buffer->remote[i].head;
+      if (head != NULL) {
+        push_batch(span_of(head)->owner, head);
+      }
+    }
+    free(buffer->remote);
+    buffer->remote = NULL;
+  }
+  uint64_t index = buffer->index;
+  if (index >= kMaxRemoteOwners) {
+    return;
+  }
+  buffer->index = kMaxRemoteOwners;
+  pthread_mutex_lock(&indices_lock);
+  used_indices[index / 64] &= ~(1ul << (index % 64));
+  pthread_mutex_unlock(&indices_lock);
+}
 
 void make_pthread_key(void) {
-  pthread_key_create(&talloc_key, NULL);
+  pthread_key_create(&talloc_key, release_buffer);
+}
+
+// Returns the smallest unused index, or kMaxRemoteOwners if all are used.
+uint64_t index_new(void) {
+  uint64_t index = kMaxRemoteOwners;
+  pthread_mutex_lock(&indices_lock);
+  for (uint64_t i = 0; i < kMaxRemoteOwners / 64; i++) {
+    if (~used_indices[i] != 0) {
+      uint64_t bit = __builtin_ctzll(~used_indices[i]);
+      used_indices[i] |= 1ul << bit;
+      index = i * 64 + bit;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&indices_lock);
+  return index;
 }
 
 inline size_t align_size(uint64_t size, uint64_t alignment) {
@@ -60,17 +215,251 @@ MemBuffer* tl_buffer_get(void) {
       perror("malloc");
       abort();
     }
-    buffer->memory = NULL;
-    buffer->pointer = NULL;
+    // No memory, no counters, and empty free lists.
+    memset(buffer, 0, sizeof(*buffer));
     if (pthread_setspecific(talloc_key, buffer)) {
       perror("pthread_setspecific");
       abort();
     }
-    buffer->last_size = 0;
+    buffer->index = index_new();
   }
   return buffer;
 }
 
+HugePages huge_pages(void) {
+  if (FLAGS_huge_pages == "none") {
+    return kNoHugePages;
+  } else if (FLAGS_huge_pages == "thp") {
+    return kTransparentHugePages;
+  } else if (FLAGS_huge_pages == "hugetlb") {
+    return kHugetlbPages;
+  }
+  fprintf(stderr, "%s: error: unknown huge pages %s\n",
+          __func__, FLAGS_huge_pages.c_str());
+  abort();
+}
+
+// Lets the heap extend over blocks in advance, so that they can be advised
+// before malloc touches them. This applies to every malloc of the process,
+// so it is only done with --huge_pages.
+void grow_heap_in_huge_steps(void) {
+  mallopt(M_TOP_PAD, 16 * kHugePageSize);
+}
+
+// Advises the kernel to back the 2MB blocks overlapping [mem, mem + size)
+// with transparent huge pages. The advice reaches one block further, since
+// malloc writes the header of the next chunk before it is returned, and a
+// block that has been faulted in with small pages stays so. Unmapped parts,
+// e.g., beyond the end of the heap, are skipped by the kernel. Consecutive
+// allocations mostly fall into blocks that have been advised already.
+void advise_huge_pages(MemBuffer *buffer, void *mem, size_t size) {
+  uint64_t start = reinterpret_cast<uint64_t>(mem) & ~(kHugePageSize - 1);
+  uint64_t end = align_size(reinterpret_cast<uint64_t>(mem) + size,
+                            kHugePageSize) + kHugePageSize;
+  if (start >= buffer->advised_start && end <= buffer->advised_end) {
+    return;
+  }
+  madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE);
+  buffer->advised_start = start;
+  buffer->advised_end = end;
+}
+
+// Maps |size| bytes aligned to |alignment|, which is a multiple of the page
+// size, by trimming a larger mapping.
+void* mmap_aligned(size_t size, size_t alignment, int flags) {
+  void *mem = mmap(NULL, size + alignment, PROT_READ | PROT_WRITE, flags,
+                   -1, 0);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    abort();
+  }
+  uint64_t start = reinterpret_cast<uint64_t>(mem);
+  uint64_t aligned = align_size(start, alignment);
+  if (aligned > start) {
+    munmap(mem, aligned - start);
+  }
+  if (start + alignment > aligned) {
+    munmap(reinterpret_cast<void*>(aligned + size),
+           start + alignment - aligned);
+  }
+  return reinterpret_cast<void*>(aligned);
+}
+
+inline void account(size_t requested, size_t consumed) {
+  pthread_once(&key_once, make_pthread_key);
+  MemBuffer *buffer = tl_buffer_get();
+  buffer->stats.requested += requested;
+  buffer->stats.consumed += consumed;
+}
+
+// Takes |size| bytes aligned to |alignment| from the thread-local buffer.
+// Only the gap skipped for alignment is accounted as consumed.
+void* bump_aligned(MemBuffer *buffer, size_t size, size_t alignment) {
+  scal::AllocStats &stats = buffer->stats;
+  uint64_t old_pointer = (uint64_t)(buffer->pointer);
+  uint64_t new_pointer = align_size(old_pointer, alignment);
+
+  uint64_t memory_adr = (uint64_t)(buffer->memory);
+  if (buffer->memory == NULL
+      || ((new_pointer + size) > (memory_adr + buffer->mem_size))) {
+    // Live objects of size classes may be anywhere in the buffer, so it
+    // grows instead.
+    if (FLAGS_reuse_memory && !FLAGS_size_classes) {
+      buffer->memory = buffer->start;
+      buffer->pointer = buffer->memory;
+      stats.wrap_arounds++;
+    } else {
+      if (!buffer->warned) {
+        fprintf(stderr,
+                "warning: tlalloc is dynamically allocating memory\n");
+        buffer->warned = true;
+      }
+      stats.fallbacks++;
+      buffer->mem_size = std::max(
+          FLAGS_size_classes ? kSpanGrowth : kTLABSize, size);
+      if (posix_memalign(&buffer->memory, std::max(kPageSize, alignment),
+                         buffer->mem_size)) {
+        perror("posix_memalign");
+        abort();
+      }
+      GrownChunk *chunk = static_cast<GrownChunk*>(malloc(sizeof(*chunk)));
+      if (chunk == NULL) {
+        perror("malloc");
+        abort();
+      }
+      chunk->memory = buffer->memory;
+      chunk->next = buffer->grown;
+      buffer->grown = chunk;
+      buffer->pointer = buffer->memory;
+    }
+    old_pointer = reinterpret_cast<uint64_t>(buffer->pointer);
+    new_pointer = align_size(old_pointer, alignment);
+  }
+  buffer->pointer = reinterpret_cast<void*>(new_pointer + size);
+  stats.consumed += new_pointer - old_pointer;
+  stats.alignment_waste += new_pointer - old_pointer;
+  stats.bumped += (new_pointer - old_pointer) + size;
+  return reinterpret_cast<void*>(new_pointer);
+}
+
+// Returns the smallest size class of at least |size| bytes whose objects
+// are aligned to |alignment|, which is a power of two of at most a page.
+inline uint64_t size_class(size_t size, size_t alignment) {
+  uint64_t c = std::lower_bound(kSizeClasses, kSizeClasses + kNumSizeClasses,
+                                size) - kSizeClasses;
+  while (kSizeClasses[c] % alignment != 0) {
+    c++;
+  }
+  return c;
+}
+
+// Moves the objects other threads have freed to the free lists.
+void drain_inbox(MemBuffer *buffer) {
+  FreeObject *batch = __sync_lock_test_and_set(&buffer->inbox, NULL);
+  while (batch != NULL) {
+    FreeObject *next_batch = batch->next_batch;
+    FreeObject *object = batch;
+    while (object != NULL) {
+      FreeObject *next = object->next;
+      uint64_t c = span_of(object)->size_class;
+      object->next = buffer->free_lists[c];
+      buffer->free_lists[c] = object;
+      object = next;
+    }
+    batch = next_batch;
+  }
+}
+
+void* class_malloc(MemBuffer *buffer, uint64_t c, size_t requested) {
+  buffer->stats.requested += requested;
+  FreeObject *object = buffer->free_lists[c];
+  if (object == NULL && buffer->inbox != NULL) {
+    drain_inbox(buffer);
+    object = buffer->free_lists[c];
+  }
+  if (object != NULL) {
+    buffer->free_lists[c] = object->next;
+    buffer->last_object = object;
+    return object;
+  }
+  const uint64_t size = kSizeClasses[c];
+  if (buffer->span_pointers[c] + size > buffer->span_ends[c]) {
+    Span *span = static_cast<Span*>(
+        bump_aligned(buffer, kSpanSize, kSpanSize));
+    span->owner = buffer;
+    span->size_class = c;
+    // Objects are aligned to the largest power of two dividing their size.
+    const uint64_t offset = size & -size;
+    buffer->span_pointers[c] = reinterpret_cast<uint64_t>(span) + offset;
+    buffer->span_ends[c] = reinterpret_cast<uint64_t>(span) + kSpanSize;
+    // The header and the tail that does not fit an object are lost.
+    buffer->stats.consumed += offset + (kSpanSize - offset) % size;
+  }
+  void *mem = reinterpret_cast<void*>(buffer->span_pointers[c]);
+  buffer->span_pointers[c] += size;
+  buffer->stats.consumed += size;
+  buffer->last_object = mem;
+  return mem;
+}
+
+// Takes an object of more than a page from malloc, which is aligned to
+// |alignment| if it is not 0.
+void* large_malloc(MemBuffer *buffer, size_t size, size_t alignment,
+                   size_t requested) {
+  buffer->stats.requested += requested;
+  buffer->stats.consumed += size;
+  buffer->stats.fallbacks++;
+  void *mem;
+  if (alignment == 0) {
+    mem = malloc(size);
+  } else if (posix_memalign(&mem, alignment, size) != 0) {
+    mem = NULL;
+  }
+  if (mem == NULL) {
+    perror("malloc");
+    abort();
+  }
+  if (FLAGS_size_classes) {
+    // Lets tl_free_last free it.
+    buffer->last_size = size;
+    buffer->last_object = mem;
+  }
+  return mem;
+}
+
+// Returns |object| to its owner, in batches if the owner is another thread.
+void class_free(MemBuffer *buffer, void *mem) {
+  FreeObject *object = static_cast<FreeObject*>(mem);
+  Span *span = span_of(object);
+  MemBuffer *owner = span->owner;
+  if (owner == buffer) {
+    buffer->stats.local_frees++;
+    object->next = buffer->free_lists[span->size_class];
+    buffer->free_lists[span->size_class] = object;
+    return;
+  }
+  buffer->stats.remote_frees++;
+  RemoteList *list = NULL;
+  if (owner->index < kMaxRemoteOwners) {
+    if (buffer->remote == NULL) {
+      buffer->remote = static_cast<RemoteList*>(
+          calloc(kMaxRemoteOwners, sizeof(RemoteList)));
+    }
+    list = &buffer->remote[owner->index];
+    object->next = list->head;
+    list->head = object;
+    if (++list->count < kRemoteBatchSize) {
+      return;
+    }
+    object = list->head;
+    list->head = NULL;
+    list->count = 0;
+  } else {
+    object->next = NULL;
+  }
+  push_batch(owner, object);
+}
+
 }  // namespace
 
 namespace scal {
@@ -126,66 +515,176 @@ void* malloc_aligned(size_t size, size_t alignment) {
         __func__);
     abort();
   }
+  account(size, align_size(size, alignment));
+  if (FLAGS_huge_pages != "none") {
+    pthread_once(&key_once, make_pthread_key);
+    pthread_once(&top_pad_once, grow_heap_in_huge_steps);
+    advise_huge_pages(tl_buffer_get(), mem, size);
+  }
   return mem;
 }
 
 void* calloc_aligned(size_t num, size_t size, size_t alignment) {
   void *mem = malloc_aligned(num * size, alignment);
-  memset(mem, 0, align_size(num * size, alignment));
+  // Only |num| * |size| bytes are allocated, the alignment is not padding.
+  memset(mem, 0, num * size);
+  return mem;
+}
+
+void* malloc_on_node(size_t size, int node) {
+  const size_t mapped = align_size(size, kPageSize);
+  void *mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    abort();
+  }
+  numa_place(mem, mapped, node);
+  account(size, mapped);
   return mem;
 }
 
+AllocStats alloc_stats(void) {
+  pthread_once(&key_once, make_pthread_key);
+  MemBuffer *buffer = tl_buffer_get();
+  return buffer->stats;
+}
+
+uint64_t peak_rss(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  // ru_maxrss is in kB.
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+uint64_t huge_page_bytes(void) {
+  FILE *f = fopen("/proc/self/smaps_rollup", "r");
+  if (f == NULL) {
+    return 0;
+  }
+  uint64_t bytes = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    unsigned long kb;
+    if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+        sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+        sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1) {
+      bytes += static_cast<uint64_t>(kb) * 1024;
+    }
+  }
+  fclose(f);
+  return bytes;
+}
+
 void tlalloc_init(uint64_t num_tlabs, bool touch_pages) {
   if (FLAGS_disable_tl_allocator) {
     return;
   }
+  const bool populate = (FLAGS_prefault == "populate");
+  if (!populate && FLAGS_prefault != "touch") {
+    fprintf(stderr, "%s: error: unknown prefault method %s\n",
+            __func__, FLAGS_prefault.c_str());
+    abort();
+  }
+  int node = kNumaFirstTouch;
+  if (FLAGS_numa_arenas == "local") {
+    node = numa_current_node();
+  } else if (FLAGS_numa_arenas == "interleave") {
+    node = kNumaInterleave;
+  } else if (FLAGS_numa_arenas != "first_touch") {
+    fprintf(stderr, "%s: error: unknown NUMA placement %s\n",
+            __func__, FLAGS_numa_arenas.c_str());
+    abort();
+  }
+  HugePages huge = huge_pages();
   pthread_once(&key_once, make_pthread_key);
   MemBuffer *buffer = tl_buffer_get();
   buffer->mem_size = kTLABSize * num_tlabs;
-  buffer->memory = malloc_aligned(buffer->mem_size, kPageSize);
-  buffer->start = buffer->memory;
-  buffer->wrap_around_cnt = 0;
-  if (touch_pages) {
-    for (uint64_t i = 0; i < (buffer->mem_size / sizeof(kWord)); i++) {
-      reinterpret_cast<uint64_t*>(buffer->memory)[i] = 1;
-      reinterpret_cast<uint64_t*>(buffer->memory)[i] = 0;
+  if (huge != kNoHugePages) {
+    buffer->mem_size = align_size(buffer->mem_size, kHugePageSize);
+  }
+  uint64_t start_time = get_utime();
+  // Anonymous mappings are page aligned and zeroed, so faulting them in
+  // only needs to touch every page once. MAP_POPULATE lets the kernel do it
+  // without a page fault per page, but only before the mapping can be
+  // placed on a node or advised to use huge pages.
+  const bool prepopulate = touch_pages && populate &&
+                           (node == kNumaFirstTouch);
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  buffer->memory = MAP_FAILED;
+  if (huge == kHugetlbPages) {
+    buffer->memory = mmap(NULL, buffer->mem_size, PROT_READ | PROT_WRITE,
+                          flags | MAP_HUGETLB |
+                          (prepopulate ? MAP_POPULATE : 0),
+                          -1, 0);
+    if (buffer->memory == MAP_FAILED) {
+      static bool warned = false;
+      if (!warned) {
+        warned = true;
+        fprintf(stderr, "warning: not enough huge pages reserved (see "
+                        "/proc/sys/vm/nr_hugepages), using transparent huge "
+                        "pages\n");
+      }
+      huge = kTransparentHugePages;
+    } else {
+      flags |= MAP_HUGETLB | (prepopulate ? MAP_POPULATE : 0);
     }
   }
+  if (huge == kTransparentHugePages) {
+    buffer->memory = mmap_aligned(buffer->mem_size, kHugePageSize, flags);
+    madvise(buffer->memory, buffer->mem_size, MADV_HUGEPAGE);
+  } else if (huge == kNoHugePages) {
+    flags |= prepopulate ? MAP_POPULATE : 0;
+    buffer->memory = mmap(NULL, buffer->mem_size, PROT_READ | PROT_WRITE,
+                          flags, -1, 0);
+  }
+  if (buffer->memory == MAP_FAILED) {
+    perror("mmap");
+    abort();
+  }
+  if (node != kNumaFirstTouch) {
+    numa_place(buffer->memory, buffer->mem_size, node);
+  }
+  if (touch_pages && !(flags & MAP_POPULATE)) {
+    for (uint64_t i = 0; i < buffer->mem_size; i += kPageSize) {
+      reinterpret_cast<volatile char*>(buffer->memory)[i] = 0;
+    }
+  }
+  buffer->prefault_time = touch_pages ? get_utime() - start_time : 0;
+  buffer->start = buffer->memory;
+  buffer->start_size = buffer->mem_size;
   buffer->pointer = buffer->memory;
 }
 
+uint64_t tlalloc_prefault_time(void) {
+  pthread_once(&key_once, make_pthread_key);
+  return tl_buffer_get()->prefault_time;
+}
+
 void* tlmalloc(size_t size) {
   if (FLAGS_disable_tl_allocator) {
-    return malloc(size);
+    // Padded as thread-local objects are, which tlcalloc zeroes.
+    account(size, align_size(size, 2 * sizeof(kWord)));
+    return malloc(align_size(size, 2 * sizeof(kWord)));
   }
   pthread_once(&key_once, make_pthread_key);
+  const size_t requested = size;
   size = align_size(size, 2 * sizeof(kWord));
   if (size > kPageSize) {
-    return malloc(size);
+    return large_malloc(tl_buffer_get(), size, 0, requested);
   }
   MemBuffer *buffer = tl_buffer_get();
-  uint64_t buffer_ptr = reinterpret_cast<uint64_t>(buffer->pointer);
-  uint64_t buffer_mem = reinterpret_cast<uint64_t>(buffer->memory);
-  if ((buffer->memory == NULL)
-      || (buffer_ptr + size > buffer_mem + buffer->mem_size)) {
-    if (FLAGS_reuse_memory) {
-      buffer->memory = buffer->start;
-      buffer->pointer = buffer->memory;
-    } else {
-      fprintf(stderr, "warning: tlalloc is dynamically allocating memory\n");
-      buffer->mem_size = kTLABSize;
-      if (posix_memalign(&buffer->memory, kPageSize, buffer->mem_size)) {
-        perror("posix_memalign");
-        abort();
-      }
-      buffer->pointer = buffer->memory;
-    }
+  if (FLAGS_size_classes) {
+    buffer->last_size = size;
+    return class_malloc(buffer, size_class(size, 1), requested);
   }
-
-  void *object = buffer->pointer;
-  buffer_ptr = reinterpret_cast<uint64_t>(buffer->pointer);
-  buffer->pointer = reinterpret_cast<void*>(buffer_ptr + size);
+  // Sizes are multiples of words, so no gap is needed.
+  void *object = bump_aligned(buffer, size, 1);
   buffer->last_size = size;
+  buffer->stats.requested += requested;
+  buffer->stats.consumed += size;
   return object;
 }
 
@@ -199,7 +698,8 @@ void* tlcalloc(size_t num, size_t size) {
 
 void* tlmalloc_aligned(size_t size, size_t alignment) {
   if (FLAGS_disable_tl_allocator) {
-    return malloc_aligned(size, alignment);
+    // Padded as thread-local objects are, which tlcalloc_aligned zeroes.
+    return malloc_aligned(align_size(size, alignment), alignment);
   }
   pthread_once(&key_once, make_pthread_key);
   MemBuffer *buffer = tl_buffer_get();
@@ -214,33 +714,19 @@ void* tlmalloc_aligned(size_t size, size_t alignment) {
     alignment = 4096;
   }
 
-  uint64_t old_pointer = (uint64_t)(buffer->pointer);
-  uint64_t new_pointer = align_size(old_pointer, alignment);
+  const size_t requested = size;
   size = align_size(size, alignment);
-
-  uint64_t memory_adr = (uint64_t)(buffer->memory);
-  if (buffer->memory == NULL
-      || ((new_pointer + size) > (memory_adr + buffer->mem_size))) {
-    if (FLAGS_reuse_memory) {
-      buffer->memory = buffer->start;
-      buffer->pointer = buffer->memory;
-      buffer->wrap_around_cnt++;
-      //fprintf(stderr, "warning: overflowing\n");
-    } else {
-      fprintf(stderr, "warning: tlalloc is dynamically allocating memory\n");
-      buffer->mem_size = kTLABSize;
-      if (posix_memalign(&buffer->memory, kPageSize, buffer->mem_size)) {
-        perror("posix_memalign");
-        abort();
-      }
-      buffer->pointer = buffer->memory;
+  buffer->last_size = size;
+  if (FLAGS_size_classes) {
+    if (size > kPageSize) {
+      return large_malloc(buffer, size, alignment, requested);
     }
-    old_pointer = reinterpret_cast<uint64_t>(buffer->pointer);
-    new_pointer = align_size(old_pointer, alignment);
+    return class_malloc(buffer, size_class(size, alignment), requested);
   }
-  void *object = reinterpret_cast<void*>(new_pointer);
-  buffer->pointer = reinterpret_cast<void*>(new_pointer + size);
-  buffer->last_size = size;
+  // The gap skipped for alignment is lost as well.
+  void *object = bump_aligned(buffer, size, alignment);
+  buffer->stats.requested += requested;
+  buffer->stats.consumed += size;
   return object;
 }
 
@@ -258,16 +744,66 @@ void tl_free_last(void) {
     fprintf(stderr, "%s: error: last malloc already freed.\n", __func__);
     abort();
   }
+  if (FLAGS_size_classes) {
+    if (buffer->last_size > kPageSize) {
+      free(buffer->last_object);
+    } else {
+      class_free(buffer, buffer->last_object);
+    }
+    buffer->last_size = 0;
+    return;
+  }
   // This algorithm assumes that an object is spans continous memory.
   uint64_t old_pointer = (uint64_t)(buffer->pointer);
   buffer->pointer = reinterpret_cast<void*>(old_pointer - buffer->last_size);
   buffer->last_size = 0;
 }
 
-void tlprint_wrap_around(void) {
+void tlalloc_reset(void) {
+  if (FLAGS_disable_tl_allocator) {
+    return;
+  }
   pthread_once(&key_once, make_pthread_key);
   MemBuffer *buffer = tl_buffer_get();
-  printf("%lu\n", buffer->wrap_around_cnt);
+  // Everything allocated before is dead, including objects in memory the
+  // buffer has grown by.
+  while (buffer->grown != NULL) {
+    GrownChunk *chunk = buffer->grown;
+    buffer->grown = chunk->next;
+    free(chunk->memory);
+    free(chunk);
+  }
+  buffer->memory = buffer->start;
+  buffer->mem_size = buffer->start_size;
+  buffer->pointer = buffer->memory;
+  buffer->last_size = 0;
+  memset(buffer->free_lists, 0, sizeof(buffer->free_lists));
+  memset(buffer->span_pointers, 0, sizeof(buffer->span_pointers));
+  memset(buffer->span_ends, 0, sizeof(buffer->span_ends));
+  if (buffer->remote != NULL) {
+    memset(buffer->remote, 0, kMaxRemoteOwners * sizeof(RemoteList));
+  }
+  buffer->inbox = NULL;
+}
+
+void tlfree(void *object, size_t size) {
+  if (object == NULL) {
+    return;
+  }
+  if (FLAGS_disable_tl_allocator) {
+    free(object);
+    return;
+  }
+  if (!FLAGS_size_classes) {
+    return;
+  }
+  if (align_size(size, 2 * sizeof(kWord)) > kPageSize) {
+    // Taken from malloc (see large_malloc).
+    free(object);
+    return;
+  }
+  pthread_once(&key_once, make_pthread_key);
+  class_free(tl_buffer_get(), object);
 }
 
 }  // namespace scal
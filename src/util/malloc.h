@@ -16,10 +16,68 @@
 
 #include <new>  // placement new()
 
+#include "util/numa.h"
+
 namespace scal {
 
 uint64_t human_size_to_pages(const char *hsize, size_t len);
 
+// Bytes requested from the allocators below and bytes consumed to serve
+// them, i.e., including size and alignment padding, and how the thread-local
+// allocator served them.
+struct AllocStats {
+  uint64_t requested;
+  uint64_t consumed;
+  // Bytes the bump pointer advanced over, including alignment gaps.
+  uint64_t bumped;
+  // Times the thread-local buffer was exhausted and started over at its
+  // beginning (FLAGS_reuse_memory), overwriting objects that may be live.
+  uint64_t wrap_arounds;
+  // Allocations handed to the system allocator: objects larger than a page,
+  // and new buffers once the thread-local one is exhausted.
+  uint64_t fallbacks;
+  // Bytes skipped to align objects.
+  uint64_t alignment_waste;
+  // Objects freed through tlfree by their allocating thread, and by another
+  // thread.
+  uint64_t local_frees;
+  uint64_t remote_frees;
+
+  void add(const AllocStats &stats) {
+    requested += stats.requested;
+    consumed += stats.consumed;
+    bumped += stats.bumped;
+    wrap_arounds += stats.wrap_arounds;
+    fallbacks += stats.fallbacks;
+    alignment_waste += stats.alignment_waste;
+    local_frees += stats.local_frees;
+    remote_frees += stats.remote_frees;
+  }
+
+  void subtract(const AllocStats &stats) {
+    requested -= stats.requested;
+    consumed -= stats.consumed;
+    bumped -= stats.bumped;
+    wrap_arounds -= stats.wrap_arounds;
+    fallbacks -= stats.fallbacks;
+    alignment_waste -= stats.alignment_waste;
+    local_frees -= stats.local_frees;
+    remote_frees -= stats.remote_frees;
+  }
+};
+
+// Returns the statistics of the calling thread's allocations so far through
+// any of the allocation functions below. The counters only grow; callers
+// are interested in differences.
+AllocStats alloc_stats(void);
+
+// Peak resident set size of the process in bytes.
+uint64_t peak_rss(void);
+
+// Bytes of the process currently backed by huge pages, transparent or
+// reserved (hugetlbfs), 0 if unknown.
+uint64_t huge_page_bytes(void);
+
 // convenience methods
 void* malloc_aligned(size_t size, size_t alignment);
 void* calloc_aligned(size_t num, size_t size, size_t alignment);
@@ -41,7 +99,7 @@ template<typename T>
 T* get_aligned(uint64_t alignment) {
   void *mem;
   if (alignment == 0) {  // no alignment
-    mem = calloc(1, sizeof(T));
+    mem = calloc_aligned(1, sizeof(T), sizeof(void*));
   } else {
     mem = malloc_aligned(sizeof(T), alignment);
     memset(mem, 0, sizeof(T));
@@ -55,19 +113,44 @@ T* get(uint64_t alignment) {
   return get_aligned<T>(alignment);
 }
 
+// Returns |size| bytes of zeroed, page-aligned memory placed on NUMA node
+// |node|, or interleaved over all nodes (see util/numa.h). The memory comes
+// directly from the kernel and is padded to whole pages.
+void* malloc_on_node(size_t size, int node);
+
+// Constructs a T on NUMA node |node|. Memory the constructor allocates from
+// fresh pages preferably ends up on |node| as well.
+template<typename T>
+T* get_on_node(int node) {
+  void *mem = malloc_on_node(sizeof(T), node);
+  numa_set_thread_policy(node);
+  T *obj = new(mem) T();
+  numa_set_thread_policy(kNumaFirstTouch);
+  return obj;
+}
+
 // Threadlocal allocator:
 // Call tlalloc_init before anything else in the corresponding thread.
 // Routines are named tl<func> and tl<func>_aligned, where <func> is the
 // name of the function one would usually use, i.e. tlmalloc for
 // threadlocal malloc.
 void tlalloc_init(uint64_t num_tlabs, bool touch_pages);
+// Time (us) tlalloc_init took to fault in the calling thread's memory.
+uint64_t tlalloc_prefault_time(void);
 void* tlmalloc(size_t size);
 void* tlcalloc(size_t num, size_t size);
 void* tlmalloc_aligned(size_t size, size_t alignment);
 void* tlcalloc_aligned(size_t num, size_t size, size_t alignment);
 void tl_free_last(void);
-
-void tlprint_wrap_around(void);
+// Returns |object| of |size| bytes, as requested from tlmalloc,
+// tlmalloc_aligned or their calloc versions, for reuse by its allocating
+// thread. Any thread may free any object. Does nothing unless
+// FLAGS_size_classes is set, in which case objects larger than a page are
+// taken from and returned to malloc.
+void tlfree(void *object, size_t size);
+// Lets the calling thread's allocations start over at the beginning of its
+// (already touched) buffer. Everything allocated before must be dead.
+void tlalloc_reset(void);
 
 template<typename T>
 T* tlget_aligned(uint64_t alignment) {
@@ -0,0 +1,110 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/numa.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Nodes beyond the bits of one mask word are not supported.
+const uint64_t kMaxNodes = 8 * sizeof(unsigned long);
+
+bool g_warned = false;
+
+bool check(long ret, const char *call) {
+  if (ret != 0) {
+    if (!g_warned) {
+      g_warned = true;
+      fprintf(stderr, "warning: %s failed (%s), memory keeps the default "
+                      "NUMA placement\n", call, strerror(errno));
+    }
+    return false;
+  }
+  return true;
+}
+
+// Translates |node| into a policy and a node mask for mbind/set_mempolicy.
+int policy(int node, unsigned long *mask) {
+  if (node == scal::kNumaFirstTouch) {
+    *mask = 0;
+    return MPOL_DEFAULT;
+  }
+  if (node == scal::kNumaInterleave) {
+    uint64_t num_nodes = scal::numa_num_nodes();
+    *mask = (num_nodes >= kMaxNodes) ? ~0UL : (1UL << num_nodes) - 1;
+    return MPOL_INTERLEAVE;
+  }
+  *mask = 1UL << (node % kMaxNodes);
+  return MPOL_BIND;
+}
+
+}  // namespace
+
+namespace scal {
+
+uint64_t numa_num_nodes(void) {
+  static uint64_t num_nodes = 0;
+  if (num_nodes > 0) {
+    return num_nodes;
+  }
+  // The online nodes are a list such as "0-3" or "0,2"; the last number is
+  // the highest node.
+  num_nodes = 1;
+  FILE *f = fopen("/sys/devices/system/node/online", "r");
+  if (f != NULL) {
+    char buffer[256];
+    if (fgets(buffer, sizeof(buffer), f) != NULL) {
+      const char *last = buffer;
+      for (const char *c = buffer; *c != '\0'; c++) {
+        if (*c == '-' || *c == ',') {
+          last = c + 1;
+        }
+      }
+      num_nodes = atoi(last) + 1;
+    }
+    fclose(f);
+  }
+  return num_nodes;
+}
+
+int numa_current_node(void) {
+  unsigned cpu;
+  unsigned node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+    return 0;
+  }
+  return node;
+}
+
+bool numa_place(void *addr, size_t len, int node) {
+  unsigned long mask;
+  int mode = policy(node, &mask);
+  return check(syscall(SYS_mbind, addr, len, mode,
+                       (mode == MPOL_DEFAULT) ? NULL : &mask,
+                       kMaxNodes + 1, 0),
+               "mbind");
+}
+
+bool numa_set_thread_policy(int node) {
+  unsigned long mask;
+  int mode = policy(node, &mask);
+  // A preferred node, in contrast to numa_place(), falls back to the others
+  // when it runs out of memory.
+  if (mode == MPOL_BIND) {
+    mode = MPOL_PREFERRED;
+  }
+  return check(syscall(SYS_set_mempolicy, mode,
+                       (mode == MPOL_DEFAULT) ? NULL : &mask, kMaxNodes + 1),
+               "set_mempolicy");
+}
+
+}  // namespace scal
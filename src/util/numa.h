@@ -0,0 +1,41 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// NUMA memory placement through the mbind and set_mempolicy system calls.
+//
+// Placement is best effort: where the calls are not available (kernels
+// without NUMA support, containers without the permission) a warning is
+// printed once and memory keeps the default first-touch placement.
+
+#ifndef SCAL_UTIL_NUMA_H_
+#define SCAL_UTIL_NUMA_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace scal {
+
+// Passed as node to place memory round robin on all nodes.
+const int kNumaInterleave = -1;
+// Passed as node to place memory on the node of the thread that first
+// touches it, which is the kernel's default.
+const int kNumaFirstTouch = -2;
+
+// Number of NUMA nodes of the machine, at least 1.
+uint64_t numa_num_nodes(void);
+
+// Node of the cpu the calling thread runs on, 0 if unknown.
+int numa_current_node(void);
+
+// Places the pages of [addr, addr + len) on |node|. Only affects pages that
+// are not faulted in yet. |addr| has to be page aligned.
+bool numa_place(void *addr, size_t len, int node);
+
+// Places the pages the calling thread faults in from now on, outside of
+// ranges placed by numa_place(), preferably on |node|.
+bool numa_set_thread_policy(int node);
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_NUMA_H_
@@ -0,0 +1,34 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/object_pool.h"
+
+#include <stdint.h>
+
+namespace scal {
+
+ThreadArray<Unreclaimed::Counter> Unreclaimed::counters_;
+
+void Unreclaimed::reset(void) {
+  for (uint64_t i = 0; i < ThreadContext::num_ids(); i++) {
+    Counter *counter = counters_.find(i);
+    if (counter != NULL) {
+      counter->bytes = 0;
+      counter->peak = 0;
+    }
+  }
+}
+
+uint64_t Unreclaimed::peak(void) {
+  uint64_t peak = 0;
+  for (uint64_t i = 0; i < ThreadContext::num_ids(); i++) {
+    Counter *counter = counters_.find(i);
+    if (counter != NULL) {
+      peak += counter->peak;
+    }
+  }
+  return peak;
+}
+
+}  // namespace scal
@@ -0,0 +1,253 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Objects that have been reclaimed from a data structure, waiting to be
+// reused by it. Used by the reclamation schemes in util/epoch.h and
+// util/hazard_pointers.h.
+
+#ifndef SCAL_UTIL_OBJECT_POOL_H_
+#define SCAL_UTIL_OBJECT_POOL_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util/malloc.h"
+#include "util/platform.h"
+#include "util/thread_array.h"
+#include "util/threadlocals.h"
+
+namespace scal {
+
+// Bytes of objects that have been retired but not yet reclaimed, i.e.,
+// memory that a data structure cannot reuse, counted per retiring thread.
+class Unreclaimed {
+ public:
+  static inline void add(int64_t bytes) {
+    Counter &counter = counters_[ThreadContext::get().thread_id()];
+    counter.bytes += bytes;
+    if (counter.bytes > counter.peak) {
+      counter.peak = counter.bytes;
+    }
+  }
+
+  // Resets all counters. Must not be called while threads retire objects.
+  static void reset(void);
+
+  // Sum over all threads of the bytes each thread had retired but not
+  // reclaimed at its peak since the last reset.
+  static uint64_t peak(void);
+
+ private:
+  struct Counter {
+    int64_t bytes;
+    int64_t peak;
+    uint8_t padding[kCachePrefetch - 2 * sizeof(int64_t)];
+  };
+
+  static ThreadArray<Counter> counters_;
+};
+
+// Reclaimed objects of type T, kept per thread in batches. A thread reuses
+// the objects it has reclaimed itself first, and shares batches beyond a
+// few with other threads, since objects are often reclaimed by other threads
+// (consumers) than the ones reusing them (producers). Objects keep their
+// contents.
+template<typename T>
+class ObjectPool {
+ public:
+  static const uint64_t kBatchSize = 64;
+  // Batches of reclaimed objects a thread keeps for itself.
+  static const uint64_t kMaxLocalBatches = 2;
+
+  struct Batch {
+    Batch *next;
+    uint64_t size;
+    T *objects[kBatchSize];
+  };
+
+  // |object_size| is the memory an object stands for, including memory it
+  // points to, and is only used for accounting.
+  explicit ObjectPool(size_t object_size);
+
+  // Returns an object for reuse, or NULL if there is none and the caller
+  // has to allocate a new one.
+  T* get(void);
+
+  // Returns an empty batch, of the calling thread if it has one.
+  Batch* batch_new(void);
+
+  // Keeps the empty |batch| for later use by the calling thread.
+  void batch_delete(Batch *batch);
+
+  // Hands out the objects of the list of batches starting at |first| for
+  // reuse, by the calling thread first.
+  void release(Batch *first);
+
+  inline size_t object_size(void) const {
+    return object_size_;
+  }
+
+ private:
+  struct ThreadState {
+    // Batch of reusable objects the thread takes objects from.
+    Batch *reuse;
+    // Further batches of objects the thread has reclaimed.
+    Batch *local;
+    uint64_t num_local;
+    // Empty batches.
+    Batch *spare;
+  };
+
+  ThreadState* state(void);
+  void lock(void);
+  void unlock(void);
+
+  ThreadArray<ThreadState*> states_;
+  size_t object_size_;
+  // Batches of reusable objects. Also read without the lock, as a hint
+  // whether taking it is worthwhile.
+  Batch * volatile shared_;
+  // Empty batches left behind by threads that took objects from shared_.
+  // They are shared as well, since the threads filling batches are often
+  // not the ones emptying them.
+  Batch *shared_spare_;
+  volatile uint64_t lock_;
+};
+
+template<typename T>
+ObjectPool<T>::ObjectPool(size_t object_size) {
+  object_size_ = object_size;
+  shared_ = NULL;
+  shared_spare_ = NULL;
+  lock_ = 0;
+}
+
+template<typename T>
+typename ObjectPool<T>::ThreadState* ObjectPool<T>::state(void) {
+  uint64_t thread_id = ThreadContext::get().thread_id();
+  if (states_[thread_id] == NULL) {
+    // Allocated by the owner to keep it in its local memory.
+    states_[thread_id] = static_cast<ThreadState*>(tlcalloc_aligned(
+        1, sizeof(ThreadState), kCachePrefetch));
+  }
+  return states_[thread_id];
+}
+
+template<typename T>
+typename ObjectPool<T>::Batch* ObjectPool<T>::batch_new(void) {
+  ThreadState *state = this->state();
+  Batch *batch = state->spare;
+  if (batch != NULL) {
+    state->spare = batch->next;
+  } else {
+    if (shared_spare_ != NULL) {
+      lock();
+      batch = shared_spare_;
+      if (batch != NULL) {
+        shared_spare_ = batch->next;
+      }
+      unlock();
+    }
+    if (batch == NULL) {
+      batch = static_cast<Batch*>(tlmalloc(sizeof(Batch)));
+    }
+  }
+  batch->next = NULL;
+  batch->size = 0;
+  return batch;
+}
+
+template<typename T>
+void ObjectPool<T>::batch_delete(Batch *batch) {
+  ThreadState *state = this->state();
+  batch->next = state->spare;
+  state->spare = batch;
+}
+
+template<typename T>
+void ObjectPool<T>::lock(void) {
+  while (__sync_lock_test_and_set(&lock_, 1) != 0) {
+    while (lock_ != 0) {
+      __asm__ __volatile__("pause" ::: "memory");
+    }
+  }
+}
+
+template<typename T>
+void ObjectPool<T>::unlock(void) {
+  __sync_lock_release(&lock_);
+}
+
+template<typename T>
+void ObjectPool<T>::release(Batch *first) {
+  ThreadState *state = this->state();
+  uint64_t num_objects = 0;
+  while (first != NULL && state->num_local < kMaxLocalBatches) {
+    Batch *next = first->next;
+    num_objects += first->size;
+    first->next = state->local;
+    state->local = first;
+    state->num_local++;
+    first = next;
+  }
+  Batch *last = first;
+  while (last != NULL) {
+    num_objects += last->size;
+    if (last->next == NULL) {
+      break;
+    }
+    last = last->next;
+  }
+  Unreclaimed::add(-static_cast<int64_t>(num_objects * object_size_));
+  if (first == NULL) {
+    return;
+  }
+  lock();
+  last->next = shared_;
+  shared_ = first;
+  unlock();
+}
+
+template<typename T>
+T* ObjectPool<T>::get(void) {
+  ThreadState *state = this->state();
+  Batch *batch = state->reuse;
+  if (batch == NULL || batch->size == 0) {
+    Batch *next = state->local;
+    if (next != NULL) {
+      state->local = next->next;
+      state->num_local--;
+      if (batch != NULL) {
+        batch->next = state->spare;
+        state->spare = batch;
+      }
+    } else {
+      if (shared_ == NULL) {
+        return NULL;
+      }
+      lock();
+      next = shared_;
+      if (next != NULL) {
+        shared_ = next->next;
+        if (batch != NULL) {
+          // Emptied batches go back to the threads filling batches.
+          batch->next = shared_spare_;
+          shared_spare_ = batch;
+        }
+      }
+      unlock();
+      if (next == NULL) {
+        return NULL;
+      }
+    }
+    batch = next;
+    batch->next = NULL;
+    state->reuse = batch;
+  }
+  return batch->objects[--batch->size];
+}
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_OBJECT_POOL_H_
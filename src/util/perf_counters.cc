@@ -0,0 +1,134 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct EventConfig {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+};
+
+const EventConfig kEvents[] = {
+  { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "l1d_misses", PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D |
+    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  { "llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { "dtlb_misses", PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_DTLB |
+    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  { "task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+  { "context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+  { "cpu_migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+  { "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+int perf_event_open(const EventConfig &event) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.disabled = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // Software events such as context switches happen in the kernel.
+  if (event.type != PERF_TYPE_SOFTWARE) {
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+  }
+  // Calling thread on any cpu.
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+}  // namespace
+
+namespace scal {
+
+const char* PerfCounters::name(Event event) {
+  return kEvents[event].name;
+}
+
+PerfCounters::PerfCounters() {
+  for (uint64_t i = 0; i < kNumEvents; i++) {
+    fds_[i] = -1;
+    values_[i] = 0;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  close();
+}
+
+uint64_t PerfCounters::open(void) {
+  uint64_t available = 0;
+  for (uint64_t i = 0; i < kNumEvents; i++) {
+    fds_[i] = perf_event_open(kEvents[i]);
+    if (fds_[i] >= 0) {
+      available++;
+    }
+  }
+  return available;
+}
+
+void PerfCounters::close(void) {
+  for (uint64_t i = 0; i < kNumEvents; i++) {
+    if (fds_[i] >= 0) {
+      ::close(fds_[i]);
+      fds_[i] = -1;
+    }
+  }
+}
+
+void PerfCounters::start(void) {
+  for (uint64_t i = 0; i < kNumEvents; i++) {
+    if (fds_[i] >= 0) {
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void PerfCounters::stop(void) {
+  for (uint64_t i = 0; i < kNumEvents; i++) {
+    if (fds_[i] >= 0) {
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  for (uint64_t i = 0; i < kNumEvents; i++) {
+    values_[i] = 0;
+    if (fds_[i] < 0) {
+      continue;
+    }
+    // value, time enabled, time running
+    uint64_t data[3];
+    if (read(fds_[i], data, sizeof(data)) != sizeof(data)) {
+      continue;
+    }
+    if (data[2] == 0) {
+      continue;
+    }
+    if (data[2] < data[1]) {
+      data[0] = static_cast<uint64_t>(
+          static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+    values_[i] = data[0];
+  }
+}
+
+}  // namespace scal
@@ -0,0 +1,69 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// Per-thread performance counters based on perf_event_open(2).
+
+#ifndef SCAL_UTIL_PERF_COUNTERS_H_
+#define SCAL_UTIL_PERF_COUNTERS_H_
+
+#include <stdint.h>
+
+namespace scal {
+
+class PerfCounters {
+ public:
+  enum Event {
+    // Hardware events, which are often not permitted, e.g., in containers or
+    // virtual machines.
+    kCycles = 0,
+    kInstructions,
+    kL1dMisses,
+    kLlcMisses,
+    kBranchMisses,
+    kDtlbMisses,
+    // Software events, which are counted by the kernel and are available
+    // whenever perf events are.
+    kTaskClock,
+    kContextSwitches,
+    kCpuMigrations,
+    kPageFaults,
+    kNumEvents
+  };
+
+  static const char* name(Event event);
+
+  PerfCounters();
+  ~PerfCounters();
+
+  // Opens the counters of the calling thread, initially disabled. Events
+  // that cannot be opened are not available, so without permissions for
+  // hardware events only the software ones are counted. Returns the number
+  // of available events.
+  uint64_t open(void);
+  void close(void);
+
+  // Resets and enables all counters.
+  void start(void);
+
+  // Disables all counters and reads their values.
+  void stop(void);
+
+  inline bool available(Event event) const {
+    return fds_[event] >= 0;
+  }
+
+  // Value of |event| during the last start/stop interval, scaled up if the
+  // kernel had to multiplex the counters.
+  inline uint64_t value(Event event) const {
+    return values_[event];
+  }
+
+ private:
+  int fds_[kNumEvents];
+  uint64_t values_[kNumEvents];
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_PERF_COUNTERS_H_
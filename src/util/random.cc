@@ -23,22 +23,61 @@ inline uint64_t rdtsc(void) {
   return ((uint64_t) lo) | (((uint64_t) hi) << 32);
 }
 
-}  // namespace
+scal::RandGenerator g_generator = scal::kRandXoshiro;
 
 // Schrage minimum standard PRNG. Assumes int to be 32 bits.
 // Range: [0,kM]
-uint64_t pseudorand() {
-  int32_t seed = scal::ThreadContext::get().random_seed();
+inline uint32_t minstd_next(scal::ThreadContext *context) {
+  int32_t seed = context->random_seed();
   uint32_t hi = seed / kQ;
   uint32_t lo = seed % kQ;
   seed = kA * lo - kR * hi;
   if (seed < 0) {
     seed += kM;
   }
-  scal::ThreadContext::get().set_random_seed(seed);
+  context->set_random_seed(seed);
   return seed;
 }
 
+inline uint32_t rotl(uint32_t x, int k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+inline uint32_t xoshiro_next(uint32_t *s) {
+  const uint32_t result = rotl(s[1] * 5, 7) * 9;
+  const uint32_t t = s[1] << 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 11);
+  return result;
+}
+
+// Returns 32 random bits of the selected generator. The minimal standard
+// generator only provides 31, so its lowest bit is always 0.
+inline uint32_t next_bits(scal::ThreadContext *context) {
+  if (g_generator == scal::kRandXoshiro) {
+    return xoshiro_next(context->rand_state());
+  }
+  if (g_generator == scal::kRandHardware) {
+    // Knuth's multiplicative hash.
+    return static_cast<uint32_t>(rdtsc() >> 6) * 2654435761u;
+  }
+  return minstd_next(context) << 1;
+}
+
+inline uint64_t scale(uint32_t bits, uint32_t min, uint32_t max) {
+  return min + ((static_cast<uint64_t>(bits) * (max - min)) >> 32);
+}
+
+}  // namespace
+
+uint64_t pseudorand() {
+  return minstd_next(&scal::ThreadContext::get());
+}
+
 uint64_t pseudorandrange(uint32_t min, uint32_t max) {
   uint32_t range = max - min;
   return (static_cast<double>(pseudorand()) / (static_cast<double>(kM) + 1.0))
@@ -53,8 +92,52 @@ uint64_t hwrand(void) {
 
 namespace scal {
 
+void set_rand_generator(RandGenerator generator) {
+  g_generator = generator;
+}
+
+uint64_t rand() {
+  return next_bits(&ThreadContext::get()) >> 1;
+}
+
+uint64_t rand_range(uint32_t min, uint32_t max) {
+  return scale(next_bits(&ThreadContext::get()), min, max);
+}
+
+void rand_fill(uint64_t *values, uint64_t n) {
+  ThreadContext *context = &ThreadContext::get();
+  for (uint64_t i = 0; i < n; i++) {
+    values[i] = next_bits(context) >> 1;
+  }
+}
+
+void rand_range_fill(uint32_t min, uint32_t max, uint64_t *values,
+                     uint64_t n) {
+  ThreadContext *context = &ThreadContext::get();
+  for (uint64_t i = 0; i < n; i++) {
+    values[i] = scale(next_bits(context), min, max);
+  }
+}
+
 void srand(uint32_t seed) {
-  ThreadContext::get().set_random_seed(seed);
+  ThreadContext &context = ThreadContext::get();
+  context.set_random_seed(seed);
+  rand_seed_state(seed, context.rand_state());
+}
+
+void rand_seed_state(uint32_t seed, uint32_t state[4]) {
+  // SplitMix64, as recommended for seeding xoshiro generators. Its mixing
+  // is a bijection, so the state is never all zero.
+  uint64_t x = seed;
+  for (uint64_t i = 0; i < 4; i += 2) {
+    x += 0x9e3779b97f4a7c15ULL;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    state[i] = static_cast<uint32_t>(z);
+    state[i + 1] = static_cast<uint32_t>(z >> 32);
+  }
 }
 
 }  // namespace scal
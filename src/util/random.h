@@ -16,16 +16,43 @@ namespace scal {
 
 const uint32_t kRandMax = 2147483647;
 
-inline uint64_t rand() {
-  return pseudorand();
-}
-
-inline uint64_t rand_range(uint32_t min, uint32_t max) {
-  return pseudorandrange(min, max);
-}
-
+// Per-thread generators behind rand, rand_range, and their fill variants.
+enum RandGenerator {
+  // Schrage's minimal standard generator, as pseudorand.
+  kRandMinStd,
+  // xoshiro128** (Blackman and Vigna): 128 bits of state, a few shifts and
+  // rotations and two multiplications per value, no division. The default.
+  kRandXoshiro,
+  // The time stamp counter, as hwrand, scrambled with a multiplication so
+  // that ranges, which are taken from the upper bits, vary as well.
+  kRandHardware
+};
+
+// Selects the generator of all threads. Must not be changed while threads
+// operate on data structures.
+void set_rand_generator(RandGenerator generator);
+
+// Returns a pseudo-random number in [0, kRandMax].
+uint64_t rand();
+
+// Returns a pseudo-random number in [min, max). The range is scaled with a
+// multiplication and a shift instead of a modulo (Lemire), which leaves a
+// bias of at most (max - min) / 2^32.
+uint64_t rand_range(uint32_t min, uint32_t max);
+
+// Fill |values| with |n| numbers as returned by rand and rand_range,
+// looking up the state of the calling thread only once.
+void rand_fill(uint64_t *values, uint64_t n);
+void rand_range_fill(uint32_t min, uint32_t max, uint64_t *values,
+                     uint64_t n);
+
+// Seeds both generators of the calling thread.
 void srand(uint32_t seed);
 
+// Derives the xoshiro128** |state| from |seed|. Seeds that differ in few
+// bits give uncorrelated states.
+void rand_seed_state(uint32_t seed, uint32_t state[4]);
+
 inline uint64_t hwrand() {
   return ::hwrand();
 }
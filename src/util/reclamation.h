@@ -0,0 +1,62 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_UTIL_RECLAMATION_H_
+#define SCAL_UTIL_RECLAMATION_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util/epoch.h"
+#include "util/hazard_pointers.h"
+
+namespace scal {
+
+// Reclaims objects of type T through hazard pointers or epochs, whichever is
+// enabled. Data structures that protect their pointers through
+// HazardPointers::protect and operate within an EpochGuard support both.
+template<typename T>
+class Reclaimer {
+ public:
+  // Returns NULL if neither scheme is enabled.
+  static Reclaimer<T>* create(size_t object_size = sizeof(T)) {
+    if (HazardPointers::enabled()) {
+      return new Reclaimer<T>(new HazardPool<T>(object_size), NULL);
+    }
+    if (Epoch::enabled()) {
+      return new Reclaimer<T>(NULL, new EpochPool<T>(object_size));
+    }
+    return NULL;
+  }
+
+  // Returns an object for reuse, or NULL if there is none and the caller
+  // has to allocate a new one.
+  inline T* get(void) {
+    if (hazards_ != NULL) {
+      return hazards_->get();
+    }
+    return epochs_->get();
+  }
+
+  // Retires |object|, which the calling thread has unlinked from the data
+  // structure, or which has never been linked.
+  inline void retire(T *object) {
+    if (hazards_ != NULL) {
+      hazards_->retire(object);
+    } else {
+      epochs_->retire(object);
+    }
+  }
+
+ private:
+  Reclaimer(HazardPool<T> *hazards, EpochPool<T> *epochs)
+      : hazards_(hazards), epochs_(epochs) {}
+
+  HazardPool<T> *hazards_;
+  EpochPool<T> *epochs_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_RECLAMATION_H_
@@ -0,0 +1,122 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_UTIL_STATISTICS_H_
+#define SCAL_UTIL_STATISTICS_H_
+
+#include <math.h>
+#include <stdint.h>
+
+#include <limits>
+
+namespace scal {
+
+// Summary statistics over a small number of samples, e.g., the throughput of
+// repeated benchmark trials. Mean and variance are computed incrementally
+// (Welford's method).
+class Statistics {
+ public:
+  Statistics() {
+    reset();
+  }
+
+  inline void reset() {
+    count_ = 0;
+    mean_ = 0;
+    m2_ = 0;
+    min_ = std::numeric_limits<double>::max();
+    max_ = -std::numeric_limits<double>::max();
+  }
+
+  inline void add(double value) {
+    count_++;
+    double delta = value - mean_;
+    mean_ += delta / count_;
+    m2_ += delta * (value - mean_);
+    if (value < min_) {
+      min_ = value;
+    }
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  inline uint64_t count() const {
+    return count_;
+  }
+
+  inline double mean() const {
+    return mean_;
+  }
+
+  inline double min() const {
+    return (count_ == 0) ? 0 : min_;
+  }
+
+  inline double max() const {
+    return (count_ == 0) ? 0 : max_;
+  }
+
+  // Sample standard deviation.
+  inline double stddev() const {
+    return (count_ < 2) ? 0 : sqrt(m2_ / (count_ - 1));
+  }
+
+  // Jain's fairness index, (sum x)^2 / (n * sum x^2), of non-negative
+  // samples, e.g., the operations of each thread. 1 if all samples are
+  // equal, 1/n if a single sample is non-zero.
+  inline double jain() const {
+    double squares = m2_ + count_ * mean_ * mean_;
+    if (count_ == 0 || squares == 0) {
+      return 1;
+    }
+    return count_ * mean_ * mean_ / squares;
+  }
+
+  // Half width of the 95% confidence interval of the mean, based on
+  // Student's t-distribution.
+  inline double ci95() const {
+    if (count_ < 2) {
+      return 0;
+    }
+    return t95(count_ - 1) * stddev() / sqrt(static_cast<double>(count_));
+  }
+
+  // Two-sided 95% critical value of Student's t-distribution with |df|
+  // degrees of freedom.
+  static double t95(uint64_t df) {
+    static const double kTable[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df == 0) {
+      return std::numeric_limits<double>::infinity();
+    }
+    if (df <= 30) {
+      return kTable[df - 1];
+    }
+    if (df <= 40) {
+      return 2.021;
+    }
+    if (df <= 60) {
+      return 2.000;
+    }
+    if (df <= 120) {
+      return 1.980;
+    }
+    return 1.960;
+  }
+
+ private:
+  uint64_t count_;
+  double mean_;
+  double m2_;
+  double min_;
+  double max_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_STATISTICS_H_
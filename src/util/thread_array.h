@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#ifndef SCAL_UTIL_THREAD_ARRAY_H_
+#define SCAL_UTIL_THREAD_ARRAY_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/malloc.h"
+#include "util/platform.h"
+#include "util/threadlocals.h"
+
+namespace scal {
+
+// Array of one T per thread id, for per-thread state of data structures that
+// do not know the number of threads upfront. Entries are allocated in
+// segments of consecutive ids on first access and never move, so entries of
+// other threads can be read concurrently. New entries are zeroed; T has to
+// be valid when zeroed. Threads reusing an id of an exited thread find its
+// entry as it was left.
+template<typename T>
+class ThreadArray {
+ public:
+  ThreadArray() {
+    memset(const_cast<T**>(segments_), 0, sizeof(segments_));
+  }
+
+  // Entry of |thread_id|, allocating its segment if needed.
+  inline T& operator[](uint64_t thread_id) {
+    T *segment = segments_[thread_id / kSegmentSize];
+    if (segment == NULL) {
+      segment = segment_new(thread_id / kSegmentSize);
+    }
+    return segment[thread_id % kSegmentSize];
+  }
+
+  // Entry of |thread_id|, or NULL if no entry of its segment has been
+  // accessed yet.
+  inline T* find(uint64_t thread_id) const {
+    T *segment = segments_[thread_id / kSegmentSize];
+    if (segment == NULL) {
+      return NULL;
+    }
+    return &segment[thread_id % kSegmentSize];
+  }
+
+ private:
+  static const uint64_t kSegmentSize = 64;
+  static const uint64_t kNumSegments =
+      ThreadContext::kMaxThreads / kSegmentSize;
+
+  T* segment_new(uint64_t index) {
+    T *segment = static_cast<T*>(calloc_aligned(
+        kSegmentSize, sizeof(T), kCachePrefetch));
+    if (!__sync_bool_compare_and_swap(&segments_[index], NULL, segment)) {
+      free(segment);
+      segment = segments_[index];
+    }
+    return segment;
+  }
+
+  ThreadArray(const ThreadArray &cpy);
+  void operator=(const ThreadArray &rhs);
+
+  T * volatile segments_[kNumSegments];
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_THREAD_ARRAY_H_
@@ -16,41 +16,94 @@
 
 namespace scal {
 
-uint64_t ThreadContext::global_thread_id_cnt = 0;
+__thread ThreadContext *ThreadContext::current_ = NULL;
+pthread_once_t ThreadContext::key_once = PTHREAD_ONCE_INIT;
 pthread_key_t ThreadContext::threadcontext_key;
+pthread_mutex_t ThreadContext::ids_lock = PTHREAD_MUTEX_INITIALIZER;
+uint64_t ThreadContext::used_ids[kMaxThreads / 64];
+volatile uint64_t ThreadContext::num_ids_ = 0;
 ThreadContext *ThreadContext::contexts[kMaxThreads];
 
-ThreadContext& ThreadContext::get() {
-  if (pthread_getspecific(threadcontext_key) == NULL) {
-    assign_context();
+void ThreadContext::make_key(void) {
+  pthread_key_create(&threadcontext_key, release);
+}
+
+ThreadContext* ThreadContext::context_new(uint64_t thread_id) {
+  size_t size = (sizeof(ThreadContext) / scal::kPageSize + 1) * scal::kPageSize;
+  void *mem;
+  if (posix_memalign(&mem, scal::kPageSize, size)) {
+    fprintf(stderr, "%s: posix_memalign failed\n", __func__);
+    exit(EXIT_FAILURE);
   }
-  ThreadContext *context = static_cast<ThreadContext*>(
-      pthread_getspecific(threadcontext_key));
-  return *context;
+  ThreadContext *context = new(mem) ThreadContext();
+  context->thread_id_ = thread_id;
+  return context;
 }
 
 void ThreadContext::assign_context() {
-  uint64_t thread_id = __sync_fetch_and_add(&global_thread_id_cnt, 1);
-  if (pthread_setspecific(threadcontext_key, contexts[thread_id])) {
+  pthread_once(&key_once, make_key);
+  if (current_ != NULL) {
+    return;
+  }
+  pthread_mutex_lock(&ids_lock);
+  uint64_t thread_id = kMaxThreads;
+  for (uint64_t i = 0; i < kMaxThreads / 64; i++) {
+    if (~used_ids[i] != 0) {
+      uint64_t bit = __builtin_ctzll(~used_ids[i]);
+      used_ids[i] |= 1ul << bit;
+      thread_id = i * 64 + bit;
+      break;
+    }
+  }
+  if (thread_id == kMaxThreads) {
+    fprintf(stderr, "%s: error: more than %lu threads\n",
+            __func__, kMaxThreads);
+    abort();
+  }
+  if (contexts[thread_id] == NULL) {
+    contexts[thread_id] = context_new(thread_id);
+  }
+  if (thread_id >= num_ids_) {
+    num_ids_ = thread_id + 1;
+  }
+  pthread_mutex_unlock(&ids_lock);
+  // A recycled context starts over.
+  ThreadContext *context = contexts[thread_id];
+  context->new_random_seed();
+  context->data_ = NULL;
+  if (pthread_setspecific(threadcontext_key, context)) {
     fprintf(stderr, "%s: pthread_setspecific failed\n", __func__);
     exit(EXIT_FAILURE);
   }
+  current_ = context;
+}
+
+void ThreadContext::release(void *context) {
+  current_ = NULL;
+  uint64_t thread_id = static_cast<ThreadContext*>(context)->thread_id_;
+  pthread_mutex_lock(&ids_lock);
+  used_ids[thread_id / 64] &= ~(1ul << (thread_id % 64));
+  pthread_mutex_unlock(&ids_lock);
+}
+
+void ThreadContext::release_context() {
+  pthread_once(&key_once, make_key);
+  if (current_ == NULL) {
+    return;
+  }
+  pthread_setspecific(threadcontext_key, NULL);
+  release(current_);
 }
 
 void ThreadContext::prepare(uint64_t num_threads) {
-  pthread_key_create(&threadcontext_key, NULL);
-  size_t size = (sizeof(ThreadContext) / scal::kPageSize + 1) * scal::kPageSize;
-  void *mem;
-  for (uint64_t i = 0; i < num_threads; i++) {
-    if (posix_memalign(&mem, scal::kPageSize, size)) {
-      fprintf(stderr, "%s: posix_memalign failed\n", __func__);
-      exit(EXIT_FAILURE);
+  pthread_once(&key_once, make_key);
+  pthread_mutex_lock(&ids_lock);
+  for (uint64_t i = 0; i < num_threads && i < kMaxThreads; i++) {
+    if (contexts[i] == NULL) {
+      contexts[i] = context_new(i);
     }
-    ThreadContext *context = new(mem) ThreadContext();
-    context->thread_id_ = i;
-    context->new_random_seed();
-    contexts[i] = context;
   }
-};
+  pthread_mutex_unlock(&ids_lock);
+}
 
 }  // namespace scal
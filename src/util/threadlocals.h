@@ -12,11 +12,40 @@
 
 namespace scal {
 
+// Context of a thread registered with Scal. Ids are dense: a thread gets the
+// lowest id not taken by another registered thread, and its id becomes free
+// again once it unregisters or exits. Per-thread state indexed by ids thus
+// stays bounded by the number of threads running at the same time, not by
+// the number of threads ever created.
 class ThreadContext {
  public:
-  static ThreadContext& get();
+  // Threads registered at the same time.
+  static const uint64_t kMaxThreads = 65536;
+
+  // Returns the context of the calling thread, registering it if needed.
+  // Once registered, this is a single load from thread-local storage, so
+  // callers need not cache the context.
+  static inline ThreadContext& get() {
+    ThreadContext *context = current_;
+    if (__builtin_expect(context == NULL, 0)) {
+      assign_context();
+      context = current_;
+    }
+    return *context;
+  }
+  // Allocates the contexts for the ids below |num_threads| upfront. Calling
+  // it is optional, contexts are otherwise allocated on registration.
   static void prepare(uint64_t num_threads);
+  // Registers the calling thread if it is not registered yet.
   static void assign_context();
+  // Unregisters the calling thread, freeing its id for another thread.
+  // Threads that exit are unregistered automatically.
+  static void release_context();
+  // One more than the largest id handed out so far. Per-thread state has to
+  // be scanned up to here.
+  static inline uint64_t num_ids() {
+    return num_ids_;
+  }
 
   inline uint64_t thread_id() {
     return thread_id_;
@@ -25,6 +54,7 @@ class ThreadContext {
   inline void new_random_seed() {
     random_seed_ = static_cast<uint32_t>(
         scal::hwrand()) + (thread_id() + 1 * 100);
+    rand_seed_state(random_seed_, rand_state_);
   }
 
   inline void set_random_seed(uint32_t seed) {
@@ -35,6 +65,11 @@ class ThreadContext {
     return random_seed_;
   }
 
+  // State of the xoshiro128** generator (see util/random.h).
+  inline uint32_t* rand_state() {
+    return rand_state_;
+  }
+
   inline void set_data(void *data) {
     data_ = data;
   }
@@ -44,10 +79,20 @@ class ThreadContext {
   }
 
  private:
-  static constexpr uint64_t kMaxThreads = 1024;
-  static uint64_t global_thread_id_cnt;
-  static ThreadContext *contexts[kMaxThreads];
+  static void make_key(void);
+  static void release(void *context);
+  static ThreadContext* context_new(uint64_t thread_id);
+
+  // Context of the calling thread, NULL if it is not registered. The
+  // pthread key only serves to unregister threads when they exit.
+  static __thread ThreadContext *current_;
+  static pthread_once_t key_once;
   static pthread_key_t threadcontext_key;
+  // Guards the id bitmap. Threads register rarely.
+  static pthread_mutex_t ids_lock;
+  static uint64_t used_ids[kMaxThreads / 64];
+  static volatile uint64_t num_ids_;
+  static ThreadContext *contexts[kMaxThreads];
 
   ThreadContext() {}
   ThreadContext(ThreadContext const &cpy);
@@ -55,6 +100,7 @@ class ThreadContext {
 
   uint64_t  thread_id_;
   int32_t   random_seed_; 
+  uint32_t  rand_state_[4];
   void*     data_;
 };
 
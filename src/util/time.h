@@ -30,4 +30,18 @@ inline uint64_t get_hwptime(void)
     return (rdx << 32) + rax;
 }
 
+// Returns the number of hwtime ticks per microsecond, measured by spinning
+// for |usecs| microseconds.
+inline double hwtime_per_usec(uint64_t usecs = 10000) {
+  uint64_t start_utime = get_utime();
+  uint64_t start_hwtime = get_hwtime();
+  uint64_t end_utime;
+  do {
+    end_utime = get_utime();
+  } while (end_utime - start_utime < usecs);
+  uint64_t end_hwtime = get_hwtime();
+  return static_cast<double>(end_hwtime - start_hwtime) /
+         (end_utime - start_utime);
+}
+
 #endif  // SCAL_UTIL_TIME_H_
@@ -0,0 +1,235 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+#include "util/topology.h"
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "util/platform.h"
+
+namespace {
+
+bool read_line(const std::string &path, std::string *line) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL) {
+    return false;
+  }
+  char buffer[4096];
+  bool ok = (fgets(buffer, sizeof(buffer), f) != NULL);
+  fclose(f);
+  if (ok) {
+    *line = buffer;
+    while (!line->empty() && ((*line)[line->size() - 1] == '\n')) {
+      line->erase(line->size() - 1);
+    }
+  }
+  return ok;
+}
+
+int read_int(const std::string &path, int fallback) {
+  std::string line;
+  if (!read_line(path, &line) || line.empty()) {
+    return fallback;
+  }
+  return atoi(line.c_str());
+}
+
+// The node of a cpu is only exported as a nodeN link in the cpu directory.
+int read_node(const std::string &cpu_dir) {
+  DIR *dir = opendir(cpu_dir.c_str());
+  if (dir == NULL) {
+    return 0;
+  }
+  int node = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "node", 4) == 0 &&
+        entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+bool by_package_smt_core(const scal::CpuInfo &a, const scal::CpuInfo &b) {
+  if (a.package != b.package) return a.package < b.package;
+  if (a.smt != b.smt) return a.smt < b.smt;
+  if (a.core_rank != b.core_rank) return a.core_rank < b.core_rank;
+  return a.cpu < b.cpu;
+}
+
+bool by_smt_core_package(const scal::CpuInfo &a, const scal::CpuInfo &b) {
+  if (a.smt != b.smt) return a.smt < b.smt;
+  if (a.core_rank != b.core_rank) return a.core_rank < b.core_rank;
+  if (a.package != b.package) return a.package < b.package;
+  return a.cpu < b.cpu;
+}
+
+bool by_package_core_smt(const scal::CpuInfo &a, const scal::CpuInfo &b) {
+  if (a.package != b.package) return a.package < b.package;
+  if (a.core_rank != b.core_rank) return a.core_rank < b.core_rank;
+  if (a.smt != b.smt) return a.smt < b.smt;
+  return a.cpu < b.cpu;
+}
+
+}  // namespace
+
+namespace scal {
+
+bool parse_cpu_list(const std::string &list, std::vector<int> *cpus) {
+  cpus->clear();
+  const char *p = list.c_str();
+  while (*p != '\0') {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p || first < 0) {
+      return false;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      p++;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first) {
+        return false;
+      }
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++) {
+      cpus->push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') {
+      p++;
+    } else if (*p != '\0') {
+      return false;
+    }
+  }
+  return !cpus->empty();
+}
+
+CpuTopology::CpuTopology(const char *sysfs_root) {
+  std::string root(sysfs_root);
+  std::string online;
+  std::vector<int> online_cpus;
+  if (!read_line(root + "/online", &online) ||
+      !parse_cpu_list(online, &online_cpus)) {
+    online_cpus.clear();
+    for (long i = 0; i < number_of_cores(); i++) {
+      online_cpus.push_back(static_cast<int>(i));
+    }
+  }
+  for (uint64_t i = 0; i < online_cpus.size(); i++) {
+    int cpu = online_cpus[i];
+    char name[32];
+    snprintf(name, sizeof(name), "/cpu%d", cpu);
+    std::string cpu_dir = root + name;
+    std::string topology_dir = cpu_dir + "/topology";
+    CpuInfo info;
+    info.cpu = cpu;
+    info.package = read_int(topology_dir + "/physical_package_id", 0);
+    info.core = read_int(topology_dir + "/core_id", cpu);
+    info.node = read_node(cpu_dir);
+    info.smt = 0;
+    info.core_rank = 0;
+    std::string siblings_list;
+    std::vector<int> siblings;
+    if (read_line(topology_dir + "/thread_siblings_list", &siblings_list) &&
+        parse_cpu_list(siblings_list, &siblings)) {
+      std::sort(siblings.begin(), siblings.end());
+      info.smt = static_cast<int>(
+          std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin());
+    }
+    cpus_.push_back(info);
+  }
+  // Core ids are not necessarily dense, so rank them per package.
+  for (uint64_t i = 0; i < cpus_.size(); i++) {
+    std::vector<int> cores;
+    for (uint64_t j = 0; j < cpus_.size(); j++) {
+      if (cpus_[j].package == cpus_[i].package) {
+        cores.push_back(cpus_[j].core);
+      }
+    }
+    std::sort(cores.begin(), cores.end());
+    cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+    cpus_[i].core_rank = static_cast<int>(
+        std::lower_bound(cores.begin(), cores.end(), cpus_[i].core) -
+        cores.begin());
+  }
+}
+
+const CpuInfo* CpuTopology::find(int cpu) const {
+  for (uint64_t i = 0; i < cpus_.size(); i++) {
+    if (cpus_[i].cpu == cpu) {
+      return &cpus_[i];
+    }
+  }
+  return NULL;
+}
+
+uint64_t CpuTopology::num_packages() const {
+  std::vector<int> packages;
+  for (uint64_t i = 0; i < cpus_.size(); i++) {
+    packages.push_back(cpus_[i].package);
+  }
+  std::sort(packages.begin(), packages.end());
+  return std::unique(packages.begin(), packages.end()) - packages.begin();
+}
+
+uint64_t CpuTopology::num_nodes() const {
+  std::vector<int> nodes;
+  for (uint64_t i = 0; i < cpus_.size(); i++) {
+    nodes.push_back(cpus_[i].node);
+  }
+  std::sort(nodes.begin(), nodes.end());
+  return std::unique(nodes.begin(), nodes.end()) - nodes.begin();
+}
+
+bool CpuTopology::placement(const std::string &policy,
+                            std::vector<int> *cpus) const {
+  cpus->clear();
+  std::vector<CpuInfo> order(cpus_);
+  if (policy == "compact") {
+    std::sort(order.begin(), order.end(), by_package_smt_core);
+  } else if (policy == "scatter") {
+    std::sort(order.begin(), order.end(), by_smt_core_package);
+  } else if (policy == "physical") {
+    std::sort(order.begin(), order.end(), by_package_core_smt);
+    std::vector<CpuInfo> physical;
+    for (uint64_t i = 0; i < order.size(); i++) {
+      if (order[i].smt == 0) {
+        physical.push_back(order[i]);
+      }
+    }
+    order.swap(physical);
+  } else if (policy == "smt") {
+    std::sort(order.begin(), order.end(), by_package_core_smt);
+  } else {
+    if (!parse_cpu_list(policy, cpus)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < cpus->size(); i++) {
+      if (find((*cpus)[i]) == NULL) {
+        cpus->clear();
+        return false;
+      }
+    }
+    return true;
+  }
+  for (uint64_t i = 0; i < order.size(); i++) {
+    cpus->push_back(order[i].cpu);
+  }
+  return !cpus->empty();
+}
+
+}  // namespace scal
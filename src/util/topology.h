@@ -0,0 +1,67 @@
+// Copyright (c) 2012-2013, the Scal Project Authors.  All rights reserved.
+// Please see the AUTHORS file for details.  Use of this source code is governed
+// by a BSD license that can be found in the LICENSE file.
+
+// CPU topology as exported by Linux in /sys/devices/system/cpu, and thread
+// placement policies derived from it.
+
+#ifndef SCAL_UTIL_TOPOLOGY_H_
+#define SCAL_UTIL_TOPOLOGY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace scal {
+
+struct CpuInfo {
+  int cpu;
+  int package;
+  int core;
+  int smt;        // Index of the cpu among the hardware threads of its core.
+  int node;       // NUMA node, 0 if unknown.
+  int core_rank;  // Index of the core among the cores of its package.
+};
+
+class CpuTopology {
+ public:
+  // Reads the topology of all online cpus below |sysfs_root|. Falls back to
+  // one single-threaded core per online cpu if the files are not available.
+  explicit CpuTopology(const char *sysfs_root = "/sys/devices/system/cpu");
+
+  inline uint64_t num_cpus() const {
+    return cpus_.size();
+  }
+
+  inline const CpuInfo& cpu(uint64_t i) const {
+    return cpus_[i];
+  }
+
+  // Returns the info for cpu number |cpu|, or NULL if it is not online.
+  const CpuInfo* find(int cpu) const;
+
+  uint64_t num_packages() const;
+  uint64_t num_nodes() const;
+
+  // Fills |cpus| with the cpus in the order threads should be placed on them.
+  // |policy| is one of
+  //   compact:  fill one package after the other, using all physical cores of
+  //             a package before their SMT siblings,
+  //   scatter:  round robin over packages, physical cores before siblings,
+  //   physical: one thread per physical core,
+  //   smt:      consecutive threads share a core (SMT pairs),
+  // or an explicit cpu list such as "0,2,4-7". Returns false for unknown
+  // policies, malformed lists, and cpus that are not online.
+  bool placement(const std::string &policy, std::vector<int> *cpus) const;
+
+ private:
+  std::vector<CpuInfo> cpus_;
+};
+
+// Parses a cpu list in the kernel's format, e.g., "0-3,8,10-11".
+bool parse_cpu_list(const std::string &list, std::vector<int> *cpus);
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_TOPOLOGY_H_
@@ -5,6 +5,12 @@
 #include "util/workloads.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/malloc.h"
+#include "util/platform.h"
 
 // iteratively compute pi
 // the greater n, the better the approximation
@@ -28,3 +34,81 @@ double calculate_pi(int n) {
   }
   return 8.0 * in / (static_cast<double>(n) * n);
 }
+
+namespace {
+
+// Keeps the compiler from dropping work whose result is unused.
+volatile double g_sink;
+
+uint64_t get_ntime(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// Units of work per calibration probe, and the minimum time the probes run.
+const uint64_t kProbeUnits = 4096;
+const uint64_t kMinCalibrationTime = 20000000;  // ns
+
+}  // namespace
+
+namespace scal {
+
+Workload::Workload(uint64_t buffer_size)
+    : buffer_(NULL), num_lines_(0), position_(0) {
+  num_lines_ = buffer_size / kCachelineSize;
+  if (num_lines_ > 0) {
+    buffer_ = static_cast<char*>(
+        malloc_aligned(num_lines_ * kCachelineSize, kPageSize));
+    // Fault in all pages up front; they are not part of the work.
+    memset(buffer_, 0, num_lines_ * kCachelineSize);
+  }
+}
+
+Workload::~Workload() {
+  free(buffer_);
+}
+
+void Workload::run(uint64_t units) {
+  if (buffer_ == NULL) {
+    g_sink = calculate_pi(units);
+  } else {
+    stream(units);
+  }
+}
+
+void Workload::stream(uint64_t lines) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < lines; i++) {
+    char *line = buffer_ + position_ * kCachelineSize;
+    sum += line[0];
+    line[0]++;
+    if (++position_ == num_lines_) {
+      position_ = 0;
+    }
+  }
+  g_sink = sum;
+}
+
+uint64_t Workload::calibrate(uint64_t ns) {
+  // Bring the buffer into the state it is in during a run.
+  stream(num_lines_);
+  uint64_t probes = 1;
+  uint64_t elapsed;
+  while (true) {
+    uint64_t start = get_ntime();
+    for (uint64_t i = 0; i < probes; i++) {
+      run(kProbeUnits);
+    }
+    elapsed = get_ntime() - start;
+    if (elapsed >= kMinCalibrationTime) {
+      break;
+    }
+    probes *= 2;
+  }
+  double ns_per_unit = static_cast<double>(elapsed) / (probes * kProbeUnits);
+  uint64_t units = static_cast<uint64_t>(ns / ns_per_unit + 0.5);
+  return (units > 0) ? units : 1;
+}
+
+}  // namespace scal
@@ -5,6 +5,43 @@
 #ifndef SCAL_UTIL_WORKLOADS_H_
 #define SCAL_UTIL_WORKLOADS_H_
 
+#include <stdint.h>
+
 double calculate_pi(int n);
 
-#endif  // SRC_UTIL_WORKLOADS_H_
+namespace scal {
+
+// Synthetic work between two data structure operations.
+//
+// Without a buffer a unit of work is one step of calculate_pi(), which only
+// uses registers. With a buffer a unit is one cache line of a private buffer
+// that is read and written. Consecutive calls stream through the buffer and
+// wrap around at its end, so that a buffer larger than a cache level evicts
+// the data structure's lines from that level, as a real consumer would.
+class Workload {
+ public:
+  // |buffer_size| in bytes, 0 for computation only.
+  explicit Workload(uint64_t buffer_size);
+  ~Workload();
+
+  // Performs |units| units of work.
+  void run(uint64_t units);
+
+  // Returns the number of units that take |ns| nanoseconds on the calling
+  // thread, at least 1.
+  uint64_t calibrate(uint64_t ns);
+
+ private:
+  Workload(const Workload &other);
+  void operator=(const Workload &other);
+
+  void stream(uint64_t lines);
+
+  char *buffer_;
+  uint64_t num_lines_;
+  uint64_t position_;
+};
+
+}  // namespace scal
+
+#endif  // SCAL_UTIL_WORKLOADS_H_